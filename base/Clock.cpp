@@ -0,0 +1,178 @@
+/*
+ *  Filename:   Clock.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:单调时钟
+ */
+
+#include "Clock.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#include <cpuid.h>
+#define CLOCK_HAS_TSC 1
+#endif
+
+namespace
+{
+#ifndef _WIN32
+    inline int64_t readClockNs(clockid_t id)
+    {
+        struct timespec ts;
+        ::clock_gettime(id, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+    }
+#endif
+
+    std::atomic<bool> g_tscEnabled(false);
+
+#ifdef CLOCK_HAS_TSC
+    // 纳秒 = m_baseNs + ((TSC - m_baseTsc) * m_mult) >> kTscShift
+    const int kTscShift = 32;
+    const int64_t kTscCalibrationNs = 20 * 1000 * 1000;
+    const int kTscSampleTries = 8;
+
+    struct TscCalibration
+    {
+        uint64_t m_baseTsc;
+        int64_t m_baseNs;
+        uint64_t m_mult;
+        bool m_ok;
+    };
+
+    TscCalibration g_tsc;
+    std::once_flag g_tscCalibrateOnce;
+
+    bool hasInvariantTsc()
+    {
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007)
+            return false;
+        __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        return (edx & (1u << 8)) != 0;
+    }
+
+    // 在clock_gettime前后各读一次TSC取中点，减小两个时钟采样时刻不一致带来的误差；
+    // 读几次取前后间隔最短的一次，避开中途被中断或者虚拟机调度出去的采样
+    void sample(uint64_t *tsc, int64_t *ns)
+    {
+        uint64_t best = UINT64_MAX;
+        for (int i = 0; i < kTscSampleTries; ++i)
+        {
+            uint64_t before = __rdtsc();
+            int64_t now = Clock::monotonicNs();
+            uint64_t after = __rdtsc();
+            if (after - before < best)
+            {
+                best = after - before;
+                *tsc = before + (after - before) / 2;
+                *ns = now;
+            }
+        }
+    }
+
+    void calibrateTsc()
+    {
+        g_tsc.m_ok = false;
+        if (!hasInvariantTsc())
+            return;
+
+        uint64_t tsc0, tsc1;
+        int64_t ns0, ns1;
+        sample(&tsc0, &ns0);
+        do
+        {
+            __builtin_ia32_pause();
+            sample(&tsc1, &ns1);
+        } while (ns1 - ns0 < kTscCalibrationNs);
+
+        if (tsc1 <= tsc0)
+            return;
+
+        g_tsc.m_mult = (static_cast<uint64_t>(ns1 - ns0) << kTscShift) / (tsc1 - tsc0);
+        g_tsc.m_baseTsc = tsc1;
+        g_tsc.m_baseNs = ns1;
+        g_tsc.m_ok = g_tsc.m_mult != 0;
+    }
+#endif
+}
+
+int64_t Clock::monotonicNs()
+{
+#ifdef _WIN32
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#else
+    return readClockNs(CLOCK_MONOTONIC);
+#endif
+}
+
+int64_t Clock::monotonicUs()
+{
+    return monotonicNs() / 1000;
+}
+
+int64_t Clock::monotonicCoarseUs()
+{
+#if defined(CLOCK_MONOTONIC_COARSE)
+    // 和CLOCK_MONOTONIC是同一个零点，只是精度低，两者可以直接比较
+    return readClockNs(CLOCK_MONOTONIC_COARSE) / 1000;
+#else
+    return monotonicUs();
+#endif
+}
+
+Timestamp Clock::toWallClock(int64_t monotonicUs)
+{
+    return Timestamp(Timestamp::now().microSecondsSinceEpoch() - Clock::monotonicUs() + monotonicUs);
+}
+
+int64_t Clock::fromWallClock(const Timestamp &wallClock)
+{
+    return wallClock.microSecondsSinceEpoch() - Timestamp::now().microSecondsSinceEpoch() + Clock::monotonicUs();
+}
+
+bool Clock::tscSupported()
+{
+#ifdef CLOCK_HAS_TSC
+    std::call_once(g_tscCalibrateOnce, calibrateTsc);
+    return g_tsc.m_ok;
+#else
+    return false;
+#endif
+}
+
+bool Clock::enableTsc(bool on)
+{
+    if (on && !tscSupported())
+        return false;
+    g_tscEnabled.store(on, std::memory_order_release);
+    return true;
+}
+
+bool Clock::tscEnabled()
+{
+    return g_tscEnabled.load(std::memory_order_acquire);
+}
+
+int64_t Clock::fastNowNs()
+{
+#ifdef CLOCK_HAS_TSC
+    if (g_tscEnabled.load(std::memory_order_acquire))
+    {
+        // 其他核上的TSC可能比校准时的基准稍微落后一点，差值按有符号数处理
+        int64_t delta = static_cast<int64_t>(__rdtsc() - g_tsc.m_baseTsc);
+        return g_tsc.m_baseNs + static_cast<int64_t>((static_cast<__int128>(delta) * g_tsc.m_mult) >> kTscShift);
+    }
+#endif
+    return monotonicNs();
+}
@@ -0,0 +1,41 @@
+/*
+ *  Filename:   Clock.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:单调时钟，不受NTP或者手动修改系统时间的影响，定时器、超时和耗时统计都用它，
+ *              Timestamp::now()是墙上时间，只用来显示和记录
+ *              monotonic：CLOCK_MONOTONIC，vDSO里读TSC再换算，每次几十纳秒
+ *              monotonicCoarse：CLOCK_MONOTONIC_COARSE，只读内核上一次tick时更新的值，
+ *                  精度是一个tick(1~4毫秒)，适合只需要毫秒级精度而且调用很频繁的地方
+ *              fastNowNs：直接读TSC，用启动时校准的倍率换算成纳秒，与monotonicNs()同一个零点，
+ *                  只在CPU支持不变TSC(invariant TSC)并且调用过enableTsc(true)时使用，否则退回monotonicNs()；
+ *                  TSC的频率和CLOCK_MONOTONIC的校准会有微小偏差，只用来测量短时间间隔
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "Timestamp.h"
+
+class Clock
+{
+public:
+    static int64_t monotonicNs();
+    static int64_t monotonicUs();
+    static int64_t monotonicCoarseUs();
+
+    // 单调时钟和墙上时间之间互相换算，用当前两个时钟的差值，系统时间被调整之后换算结果也会跟着变
+    static Timestamp toWallClock(int64_t monotonicUs);
+    static int64_t fromWallClock(const Timestamp &wallClock);
+
+    // 当前CPU是否有可用的TSC(x86上要求invariant TSC，频率不随降频和睡眠变化)
+    static bool tscSupported();
+    // 启用TSC快速路径，第一次启用时校准，大约需要20毫秒，不支持时返回false
+    static bool enableTsc(bool on);
+    static bool tscEnabled();
+    static int64_t fastNowNs();
+
+private:
+    Clock() = delete;
+};
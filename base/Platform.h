@@ -28,6 +28,8 @@ typedef unsigned int in_addr_t;
 #define XPOLLHUP 16
 #define XPOLLNVAL 32
 #define XPOLLRDHUP 8192
+// select不支持边缘触发，置0让Channel::setEdgeTriggered()不产生任何效果
+#define XEPOLLET 0
 
 #define XEPOLL_CTL_ADD 1
 #define XEPOLL_CTL_DEL 2
@@ -113,6 +115,7 @@ typedef int SOCKET;
 #define XPOLLHUP POLLHUP
 #define XPOLLNVAL POLLNVAL
 #define XPOLLRDHUP POLLRDHUP
+#define XEPOLLET EPOLLET
 
 #define XEPOLL_CTL_ADD EPOLL_CTL_ADD
 #define XEPOLL_CTL_DEL EPOLL_CTL_DEL
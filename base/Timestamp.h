@@ -39,43 +39,43 @@ private:
     int64_t microSecondsSinceEpoch_;
 };
 
-inline bool operator<(Timestamp &l, Timestamp &r)
+inline bool operator<(const Timestamp &l, const Timestamp &r)
 {
     return l.microSecondsSinceEpoch() < r.microSecondsSinceEpoch();
 }
 
-inline bool operator>(Timestamp &l, Timestamp &r)
+inline bool operator>(const Timestamp &l, const Timestamp &r)
 {
     return l.microSecondsSinceEpoch() > r.microSecondsSinceEpoch();
 }
 
-inline bool operator>=(Timestamp &l, Timestamp &r)
+inline bool operator>=(const Timestamp &l, const Timestamp &r)
 {
     return l.microSecondsSinceEpoch() >= r.microSecondsSinceEpoch();
 }
 
-inline bool operator<=(Timestamp &l, Timestamp &r)
+inline bool operator<=(const Timestamp &l, const Timestamp &r)
 {
     return l.microSecondsSinceEpoch() <= r.microSecondsSinceEpoch();
 }
 
-inline bool operator==(Timestamp &l, Timestamp &r)
+inline bool operator==(const Timestamp &l, const Timestamp &r)
 {
     return l.microSecondsSinceEpoch() == r.microSecondsSinceEpoch();
 }
 
-inline bool operator!=(Timestamp &l, Timestamp &r)
+inline bool operator!=(const Timestamp &l, const Timestamp &r)
 {
     return l.microSecondsSinceEpoch() != r.microSecondsSinceEpoch();
 }
 
-inline double timeDifference(Timestamp &l, Timestamp &r)
+inline double timeDifference(const Timestamp &l, const Timestamp &r)
 {
     int64_t diff = l.microSecondsSinceEpoch() - r.microSecondsSinceEpoch();
     return static_cast<double>(diff / MicroSecondsPerSecond);
 }
 
-inline Timestamp addTime(Timestamp &t, int64_t ms)
+inline Timestamp addTime(const Timestamp &t, int64_t ms)
 {
     return Timestamp(t.microSecondsSinceEpoch() + ms);
 }
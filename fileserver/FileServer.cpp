@@ -7,11 +7,13 @@
 
 #include "FileServer.h"
 #include "../net/InetAddress.h"
+#include "../net/EventLoopThreadPool.h"
 #include "../base/AsyncLog.h"
 #include "../base/Singleton.h"
 #include "FileSession.h"
 
-bool FileServer::init(const char *ip, short port, EventLoop *loop, const char *fileBaseDir /* = "filecache/"*/)
+bool FileServer::init(const char *ip, short port, EventLoop *loop, const char *fileBaseDir /* = "filecache/"*/,
+                      int ioThreadCount /* = 0*/, const char *ioCpus /* = NULL*/, int idleTimeoutSeconds /* = 0*/)
 {
     m_strFileBaseDir = fileBaseDir;
 
@@ -19,8 +21,18 @@ bool FileServer::init(const char *ip, short port, EventLoop *loop, const char *f
     m_server.reset(new TcpServer(loop, addr, "ZYL-MYImgAndFileServer", TcpServer::kReusePort));
     // 设置有连接的回调函数
     m_server->setConnectionCallback(std::bind(&FileServer::onConnected, this, std::placeholders::_1));
+    if (ioCpus != NULL && ioCpus[0] != '\0')
+    {
+        std::vector<int> cpus = EventLoopThreadPool::parseCpuList(ioCpus);
+        if (cpus.empty())
+            LOG_ERROR("invalid iocpus: %s", ioCpus);
+        m_server->setCpuAffinity(cpus);
+    }
+    if (idleTimeoutSeconds > 0)
+        m_server->setIdleTimeout(static_cast<int64_t>(idleTimeoutSeconds) * 1000 * 1000);
     // 启动侦听
-    m_server->start(6);
+    // 没有配置IO线程数时每个CPU一个(绑定了CPU时是列表的长度)
+    m_server->start(ioThreadCount > 0 ? ioThreadCount : TcpServer::kOneLoopPerCpu);
 
     return true;
 }
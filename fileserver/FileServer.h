@@ -34,7 +34,10 @@ public:
     FileServer(const FileServer &rhs) = delete;
     FileServer &operator=(const FileServer &rhs) = delete;
 
-    bool init(const char *ip, short port, EventLoop *loop, const char *fileBaseDir = "filecache/");
+    // ioThreadCount不大于0时按可用的CPU数创建IO线程，设置了ioCpus时是列表的长度；ioCpus是IO线程绑定的CPU列表(如"0-3,8")，为空不绑定
+    // idleTimeoutSeconds秒内没有收发数据的连接被关闭，0表示不检查
+    bool init(const char *ip, short port, EventLoop *loop, const char *fileBaseDir = "filecache/",
+              int ioThreadCount = 0, const char *ioCpus = NULL, int idleTimeoutSeconds = 0);
     void uninit();
 
 private:
@@ -74,10 +74,10 @@ void FileSession::onRead(const std::shared_ptr<TcpConnection> &conn, ByteBuffer
             return;
 
         pBuffer->retrieve(sizeof(file_msg_header));
-        std::string inbuf;
-        inbuf.append(pBuffer->peek(), header.packagesize);
+        // 包体直接在输入缓冲区里解析，不再拷贝一份，process不会改动输入缓冲区，处理完再取走
+        bool ok = process(conn, pBuffer->peek(), header.packagesize);
         pBuffer->retrieve(header.packagesize);
-        if (!process(conn, inbuf.c_str(), inbuf.length()))
+        if (!ok)
         {
             LOG_ERROR("Process error, close TcpConnection, client: %s", conn->peerAddress().toIpPort().c_str());
             conn->forceClose();
@@ -336,50 +336,47 @@ bool FileSession::onDownloadFileResponse(const std::string &filemd5, int32_t cli
         }
     }
 
-    string filedata;
-
     int64_t currentSendSize = 512 * 1024;
     // 移动网络，每次传送64k
     if (clientNetType == client_net_type_cellular)
         currentSendSize = 64 * 1024;
 
-    char buffer[512 * 1024] = {0};
     if (m_currentDownloadFileSize <= m_currentDownloadFileOffset + currentSendSize)
     {
         currentSendSize = m_currentDownloadFileSize - m_currentDownloadFileOffset;
     }
 
-    // TODO: 这个fread()调用时可能会出现崩溃,待排查
-    if (currentSendSize <= 0 || fread(buffer, currentSendSize, 1, m_fp) != 1)
+    if (currentSendSize <= 0)
     {
         std::ostringstream os;
-        os << "fread error, filemd5: " << filemd5 << ", clientNetType: " << clientNetType
-           << ", errno: " << errno << ", errinfo: " << strerror(errno)
+        os << "invalid send size, filemd5: " << filemd5 << ", clientNetType: " << clientNetType
            << ", currentSendSize: " << currentSendSize
-           << ", m_fp: " << m_fp
-           << ", buffer size is " << currentSendSize
+           << ", offset: " << m_currentDownloadFileOffset
+           << ", filesize: " << m_currentDownloadFileSize
            << ", connection name:" << conn->peerAddress().toIpPort();
         LOG_ERROR(os.str().c_str());
+        resetFile();
+        return false;
     }
 
     // 将要发送的偏移量
-    int sendoffset = m_currentDownloadFileOffset;
+    int64_t sendoffset = m_currentDownloadFileOffset;
     m_currentDownloadFileOffset += currentSendSize;
-    filedata.append(buffer, currentSendSize);
 
     int errorcode = file_msg_error_progress;
     // 文件已经下载完成
     if (m_currentDownloadFileOffset == m_currentDownloadFileSize)
         errorcode = file_msg_error_complete;
 
-    send(msg_type_download_resp, m_seq, errorcode, filemd5, sendoffset, m_currentDownloadFileSize, filedata);
+    // 文件内容不再fread到用户态，由sendfile从文件直接发到socket
+    sendFileData(msg_type_download_resp, m_seq, errorcode, filemd5, sendoffset, m_currentDownloadFileSize, fileno(m_fp), sendoffset, currentSendSize);
 
     std::ostringstream os2;
     os2 << "Response to client: cmd=msg_type_download_resp, errorcode: " << (errorcode == file_msg_error_progress ? "file_msg_error_progress" : "file_msg_error_complete")
         << ", filemd5: " << filemd5 << ", clientNetType: " << clientNetType
         << ", sendoffset: " << sendoffset
         << ", filesize: " << m_currentDownloadFileSize
-        << ", filedataLength: " << filedata.length()
+        << ", filedataLength: " << currentSendSize
         << ", download percent: " << (m_currentDownloadFileOffset * 100 / m_currentDownloadFileSize) << "%"
         << ", client:" << conn->peerAddress().toIpPort();
 
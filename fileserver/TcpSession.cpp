@@ -34,6 +34,37 @@ void TcpSession::send(int32_t cmd, int32_t seq, int32_t errorcode, const std::st
     sendPackage(outbuf.c_str(), outbuf.length());
 }
 
+void TcpSession::sendFileData(int32_t cmd, int32_t seq, int32_t errorcode, const std::string &filemd5, int64_t offset, int64_t filesize, int fd, int64_t fileOffset, int64_t length)
+{
+    std::string outbuf;
+    net::BinaryStreamWriter writeStream(&outbuf);
+    writeStream.WriteInt32(cmd);
+    writeStream.WriteInt32(seq);
+    writeStream.WriteInt32(errorcode);
+    writeStream.WriteString(filemd5);
+    writeStream.WriteInt64(offset);
+    writeStream.WriteInt64(filesize);
+    // filedata只写长度，内容随后由sendfile发送
+    writeStream.WriteCStringLength(length);
+    writeStream.Flush(length);
+
+    std::shared_ptr<TcpConnection> conn = tmpConn_.lock();
+    if (!conn)
+    {
+        LOG_ERROR("Tcp connection is destroyed, but TcpSession is still alive?");
+        return;
+    }
+
+    string strPackageData;
+    file_msg_header header = {(int64_t)(outbuf.length() + length)};
+    strPackageData.append((const char *)&header, sizeof(header));
+    strPackageData.append(outbuf);
+
+    LOG_INFO("Send file data, package length: %d, body length: %d", strPackageData.length() + length, outbuf.length() + length);
+    conn->send(strPackageData.c_str(), strPackageData.length());
+    conn->sendFile(fd, fileOffset, length);
+}
+
 void TcpSession::sendPackage(const char *body, int64_t bodylength)
 {
     string strPackageData;
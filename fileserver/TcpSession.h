@@ -35,6 +35,9 @@ public:
     }
 
     void send(int32_t cmd, int32_t seq, int32_t errorcode, const std::string &filemd5, int64_t offset, int64_t filesize, const std::string &filedata);
+    // 包格式和send()一样，filedata部分不读进内存，而是用sendfile把fd里[fileOffset, fileOffset + length)直接发出去
+    // fd在函数内部被dup，调用之后可以马上关闭
+    void sendFileData(int32_t cmd, int32_t seq, int32_t errorcode, const std::string &filemd5, int64_t offset, int64_t filesize, int fd, int64_t fileOffset, int64_t length);
 
 private:
     // 支持大文件，用int64_t来存储包长，记得梳理一下文件上传于下载逻辑
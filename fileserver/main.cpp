@@ -106,7 +106,14 @@ int main(int argc, char *argv[])
 
     const char *listenip = config.getConfigName("listenip");
     short listenport = (short)atol(config.getConfigName("listenport"));
-    Singleton<FileServer>::Instance().init(listenip, listenport, &g_mainLoop, filecachedir);
+    // iothreads不配置或者为0时按可用CPU数创建IO线程(配置了iocpus时是列表的长度)，iocpus不配置时不绑定CPU
+    const char *iothreads = config.getConfigName("iothreads");
+    int ioThreadCount = iothreads != NULL ? atoi(iothreads) : 0;
+    const char *iocpus = config.getConfigName("iocpus");
+    // idletimeout不配置或者为0时不关闭空闲连接
+    const char *idletimeout = config.getConfigName("idletimeout");
+    int idleTimeoutSeconds = idletimeout != NULL ? atoi(idletimeout) : 0;
+    Singleton<FileServer>::Instance().init(listenip, listenport, &g_mainLoop, filecachedir, ioThreadCount, iocpus, idleTimeoutSeconds);
 
     LOG_INFO("fileserver initialization completed, now you can use client to connect it.");
 
@@ -15,11 +15,18 @@
 
 using namespace net;
 
+namespace
+{
+    // 边缘触发模式下每次可读事件最多accept的连接数
+    const int kMaxAcceptsPerRound = 64;
+}
+
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
     : m_loop(loop),
       m_acceptSocket(sockets::createNonblockingOrDie()),
       m_acceptChannel(loop, m_acceptSocket.fd()),
-      m_listenning(false)
+      m_listenning(false),
+      m_alive(std::make_shared<bool>(true))
 {
 #ifndef WIN32
     m_idleFd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
@@ -48,9 +55,37 @@ void Acceptor::listen()
     m_acceptChannel.enableReading();
 }
 
+void Acceptor::setEdgeTriggered(bool on)
+{
+    m_acceptChannel.setEdgeTriggered(on && m_loop->supportsEdgeTriggered());
+}
+
 void Acceptor::handleRead()
 {
     m_loop->assertInLoopThread();
+    if (!m_acceptChannel.isEdgeTriggered())
+    {
+        acceptOne();
+        return;
+    }
+
+    // 边缘触发模式下已经在监听队列里的连接不会再有通知，必须accept到EAGAIN为止
+    // 每次最多accept kMaxAcceptsPerRound个，剩下的投递到任务队列里下一轮继续，避免饿死其他fd
+    for (int i = 0; i < kMaxAcceptsPerRound; ++i)
+    {
+        if (!acceptOne())
+            return;
+    }
+    // 任务执行之前Acceptor可能已经析构了(TcpServer::stop()、TcpServer析构)，任务只持有m_alive的weak_ptr
+    std::weak_ptr<bool> alive(m_alive);
+    m_loop->queueInLoop([this, alive]()
+                        {
+        if (!alive.expired())
+            handleRead(); });
+}
+
+bool Acceptor::acceptOne()
+{
     InetAddress peerAddr;
     int connfd = m_acceptSocket.accept(&peerAddr);
     if (connfd >= 0)
@@ -66,9 +101,15 @@ void Acceptor::handleRead()
         {
             sockets::close(connfd);
         }
+        return true;
     }
     else
     {
+        // 下面的日志和EMFILE的处理都会改掉errno
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN)
+            return false;
+
         LOGSYSE("in Acceptor::handleRead");
 
 #ifndef _WIN32
@@ -104,7 +145,7 @@ void Acceptor::handleRead()
         The last way to handle it is to simply log the error and exit, as is often done with malloc
         failures, but this results in an easy opportunity for a DoS attack.
         */
-        if (errno == EMFILE)
+        if (savedErrno == EMFILE)
         {
             ::close(m_idleFd);
             m_idleFd = ::accept(m_acceptSocket.fd(), NULL, NULL);
@@ -112,5 +153,8 @@ void Acceptor::handleRead()
             m_idleFd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
         }
 #endif
+        // ECONNABORTED和EINTR只影响这一次accept，队列里可能还有别的连接；
+        // ENFILE、ENOBUFS、ENOMEM这类错误马上重试还会失败，边缘触发模式下停下来等下一次可读事件
+        return savedErrno == ECONNABORTED || savedErrno == EINTR;
     }
 }
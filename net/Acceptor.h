@@ -8,6 +8,7 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 
 #include "Channel.h"
 #include "Sockets.h"
@@ -31,11 +32,16 @@ namespace net
             m_newConnectionCallback = cb;
         }
 
+        // 边缘触发模式下每次可读事件循环accept直到EAGAIN，需要在listen()之前设置
+        void setEdgeTriggered(bool on);
+
         bool listenning() const { return m_listenning; }
         void listen();
 
     private:
         void handleRead();
+        // 接受一个新连接，返回false表示队列已经空了(EAGAIN)或者出了马上重试也没用的错误
+        bool acceptOne();
 
     private:
         EventLoop *m_loop;
@@ -43,6 +49,7 @@ namespace net
         Channel m_acceptChannel;
         NewConnectionCallback m_newConnectionCallback;
         bool m_listenning;
+        std::shared_ptr<bool> m_alive; // 边缘触发模式下投递的handleRead任务用它判断Acceptor还在不在
 
 #ifndef _WIN32
         int m_idleFd;
@@ -0,0 +1,420 @@
+/*
+ *  Filename:   BufferPool.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:ByteBuffer用的内存池
+ */
+
+#include "BufferPool.h"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#else
+#include <malloc.h>
+#endif
+
+#include "../base/AsyncLog.h"
+
+using namespace net;
+
+namespace
+{
+    const int kMinShift = 9;
+    const int kMaxShift = 22;
+    const int kClassCount = kMaxShift - kMinShift + 1;
+    // 小块按段向系统申请，一段切成多个块
+    const size_t kRunSize = 256 * 1024;
+    const size_t kHugePageSize = 2 * 1024 * 1024;
+    // 每个等级在线程缓存里最多留这么多字节，至少留2块
+    const size_t kThreadCacheBytesPerClass = 1024 * 1024;
+    const size_t kBlockAlignment = 64;
+
+    std::atomic<bool> g_hugePages(false);
+
+    int classOf(size_t size)
+    {
+        if (size <= BufferPool::kMinBlockSize)
+            return 0;
+        // 向上取整的log2
+        size_t value = size - 1;
+        int shift = 0;
+#if defined(__GNUC__)
+        shift = 64 - __builtin_clzll(static_cast<unsigned long long>(value));
+#else
+        while (value != 0)
+        {
+            value >>= 1;
+            ++shift;
+        }
+#endif
+        return shift - kMinShift;
+    }
+
+    size_t classSize(int c)
+    {
+        return static_cast<size_t>(1) << (c + kMinShift);
+    }
+
+    size_t cacheLimit(int c)
+    {
+        size_t n = kThreadCacheBytesPerClass / classSize(c);
+        return n < 2 ? 2 : n;
+    }
+
+    // 只有所属线程写，其他线程读统计
+    inline void bump(std::atomic<uint64_t> &counter, uint64_t n = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    struct Counters
+    {
+        std::atomic<uint64_t> m_allocations;
+        std::atomic<uint64_t> m_threadCacheHits;
+        std::atomic<uint64_t> m_sharedHits;
+        std::atomic<uint64_t> m_systemAllocations;
+        std::atomic<uint64_t> m_hugePageAllocations;
+        std::atomic<uint64_t> m_unpooledAllocations;
+
+        Counters()
+            : m_allocations(0),
+              m_threadCacheHits(0),
+              m_sharedHits(0),
+              m_systemAllocations(0),
+              m_hugePageAllocations(0),
+              m_unpooledAllocations(0)
+        {
+        }
+
+        void addTo(BufferPool::Stats *stats) const
+        {
+            stats->allocations += m_allocations.load(std::memory_order_relaxed);
+            stats->threadCacheHits += m_threadCacheHits.load(std::memory_order_relaxed);
+            stats->sharedHits += m_sharedHits.load(std::memory_order_relaxed);
+            stats->systemAllocations += m_systemAllocations.load(std::memory_order_relaxed);
+            stats->hugePageAllocations += m_hugePageAllocations.load(std::memory_order_relaxed);
+            stats->unpooledAllocations += m_unpooledAllocations.load(std::memory_order_relaxed);
+        }
+    };
+
+    void *systemAllocate(size_t size, bool *huge)
+    {
+        *huge = false;
+#ifndef _WIN32
+        if (size >= kHugePageSize && g_hugePages.load(std::memory_order_relaxed))
+        {
+            void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+            // 需要预先配置vm.nr_hugepages，没有可用的大页时失败
+            p = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED)
+            {
+                *huge = true;
+                return p;
+            }
+#endif
+            p = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                return NULL;
+#ifdef MADV_HUGEPAGE
+            // 透明大页只是建议，内核不一定满足
+            *huge = ::madvise(p, size, MADV_HUGEPAGE) == 0;
+#endif
+            return p;
+        }
+
+        void *p = NULL;
+        if (::posix_memalign(&p, kBlockAlignment, size) != 0)
+            return NULL;
+        return p;
+#else
+        return _aligned_malloc(size, kBlockAlignment);
+#endif
+    }
+
+    class ThreadCache;
+
+    // 所有线程共享的空闲块，每个等级一把锁；向系统申请的内存从不释放
+    class SharedPool
+    {
+    public:
+        SharedPool() : m_reservedBytes(0) {}
+
+        // 取最多n个块放到out里，返回实际取到的个数，共享池里没有时向系统申请
+        size_t take(int c, void **out, size_t n, Counters *counters)
+        {
+            {
+                Class &cls = m_classes[c];
+                std::lock_guard<std::mutex> lock(cls.m_mutex);
+                size_t got = std::min(n, cls.m_free.size());
+                if (got > 0)
+                {
+                    std::copy(cls.m_free.end() - got, cls.m_free.end(), out);
+                    cls.m_free.resize(cls.m_free.size() - got);
+                    if (counters != NULL)
+                        bump(counters->m_sharedHits);
+                    return got;
+                }
+            }
+
+            size_t blockSize = classSize(c);
+            size_t bytes = std::max(blockSize, kRunSize);
+            bool huge = false;
+            char *run = static_cast<char *>(systemAllocate(bytes, &huge));
+            if (run == NULL)
+            {
+                LOGE("BufferPool: failed to allocate %d bytes from system", static_cast<int>(bytes));
+                return 0;
+            }
+            m_reservedBytes.fetch_add(bytes, std::memory_order_relaxed);
+            if (counters != NULL)
+            {
+                bump(counters->m_systemAllocations);
+                if (huge)
+                    bump(counters->m_hugePageAllocations);
+            }
+
+            size_t blocks = bytes / blockSize;
+            size_t got = std::min(n, blocks);
+            for (size_t i = 0; i < got; ++i)
+                out[i] = run + i * blockSize;
+            if (blocks > got)
+            {
+                Class &cls = m_classes[c];
+                std::lock_guard<std::mutex> lock(cls.m_mutex);
+                for (size_t i = got; i < blocks; ++i)
+                    cls.m_free.push_back(run + i * blockSize);
+            }
+            return got;
+        }
+
+        void give(int c, void *const *blocks, size_t n)
+        {
+            Class &cls = m_classes[c];
+            std::lock_guard<std::mutex> lock(cls.m_mutex);
+            cls.m_free.insert(cls.m_free.end(), blocks, blocks + n);
+        }
+
+        void registerCache(ThreadCache *cache)
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            m_caches.push_back(cache);
+        }
+
+        // 线程退出时把它的统计并入m_retired
+        void unregisterCache(ThreadCache *cache, const Counters &counters)
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            m_caches.erase(std::remove(m_caches.begin(), m_caches.end(), cache), m_caches.end());
+            counters.addTo(&m_retired);
+        }
+
+        BufferPool::Stats stats();
+
+    private:
+        struct Class
+        {
+            std::mutex m_mutex;
+            std::vector<void *> m_free;
+        };
+
+        Class m_classes[kClassCount];
+        std::atomic<uint64_t> m_reservedBytes;
+
+        std::mutex m_statsMutex;
+        std::vector<ThreadCache *> m_caches;
+        BufferPool::Stats m_retired = BufferPool::Stats();
+    };
+
+    // 静态对象析构时还可能有ByteBuffer要释放，共享池故意不析构
+    SharedPool &sharedPool()
+    {
+        static SharedPool *pool = new SharedPool();
+        return *pool;
+    }
+
+    class ThreadCache
+    {
+    public:
+        ThreadCache()
+        {
+            sharedPool().registerCache(this);
+        }
+
+        ~ThreadCache()
+        {
+            for (int c = 0; c < kClassCount; ++c)
+            {
+                if (!m_blocks[c].empty())
+                    sharedPool().give(c, m_blocks[c].data(), m_blocks[c].size());
+            }
+            sharedPool().unregisterCache(this, m_counters);
+        }
+
+        std::vector<void *> m_blocks[kClassCount];
+        Counters m_counters;
+    };
+
+    // t_cache是平凡类型，线程退出析构了缓存之后仍然可以安全地访问，之后的申请和释放直接走共享池
+    thread_local ThreadCache *t_cache = NULL;
+    thread_local bool t_cacheDestroyed = false;
+
+    struct ThreadCacheHolder
+    {
+        ThreadCache *m_cache = NULL;
+
+        ~ThreadCacheHolder()
+        {
+            t_cache = NULL;
+            t_cacheDestroyed = true;
+            delete m_cache;
+        }
+    };
+
+    thread_local ThreadCacheHolder t_cacheHolder;
+
+    ThreadCache *threadCache()
+    {
+        if (t_cache == NULL && !t_cacheDestroyed)
+        {
+            t_cache = new ThreadCache();
+            t_cacheHolder.m_cache = t_cache;
+        }
+        return t_cache;
+    }
+
+    BufferPool::Stats SharedPool::stats()
+    {
+        BufferPool::Stats stats = BufferPool::Stats();
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            stats = m_retired;
+            for (ThreadCache *cache : m_caches)
+                cache->m_counters.addTo(&stats);
+        }
+        stats.reservedBytes = m_reservedBytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+}
+
+const size_t BufferPool::kMinBlockSize;
+const size_t BufferPool::kMaxBlockSize;
+
+void *BufferPool::allocate(size_t size, size_t *actualSize)
+{
+    ThreadCache *cache = threadCache();
+    Counters *counters = cache != NULL ? &cache->m_counters : NULL;
+    if (counters != NULL)
+        bump(counters->m_allocations);
+
+    if (size > kMaxBlockSize)
+    {
+        if (counters != NULL)
+            bump(counters->m_unpooledAllocations);
+        void *block = ::malloc(size);
+        if (block == NULL)
+            throw std::bad_alloc();
+        *actualSize = size;
+        return block;
+    }
+
+    int c = classOf(size);
+    *actualSize = classSize(c);
+
+    void *block = NULL;
+    if (cache == NULL)
+    {
+        // 线程正在退出，缓存已经析构
+        if (sharedPool().take(c, &block, 1, NULL) != 1)
+            throw std::bad_alloc();
+        return block;
+    }
+
+    std::vector<void *> &blocks = cache->m_blocks[c];
+    if (!blocks.empty())
+    {
+        bump(counters->m_threadCacheHits);
+        block = blocks.back();
+        blocks.pop_back();
+        return block;
+    }
+
+    // 一次取半个缓存上限，后面的申请直接命中
+    size_t batch = std::max<size_t>(cacheLimit(c) / 2, 1);
+    blocks.resize(batch);
+    size_t got = sharedPool().take(c, blocks.data(), batch, counters);
+    blocks.resize(got);
+    if (got == 0)
+        throw std::bad_alloc();
+    block = blocks.back();
+    blocks.pop_back();
+    return block;
+}
+
+void BufferPool::deallocate(void *block, size_t actualSize)
+{
+    if (block == NULL)
+        return;
+
+    if (actualSize > kMaxBlockSize)
+    {
+        ::free(block);
+        return;
+    }
+
+    int c = classOf(actualSize);
+    ThreadCache *cache = threadCache();
+    if (cache == NULL)
+    {
+        sharedPool().give(c, &block, 1);
+        return;
+    }
+
+    // 在别的线程申请的块也放进当前线程的缓存，超过上限时把一半还给共享池
+    std::vector<void *> &blocks = cache->m_blocks[c];
+    blocks.push_back(block);
+    size_t limit = cacheLimit(c);
+    if (blocks.size() > limit)
+    {
+        size_t n = blocks.size() / 2;
+        sharedPool().give(c, blocks.data() + blocks.size() - n, n);
+        blocks.resize(blocks.size() - n);
+    }
+}
+
+size_t BufferPool::roundUp(size_t size)
+{
+    return size > kMaxBlockSize ? size : classSize(classOf(size));
+}
+
+void BufferPool::setHugePages(bool on)
+{
+    g_hugePages.store(on, std::memory_order_relaxed);
+}
+
+bool BufferPool::hugePages()
+{
+    return g_hugePages.load(std::memory_order_relaxed);
+}
+
+BufferPool::Stats BufferPool::stats()
+{
+    return sharedPool().stats();
+}
+
+BufferPool::Stats BufferPool::threadStats()
+{
+    Stats stats = Stats();
+    ThreadCache *cache = threadCache();
+    if (cache != NULL)
+        cache->m_counters.addTo(&stats);
+    stats.reservedBytes = sharedPool().stats().reservedBytes;
+    return stats;
+}
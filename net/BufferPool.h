@@ -0,0 +1,63 @@
+/*
+ *  Filename:   BufferPool.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:ByteBuffer用的内存池，仿照Netty的PooledByteBufAllocator
+ *              按2的幂划分大小等级，从512字节到4MB，申请的大小向上取整到所在等级；
+ *              每个线程(每个EventLoop)有自己的缓存，申请和释放先走线程缓存，不需要加锁；
+ *              线程缓存空了从共享池里批量取，满了把一半还给共享池，共享池也空了再向系统申请；
+ *              512KB以下的块按256KB一段整段申请再切开，更大的块单独申请；
+ *              向系统申请的内存一直留在池里复用，不还给系统；超过4MB的块不缓存，直接malloc/free
+ *              可以让2MB及以上的块使用大页，减少TLB缺失
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace net
+{
+    class BufferPool
+    {
+    public:
+        struct Stats
+        {
+            uint64_t allocations;       // 申请次数，包括不缓存的大块
+            uint64_t threadCacheHits;   // 直接从线程缓存拿到的次数
+            uint64_t sharedHits;        // 线程缓存未命中，从共享池里拿到的次数
+            uint64_t systemAllocations; // 向系统申请内存的次数(整段或者单独的块)
+            uint64_t hugePageAllocations;
+            uint64_t unpooledAllocations; // 超过最大等级，直接malloc的次数
+            uint64_t reservedBytes;       // 池里从系统申请的内存总量，不包括不缓存的大块
+
+            double hitRate() const
+            {
+                return allocations == 0 ? 0.0 : static_cast<double>(threadCacheHits) / allocations;
+            }
+        };
+
+        static const size_t kMinBlockSize = 512;
+        static const size_t kMaxBlockSize = 4 * 1024 * 1024;
+
+        // 至少size字节，实际大小(所在等级的大小)通过actualSize返回，释放时原样传回
+        static void *allocate(size_t size, size_t *actualSize);
+        static void deallocate(void *block, size_t actualSize);
+
+        // size向上取整后的实际大小
+        static size_t roundUp(size_t size);
+
+        // 2MB及以上的块是否使用大页，先尝试MAP_HUGETLB，失败时退回透明大页(MADV_HUGEPAGE)
+        // 只影响之后向系统申请的内存，默认关闭
+        static void setHugePages(bool on);
+        static bool hugePages();
+
+        // 所有线程的统计之和，任意线程都可以调用
+        static Stats stats();
+        // 当前线程缓存的统计
+        static Stats threadStats();
+
+    private:
+        BufferPool() = delete;
+    };
+}
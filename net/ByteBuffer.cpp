@@ -14,14 +14,24 @@
 using namespace net;
 
 const char ByteBuffer::kCRLF[] = "\r\n";
+const char ByteBuffer::kEmptyStorage[ByteBuffer::kCheapPrepend] = {0};
 
 const size_t ByteBuffer::kCheapPrepend;
 const size_t ByteBuffer::kInitialSize;
 
+namespace
+{
+    // 空缓冲区的容量超过预测值的这么多倍时释放内存
+    const size_t kShrinkFactor = 4;
+}
+
 int32_t ByteBuffer::readFd(int fd, int *savedErrno)
 {
     // saved an ioctl()/FIONREAD call to tell how much to read
     char extrabuf[65536];
+    // 第一次读之前申请内存，数据直接读进来，不用再从extrabuf拷贝一次
+    if (!allocated())
+        reallocate(0);
     const size_t writable = writableBytes();
 #ifndef _WIN32
     struct iovec vec[2];
@@ -61,7 +71,7 @@ int32_t ByteBuffer::readFd(int fd, int *savedErrno)
         append(extrabuf, n);
 #else
         // Linux平台把剩下的字节补上去
-        m_writerIndex = m_buffer.size();
+        m_writerIndex = m_capacity;
         append(extrabuf, n - writable);
 #endif
     }
@@ -71,3 +81,33 @@ int32_t ByteBuffer::readFd(int fd, int *savedErrno)
     // }
     return n;
 }
+
+int32_t ByteBuffer::readFd(int fd, int *savedErrno, size_t expected, size_t *attempted)
+{
+    expected = expected > 2 * kCheapPrepend ? expected - kCheapPrepend : std::max<size_t>(expected, 1);
+    if (readableBytes() == 0 && allocated() &&
+        m_capacity > kCheapPrepend + std::max(expected, m_initialSize) * kShrinkFactor)
+    {
+        releaseStorage();
+    }
+
+    ensureWritableBytes(expected);
+    // 以前留下的可写空间可能比expected大得多，只读预测的量，读满与否才有意义
+    const size_t len = std::min<size_t>(expected, INT32_MAX);
+    if (attempted != NULL)
+        *attempted = len;
+    const int32_t n = sockets::read(fd, beginWrite(), static_cast<int32_t>(len));
+    if (n <= 0)
+    {
+#ifdef _WIN32
+        *savedErrno = ::WSAGetLastError();
+#else
+        *savedErrno = errno;
+#endif
+    }
+    else
+    {
+        m_writerIndex += n;
+    }
+    return n;
+}
@@ -3,18 +3,22 @@
  *  Author:     xiebaoma
  *  Date:       2025-06-30
  *  Description:一个可读可写的缓冲类，通过双指针实现
+ *              内存从BufferPool里申请，大小是2的幂，扩容时只拷贝可读的数据，不清零；
+ *              构造时不申请内存，第一次写入时才申请，这样在accept线程里构造、在IO线程里使用和析构的连接
+ *              申请和释放都落在IO线程的缓存里
  */
 
 #pragma once
 
 #include <algorithm>
-#include <vector>
 #include <string>
 #include <string.h>
 
 #include "../base/Platform.h"
 #include "Sockets.h"
 #include "Endian.h"
+#include "BufferPool.h"
+#include "ByteSearch.h"
 
 namespace net
 {
@@ -26,7 +30,7 @@ namespace net
     /// +-------------------+------------------+------------------+
     /// |                   |                  |                  |
     /// 0      <=      readerIndex   <=   writerIndex    <=     size
-    // vector<char> ========//read=============//write=============
+    // BufferPool块 ========//read=============//write=============
     class ByteBuffer
     {
     public:
@@ -34,15 +38,51 @@ namespace net
         static const size_t kInitialSize = 1024;
 
         explicit ByteBuffer(size_t initialSize = kInitialSize)
-            : m_buffer(kCheapPrepend + initialSize),
+            : m_buffer(const_cast<char *>(kEmptyStorage)),
+              m_capacity(kCheapPrepend),
+              m_initialSize(initialSize),
               m_readerIndex(kCheapPrepend),
               m_writerIndex(kCheapPrepend)
         {
         }
 
+        ByteBuffer(const ByteBuffer &rhs)
+            : m_buffer(const_cast<char *>(kEmptyStorage)),
+              m_capacity(kCheapPrepend),
+              m_initialSize(rhs.m_initialSize),
+              m_readerIndex(kCheapPrepend),
+              m_writerIndex(kCheapPrepend)
+        {
+            append(rhs.peek(), rhs.readableBytes());
+        }
+
+        ByteBuffer(ByteBuffer &&rhs) noexcept
+            : m_buffer(const_cast<char *>(kEmptyStorage)),
+              m_capacity(kCheapPrepend),
+              m_initialSize(rhs.m_initialSize),
+              m_readerIndex(kCheapPrepend),
+              m_writerIndex(kCheapPrepend)
+        {
+            swap(rhs);
+        }
+
+        ByteBuffer &operator=(ByteBuffer rhs)
+        {
+            swap(rhs);
+            return *this;
+        }
+
+        ~ByteBuffer()
+        {
+            if (allocated())
+                BufferPool::deallocate(m_buffer, m_capacity);
+        }
+
         void swap(ByteBuffer &rhs)
         {
-            m_buffer.swap(rhs.m_buffer);
+            std::swap(m_buffer, rhs.m_buffer);
+            std::swap(m_capacity, rhs.m_capacity);
+            std::swap(m_initialSize, rhs.m_initialSize);
             std::swap(m_readerIndex, rhs.m_readerIndex);
             std::swap(m_writerIndex, rhs.m_writerIndex);
         }
@@ -54,7 +94,7 @@ namespace net
 
         size_t writableBytes() const
         {
-            return m_buffer.size() - m_writerIndex;
+            return m_capacity - m_writerIndex;
         }
 
         size_t prependableBytes() const
@@ -69,15 +109,12 @@ namespace net
 
         const char *findString(const char *targetStr) const
         {
-            const char *found = std::search(peek(), beginWrite(), targetStr, targetStr + strlen(targetStr));
-            return found == beginWrite() ? nullptr : found;
+            return ByteSearch::find(peek(), beginWrite(), targetStr, strlen(targetStr));
         }
 
         const char *findCRLF() const
         {
-            // FIXME: replace with memmem()?
-            const char *crlf = std::search(peek(), beginWrite(), kCRLF, kCRLF + 2);
-            return crlf == beginWrite() ? nullptr : crlf;
+            return ByteSearch::findCRLF(peek(), beginWrite());
         }
 
         const char *findCRLF(const char *start) const
@@ -88,9 +125,39 @@ namespace net
             if (start > beginWrite())
                 return nullptr;
 
-            // FIXME: replace with memmem()?
-            const char *crlf = std::search(start, beginWrite(), kCRLF, kCRLF + 2);
-            return crlf == beginWrite() ? nullptr : crlf;
+            return ByteSearch::findCRLF(start, beginWrite());
+        }
+
+        // 可以接着上次的位置继续找的版本，一个包分几次到达时不用每次都从头扫描
+        // *scanned是相对peek()的偏移，从这里开始找；找不到时更新为下次可以开始的位置
+        // (目标可能跨在已有数据的末尾，会留下目标长度减1个字节重新检查)；
+        // 用偏移而不是指针，缓冲区扩容或者挪动数据后仍然有效；retrieve之后调用者要把它清零
+        const char *findCRLF(size_t *scanned) const
+        {
+            size_t readable = readableBytes();
+            const char *found = ByteSearch::findCRLF(peek() + std::min(*scanned, readable), beginWrite());
+            if (found == nullptr)
+                *scanned = readable >= 2 ? readable - 1 : 0;
+            return found;
+        }
+
+        const char *findString(const char *target, size_t targetLen, size_t *scanned) const
+        {
+            size_t readable = readableBytes();
+            const char *found = ByteSearch::find(peek() + std::min(*scanned, readable), beginWrite(), target, targetLen);
+            if (found == nullptr)
+                *scanned = readable >= targetLen ? readable - targetLen + 1 : 0;
+            return found;
+        }
+
+        // 第一个属于delimiters的字节，比如按" \t\r\n"之类的分隔符切分
+        const char *findAnyOf(const char *delimiters, size_t count, size_t *scanned) const
+        {
+            size_t readable = readableBytes();
+            const char *found = ByteSearch::findAnyOf(peek() + std::min(*scanned, readable), beginWrite(), delimiters, count);
+            if (found == nullptr)
+                *scanned = readable;
+            return found;
         }
 
         const char *findEOL() const
@@ -394,6 +461,10 @@ namespace net
             if (len > prependableBytes())
                 return false;
 
+            // 还没有申请内存时前面的预留空间是共享的空数组，不能写
+            if (!allocated())
+                reallocate(0);
+
             m_readerIndex -= len;
             const char *d = static_cast<const char *>(data);
             std::copy(d, d + len, begin() + m_readerIndex);
@@ -411,7 +482,7 @@ namespace net
 
         size_t internalCapacity() const
         {
-            return m_buffer.capacity();
+            return allocated() ? m_capacity : 0;
         }
 
         /// Read data directly into buffer.
@@ -419,16 +490,57 @@ namespace net
         /// It may implement with readv(2)
         /// @return result of read(2), @c errno is saved
         int32_t readFd(int fd, int *savedErrno);
+        /// 先准备好大约expected字节的可写空间，再直接读进可写空间，不经过extrabuf，一次最多读这么多，
+        /// 扣掉了预留的kCheapPrepend，空缓冲区申请的内存正好是BufferPool的一个等级，不会翻倍；
+        /// attempted返回这一次向内核要的字节数，读到的不少于它说明读满了，socket里可能还有数据
+        /// 缓冲区为空而容量远大于expected时先把内存还给BufferPool，突发的大块数据过去之后不会一直占着
+        int32_t readFd(int fd, int *savedErrno, size_t expected, size_t *attempted = NULL);
 
     private:
         char *begin()
         {
-            return &*m_buffer.begin();
+            return m_buffer;
         }
 
         const char *begin() const
         {
-            return &*m_buffer.begin();
+            return m_buffer;
+        }
+
+        bool allocated() const
+        {
+            return m_buffer != kEmptyStorage;
+        }
+
+        // 把内存还给BufferPool，回到还没有申请内存的状态，只在没有可读数据时调用
+        void releaseStorage()
+        {
+            if (allocated())
+                BufferPool::deallocate(m_buffer, m_capacity);
+            m_buffer = const_cast<char *>(kEmptyStorage);
+            m_capacity = kCheapPrepend;
+            m_readerIndex = kCheapPrepend;
+            m_writerIndex = kCheapPrepend;
+        }
+
+        // 换一块至少能再写入len字节的内存，可读的数据挪到kCheapPrepend处，第一次申请时不小于initialSize
+        void reallocate(size_t len)
+        {
+            size_t readable = readableBytes();
+            size_t size = kCheapPrepend + readable + len;
+            if (!allocated())
+                size = std::max(size, kCheapPrepend + m_initialSize);
+
+            size_t capacity = 0;
+            char *buffer = static_cast<char *>(BufferPool::allocate(size, &capacity));
+            ::memcpy(buffer + kCheapPrepend, peek(), readable);
+            if (allocated())
+                BufferPool::deallocate(m_buffer, m_capacity);
+
+            m_buffer = buffer;
+            m_capacity = capacity;
+            m_readerIndex = kCheapPrepend;
+            m_writerIndex = kCheapPrepend + readable;
         }
 
         void makeSpace(size_t len)
@@ -436,8 +548,8 @@ namespace net
             // kCheapPrepend为保留的空间
             if (writableBytes() + prependableBytes() < len + kCheapPrepend)
             {
-                // FIXME: move readable data
-                m_buffer.resize(m_writerIndex + len);
+                // 大小按2的幂取整，自然是倍增扩容
+                reallocate(len);
             }
             else
             {
@@ -456,11 +568,14 @@ namespace net
         }
 
     private:
-        std::vector<char> m_buffer;
+        char *m_buffer;    // 没有申请内存时指向kEmptyStorage
+        size_t m_capacity;
+        size_t m_initialSize;
         size_t m_readerIndex;
         size_t m_writerIndex;
 
         static const char kCRLF[];
+        static const char kEmptyStorage[kCheapPrepend];
     };
 
 }
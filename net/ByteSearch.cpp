@@ -0,0 +1,378 @@
+/*
+ *  Filename:   ByteSearch.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:查找CRLF、子串和分隔字节，SSE2/AVX2运行时选择
+ */
+
+#include "ByteSearch.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BYTESEARCH_HAS_X86 1
+#endif
+
+using namespace net;
+
+namespace
+{
+    struct Kernels
+    {
+        ByteSearch::Implementation m_impl;
+        const char *m_name;
+        const char *(*m_findCRLF)(const char *, const char *);
+        const char *(*m_find)(const char *, const char *, const char *, size_t);
+        const char *(*m_findAnyOf)(const char *, const char *, const char *, size_t);
+    };
+
+    // ---- 标量实现，也用来处理向量实现剩下的尾部 ----
+
+    const char *scalarFindCRLF(const char *begin, const char *end)
+    {
+        const char *p = begin;
+        while (end - p >= 2)
+        {
+            const char *cr = static_cast<const char *>(::memchr(p, '\r', end - p - 1));
+            if (cr == NULL)
+                return NULL;
+            if (cr[1] == '\n')
+                return cr;
+            p = cr + 1;
+        }
+        return NULL;
+    }
+
+    const char *scalarFind(const char *begin, const char *end, const char *needle, size_t needleLen)
+    {
+        if (needleLen == 0)
+            return begin;
+
+        const char *p = begin;
+        while (static_cast<size_t>(end - p) >= needleLen)
+        {
+            const char *first = static_cast<const char *>(::memchr(p, needle[0], end - p - needleLen + 1));
+            if (first == NULL)
+                return NULL;
+            if (::memcmp(first + 1, needle + 1, needleLen - 1) == 0)
+                return first;
+            p = first + 1;
+        }
+        return NULL;
+    }
+
+    const char *scalarFindAnyOf(const char *begin, const char *end, const char *set, size_t setLen)
+    {
+        if (setLen == 1)
+            return static_cast<const char *>(::memchr(begin, set[0], end - begin));
+
+        bool table[256] = {false};
+        for (size_t i = 0; i < setLen; ++i)
+            table[static_cast<unsigned char>(set[i])] = true;
+        for (const char *p = begin; p < end; ++p)
+        {
+            if (table[static_cast<unsigned char>(*p)])
+                return p;
+        }
+        return NULL;
+    }
+
+    const Kernels kScalarKernels = {ByteSearch::kScalar, "scalar", scalarFindCRLF, scalarFind, scalarFindAnyOf};
+
+#ifdef BYTESEARCH_HAS_X86
+    inline int lowestBit(unsigned int mask)
+    {
+        return __builtin_ctz(mask);
+    }
+
+    // ---- SSE2，x86_64上总是可用 ----
+
+    // 64字节里\r和\n的位置各拼成一个64位掩码，\r后一位是\n就是CRLF，
+    // 块的最后一个字节是\r时单独看下一块的第一个字节；没有\r的块只比较\r就跳过
+    inline const char *crlfInBlock(const char *p, const char *end, uint64_t cr, uint64_t lf)
+    {
+        uint64_t hits = cr & (lf >> 1);
+        if (hits != 0)
+            return p + __builtin_ctzll(hits);
+        if ((cr >> 63) != 0 && p + 64 < end && p[64] == '\n')
+            return p + 63;
+        return NULL;
+    }
+
+    __attribute__((target("sse2"))) inline uint64_t sse2Mask64(const __m128i *v, __m128i c)
+    {
+        return static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v[0], c))) |
+               static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v[1], c))) << 16 |
+               static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v[2], c))) << 32 |
+               static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v[3], c))) << 48;
+    }
+
+    // 短行的CRLF一般就在开头几十个字节里，先按kProbeBytes探一下：错开一个字节再加载一次，
+    // \r的比较结果和下一个字节\n的比较结果直接相与，不用拼64位掩码，也不用管块的边界
+    const ptrdiff_t kProbeBytes = 64;
+
+    // 找到时返回CRLF的位置，否则*p前进到探过的位置之后
+    __attribute__((target("sse2"))) inline const char *sse2ProbeCRLF(const char **p, const char *end)
+    {
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        const char *q = *p;
+        for (const char *probeEnd = q + kProbeBytes; q < probeEnd && end - q >= 17; q += 16)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(q));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(q + 1));
+            unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+            if (mask != 0)
+                return q + lowestBit(mask);
+        }
+        *p = q;
+        return NULL;
+    }
+
+    __attribute__((target("sse2"))) const char *sse2FindCRLF(const char *begin, const char *end)
+    {
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        const char *p = begin;
+        const char *found = sse2ProbeCRLF(&p, end);
+        if (found != NULL)
+            return found;
+        for (; end - p >= 64; p += 64)
+        {
+            __m128i v[4];
+            for (int i = 0; i < 4; ++i)
+                v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+            __m128i any = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v[0], cr), _mm_cmpeq_epi8(v[1], cr)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(v[2], cr), _mm_cmpeq_epi8(v[3], cr)));
+            if (_mm_movemask_epi8(any) == 0)
+                continue;
+            const char *found = crlfInBlock(p, end, sse2Mask64(v, cr), sse2Mask64(v, lf));
+            if (found != NULL)
+                return found;
+        }
+        return scalarFindCRLF(p, end);
+    }
+
+    __attribute__((target("sse2"))) const char *sse2Find(const char *begin, const char *end, const char *needle, size_t needleLen)
+    {
+        if (needleLen < 2)
+            return needleLen == 0 ? begin : static_cast<const char *>(::memchr(begin, needle[0], end - begin));
+
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i last = _mm_set1_epi8(needle[needleLen - 1]);
+        const char *p = begin;
+        for (; static_cast<size_t>(end - p) >= needleLen - 1 + 16; p += 16)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + needleLen - 1));
+            unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+            while (mask != 0)
+            {
+                const char *candidate = p + lowestBit(mask);
+                if (::memcmp(candidate + 1, needle + 1, needleLen - 2) == 0)
+                    return candidate;
+                mask &= mask - 1;
+            }
+        }
+        return scalarFind(p, end, needle, needleLen);
+    }
+
+    __attribute__((target("sse2"))) const char *sse2FindAnyOf(const char *begin, const char *end, const char *set, size_t setLen)
+    {
+        if (setLen == 0 || setLen > ByteSearch::kMaxVectorSet)
+            return scalarFindAnyOf(begin, end, set, setLen);
+
+        __m128i needles[ByteSearch::kMaxVectorSet];
+        for (size_t i = 0; i < setLen; ++i)
+            needles[i] = _mm_set1_epi8(set[i]);
+
+        const char *p = begin;
+        for (; end - p >= 16; p += 16)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i hit = _mm_cmpeq_epi8(a, needles[0]);
+            for (size_t i = 1; i < setLen; ++i)
+                hit = _mm_or_si128(hit, _mm_cmpeq_epi8(a, needles[i]));
+            unsigned int mask = _mm_movemask_epi8(hit);
+            if (mask != 0)
+                return p + lowestBit(mask);
+        }
+        return scalarFindAnyOf(p, end, set, setLen);
+    }
+
+    const Kernels kSse2Kernels = {ByteSearch::kSse2, "sse2", sse2FindCRLF, sse2Find, sse2FindAnyOf};
+
+    // ---- AVX2，运行时检测 ----
+
+    __attribute__((target("avx2"))) inline uint64_t avx2Mask64(__m256i v0, __m256i v1, __m256i c)
+    {
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v0, c))) |
+               static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v1, c)))) << 32;
+    }
+
+    __attribute__((target("avx2"))) const char *avx2FindCRLF(const char *begin, const char *end)
+    {
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i lf = _mm256_set1_epi8('\n');
+        const char *p = begin;
+        const char *found = sse2ProbeCRLF(&p, end);
+        if (found != NULL)
+            return found;
+        for (; end - p >= 64; p += 64)
+        {
+            __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+            __m256i any = _mm256_or_si256(_mm256_cmpeq_epi8(v0, cr), _mm256_cmpeq_epi8(v1, cr));
+            if (_mm256_testz_si256(any, any))
+                continue;
+            const char *found = crlfInBlock(p, end, avx2Mask64(v0, v1, cr), avx2Mask64(v0, v1, lf));
+            if (found != NULL)
+                return found;
+        }
+        return sse2FindCRLF(p, end);
+    }
+
+    __attribute__((target("avx2"))) const char *avx2Find(const char *begin, const char *end, const char *needle, size_t needleLen)
+    {
+        if (needleLen < 2)
+            return needleLen == 0 ? begin : static_cast<const char *>(::memchr(begin, needle[0], end - begin));
+
+        const __m256i first = _mm256_set1_epi8(needle[0]);
+        const __m256i last = _mm256_set1_epi8(needle[needleLen - 1]);
+        const char *p = begin;
+        for (; static_cast<size_t>(end - p) >= needleLen - 1 + 32; p += 32)
+        {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + needleLen - 1));
+            unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+            while (mask != 0)
+            {
+                const char *candidate = p + lowestBit(mask);
+                if (::memcmp(candidate + 1, needle + 1, needleLen - 2) == 0)
+                    return candidate;
+                mask &= mask - 1;
+            }
+        }
+        return sse2Find(p, end, needle, needleLen);
+    }
+
+    __attribute__((target("avx2"))) const char *avx2FindAnyOf(const char *begin, const char *end, const char *set, size_t setLen)
+    {
+        if (setLen == 0 || setLen > ByteSearch::kMaxVectorSet)
+            return scalarFindAnyOf(begin, end, set, setLen);
+
+        __m256i needles[ByteSearch::kMaxVectorSet];
+        for (size_t i = 0; i < setLen; ++i)
+            needles[i] = _mm256_set1_epi8(set[i]);
+
+        const char *p = begin;
+        for (; end - p >= 32; p += 32)
+        {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i hit = _mm256_cmpeq_epi8(a, needles[0]);
+            for (size_t i = 1; i < setLen; ++i)
+                hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(a, needles[i]));
+            unsigned int mask = _mm256_movemask_epi8(hit);
+            if (mask != 0)
+                return p + lowestBit(mask);
+        }
+        return sse2FindAnyOf(p, end, set, setLen);
+    }
+
+    const Kernels kAvx2Kernels = {ByteSearch::kAvx2, "avx2", avx2FindCRLF, avx2Find, avx2FindAnyOf};
+#endif
+
+    bool supported(ByteSearch::Implementation impl)
+    {
+        switch (impl)
+        {
+        case ByteSearch::kScalar:
+            return true;
+#ifdef BYTESEARCH_HAS_X86
+        case ByteSearch::kSse2:
+            return __builtin_cpu_supports("sse2");
+        case ByteSearch::kAvx2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+        }
+    }
+
+    const Kernels *kernelsOf(ByteSearch::Implementation impl)
+    {
+#ifdef BYTESEARCH_HAS_X86
+        if (impl == ByteSearch::kAvx2)
+            return &kAvx2Kernels;
+        if (impl == ByteSearch::kSse2)
+            return &kSse2Kernels;
+#endif
+        return &kScalarKernels;
+    }
+
+    const Kernels *detect()
+    {
+#ifdef BYTESEARCH_HAS_X86
+        __builtin_cpu_init();
+#endif
+        if (supported(ByteSearch::kAvx2))
+            return kernelsOf(ByteSearch::kAvx2);
+        if (supported(ByteSearch::kSse2))
+            return kernelsOf(ByteSearch::kSse2);
+        return kernelsOf(ByteSearch::kScalar);
+    }
+
+    std::atomic<const Kernels *> g_kernels(NULL);
+
+    inline const Kernels *kernels()
+    {
+        const Kernels *k = g_kernels.load(std::memory_order_acquire);
+        if (k == NULL)
+        {
+            // 多个线程同时检测得到的结果一样，谁写进去都可以
+            k = detect();
+            g_kernels.store(k, std::memory_order_release);
+        }
+        return k;
+    }
+}
+
+const size_t ByteSearch::kMaxVectorSet;
+
+const char *ByteSearch::findCRLF(const char *begin, const char *end)
+{
+    return kernels()->m_findCRLF(begin, end);
+}
+
+const char *ByteSearch::find(const char *begin, const char *end, const char *needle, size_t needleLen)
+{
+    if (static_cast<size_t>(end - begin) < needleLen)
+        return NULL;
+    return kernels()->m_find(begin, end, needle, needleLen);
+}
+
+const char *ByteSearch::findAnyOf(const char *begin, const char *end, const char *set, size_t setLen)
+{
+    return kernels()->m_findAnyOf(begin, end, set, setLen);
+}
+
+ByteSearch::Implementation ByteSearch::implementation()
+{
+    return kernels()->m_impl;
+}
+
+const char *ByteSearch::implementationName()
+{
+    return kernels()->m_name;
+}
+
+bool ByteSearch::setImplementation(Implementation impl)
+{
+    if (!supported(impl))
+        return false;
+    g_kernels.store(kernelsOf(impl), std::memory_order_release);
+    return true;
+}
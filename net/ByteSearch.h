@@ -0,0 +1,44 @@
+/*
+ *  Filename:   ByteSearch.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:在一段内存里查找CRLF、任意子串和一组分隔字节，按行或者分隔符切包的协议大部分解析时间都花在这里
+ *              x86上有SSE2和AVX2两套实现，第一次调用时按CPU支持的指令集选择，其他平台和不支持时用标量实现
+ *              子串用首尾两个字节同时过滤(一次比较16/32个位置)，候选位置再用memcmp确认
+ *              分隔字节不超过kMaxVectorSet个时每个字节比较一次再合并，更多时退回查表
+ *              都返回第一次出现的位置，找不到返回nullptr
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+namespace net
+{
+    class ByteSearch
+    {
+    public:
+        enum Implementation
+        {
+            kScalar,
+            kSse2,
+            kAvx2
+        };
+
+        static const size_t kMaxVectorSet = 8;
+
+        static const char *findCRLF(const char *begin, const char *end);
+        static const char *find(const char *begin, const char *end, const char *needle, size_t needleLen);
+        // [begin, end)里第一个属于set的字节
+        static const char *findAnyOf(const char *begin, const char *end, const char *set, size_t setLen);
+
+        // 当前使用的实现
+        static Implementation implementation();
+        static const char *implementationName();
+        // 强制使用某一种实现，CPU不支持时返回false，给测试和性能对比用
+        static bool setImplementation(Implementation impl);
+
+    private:
+        ByteSearch() = delete;
+    };
+}
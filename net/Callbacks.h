@@ -10,13 +10,15 @@
 #include <functional>
 #include <memory>
 #include "../base/Timestamp.h"
+#include "InplaceFunction.h"
 
 namespace net
 {
     class ByteBuffer;
     class TcpConnection;
     typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
-    typedef std::function<void()> TimerCallback;
+    // 定时器回调只能移动，捕获的数据不超过56字节时不需要堆分配
+    typedef InplaceFunction<void()> TimerCallback;
     typedef std::function<void(const TcpConnectionPtr &)> ConnectionCallback;
     typedef std::function<void(const TcpConnectionPtr &)> CloseCallback;
     typedef std::function<void(const TcpConnectionPtr &)> WriteCompleteCallback;
@@ -24,6 +26,16 @@ namespace net
 
     typedef std::function<void(const TcpConnectionPtr &, ByteBuffer *, Timestamp)> MessageCallback;
 
+    // 连接超时的类型
+    enum ConnectionTimeout
+    {
+        kIdleTimeout,  // 一段时间内没有收发任何数据
+        kReadTimeout,  // 一段时间内没有收到任何数据
+        kWriteTimeout, // 有数据等待发送，但一段时间内一个字节也没有发出去
+        kConnectionTimeoutTypes,
+    };
+    typedef std::function<void(const TcpConnectionPtr &, ConnectionTimeout)> TimeoutCallback;
+
     void defaultConnectionCallback(const TcpConnectionPtr &conn);
     void defaultMessageCallback(const TcpConnectionPtr &conn, ByteBuffer *buffer, Timestamp receiveTime);
 }
@@ -18,12 +18,14 @@ using namespace net;
 const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = XPOLLIN | XPOLLPRI;
 const int Channel::kWriteEvent = XPOLLOUT;
+const int Channel::kErrorEvent = XPOLLERR;
 
 Channel::Channel(EventLoop *loop, int fd__) : m_loop(loop),
                                               m_fd(fd__),
                                               m_events(0),
                                               m_revents(0),
-                                              m_index(-1)
+                                              m_index(-1),
+                                              m_edgeTriggered(false)
 {
 }
 
@@ -31,6 +33,11 @@ Channel::~Channel()
 {
 }
 
+int Channel::events() const
+{
+    return m_edgeTriggered ? (m_events | XEPOLLET) : m_events;
+}
+
 bool Channel::enableReading()
 {
     m_events |= kReadEvent;
@@ -57,6 +64,18 @@ bool Channel::disableWriting()
     return update();
 }
 
+bool Channel::enableErrors()
+{
+    m_events |= kErrorEvent;
+    return update();
+}
+
+bool Channel::disableErrors()
+{
+    m_events &= ~kErrorEvent;
+    return update();
+}
+
 bool Channel::disableAll()
 {
     m_events = kNoneEvent;
@@ -44,7 +44,8 @@ namespace net
         }
 
         int fd() const { return m_fd; }
-        int events() const { return m_events; }
+        // 注册到Poller的事件，边缘触发模式下会带上EPOLLET
+        int events() const;
         void set_revents(int revt) { m_revents = revt; }
         void add_revents(int revt) { m_revents |= revt; }
         bool isNoneEvent() const { return m_events == kNoneEvent; }
@@ -54,6 +55,16 @@ namespace net
         bool disableWriting();
         bool disableAll();
         bool isWriting() const { return m_events & kWriteEvent; }
+        bool isReading() const { return m_events & kReadEvent; }
+        // 不读不写时fd也留在Poller里，只为了收错误事件，比如零拷贝的完成通知
+        bool enableErrors();
+        bool disableErrors();
+        bool isWatchingErrors() const { return m_events & kErrorEvent; }
+
+        // 边缘触发模式，需要在第一次enableReading()/enableWriting()之前设置
+        // 只有Poller支持时才有意义，见EventLoop::supportsEdgeTriggered()
+        void setEdgeTriggered(bool on) { m_edgeTriggered = on; }
+        bool isEdgeTriggered() const { return m_edgeTriggered; }
 
         int index() { return m_index; }
         void set_index(int idx) { m_index = idx; }
@@ -68,12 +79,14 @@ namespace net
         static const int kNoneEvent;
         static const int kReadEvent;
         static const int kWriteEvent;
+        static const int kErrorEvent;
 
         EventLoop *m_loop;
         const int m_fd;
         int m_events;
         int m_revents;
         int m_index;
+        bool m_edgeTriggered;
 
         ReadEventCallback m_readCallback;
         EventCallback m_writeCallback;
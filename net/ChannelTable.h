@@ -0,0 +1,142 @@
+/*
+ *  Filename:   ChannelTable.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:以fd为下标的Channel表，各个Poller共用
+ *              Linux上fd是从小到大分配的连续整数，直接用vector按fd下标访问，
+ *              查找是一次数组访问，代替原来std::map每次O(log n)的指针跳转，
+ *              每个槽位带一个generation，fd被关闭后复用时加1，
+ *              注册到内核的标识里同时带上fd和generation，就能识别出属于旧Channel的过期事件
+ */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace net
+{
+    class Channel;
+
+    struct ChannelTableNoData
+    {
+    };
+
+    // Data是Poller需要跟每个fd一起保存的额外信息，比如io_uring当前登记的事件
+    template <typename Data = ChannelTableNoData>
+    class ChannelTable
+    {
+    public:
+        struct Slot : public Data
+        {
+            Channel *channel = nullptr;
+            uint32_t generation = 0;
+        };
+
+        ChannelTable() : m_size(0)
+        {
+        }
+
+        ChannelTable(const ChannelTable &rhs) = delete;
+        ChannelTable &operator=(const ChannelTable &rhs) = delete;
+
+        // fd当前对应的Channel，没有返回nullptr
+        Channel *find(int fd) const
+        {
+            if (fd < 0 || static_cast<size_t>(fd) >= m_slots.size())
+                return nullptr;
+            return m_slots[fd].channel;
+        }
+
+        bool contains(const Channel *channel, int fd) const
+        {
+            return channel != nullptr && find(fd) == channel;
+        }
+
+        // fd上有Channel时返回对应的槽位，否则返回nullptr
+        Slot *slot(int fd)
+        {
+            if (fd < 0 || static_cast<size_t>(fd) >= m_slots.size() || m_slots[fd].channel == nullptr)
+                return nullptr;
+            return &m_slots[fd];
+        }
+
+        // fd上已经有Channel时返回nullptr
+        Slot *add(int fd, Channel *channel)
+        {
+            if (fd < 0 || channel == nullptr)
+                return nullptr;
+
+            if (static_cast<size_t>(fd) >= m_slots.size())
+            {
+                size_t newSize = m_slots.empty() ? kInitSize : m_slots.size();
+                while (newSize <= static_cast<size_t>(fd))
+                    newSize *= 2;
+                m_slots.resize(newSize);
+            }
+
+            Slot &s = m_slots[fd];
+            if (s.channel != nullptr)
+                return nullptr;
+
+            // 不清零，保证同一个fd上先后出现的Channel的generation都不一样
+            uint32_t generation = s.generation + 1;
+            s = Slot();
+            s.channel = channel;
+            s.generation = generation;
+            ++m_size;
+            return &s;
+        }
+
+        bool remove(int fd)
+        {
+            Slot *s = slot(fd);
+            if (s == nullptr)
+                return false;
+
+            s->channel = nullptr;
+            --m_size;
+            return true;
+        }
+
+        size_t size() const { return m_size; }
+
+        // 注册到内核的标识(epoll_event.data.u64等)，高32位是fd，低32位是generation
+        // generation从1开始，所以标识不会是0
+        uint64_t tag(int fd) const
+        {
+            return makeTag(fd, m_slots[fd].generation);
+        }
+
+        // 根据内核返回的标识查找，fd已经换了Channel(generation不一致)时返回nullptr
+        Slot *findByTag(uint64_t tag)
+        {
+            Slot *s = slot(tagFd(tag));
+            if (s == nullptr || s->generation != tagGeneration(tag))
+                return nullptr;
+            return s;
+        }
+
+        static uint64_t makeTag(int fd, uint32_t generation)
+        {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(fd)) << 32) | generation;
+        }
+
+        static int tagFd(uint64_t tag)
+        {
+            return static_cast<int>(tag >> 32);
+        }
+
+        static uint32_t tagGeneration(uint64_t tag)
+        {
+            return static_cast<uint32_t>(tag);
+        }
+
+    private:
+        static const size_t kInitSize = 64;
+
+        std::vector<Slot> m_slots;
+        size_t m_size;
+    };
+}
@@ -0,0 +1,449 @@
+/*
+ *  Filename:   CompositeByteBuffer.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:由多个引用计数内存块串起来的缓冲区
+ */
+
+#include "CompositeByteBuffer.h"
+
+#include <algorithm>
+#include <new>
+
+#include "BufferPool.h"
+
+using namespace net;
+
+const size_t BufferChunk::kHeaderSize;
+const size_t CompositeByteBuffer::kDefaultChunkSize;
+
+namespace
+{
+    // 一次writev最多带这么多段，不超过IOV_MAX
+    const int kMaxIovecs = 64;
+}
+
+BufferChunk *BufferChunk::create(size_t capacity)
+{
+    static_assert(sizeof(BufferChunk) <= kHeaderSize, "BufferChunk header too large");
+    size_t blockSize = 0;
+    void *block = BufferPool::allocate(kHeaderSize + capacity, &blockSize);
+    return new (block) BufferChunk(blockSize);
+}
+
+void BufferChunk::destroy()
+{
+    size_t blockSize = m_blockSize;
+    this->~BufferChunk();
+    BufferPool::deallocate(this, blockSize);
+}
+
+CompositeByteBuffer::CompositeByteBuffer(const CompositeByteBuffer &rhs)
+    : m_chunkSize(rhs.m_chunkSize),
+      m_readableBytes(0),
+      m_writeChunk(NULL),
+      m_writeOffset(0)
+{
+    append(rhs);
+}
+
+CompositeByteBuffer::~CompositeByteBuffer()
+{
+    release();
+    if (m_writeChunk != NULL)
+        m_writeChunk->release();
+}
+
+void CompositeByteBuffer::swap(CompositeByteBuffer &rhs)
+{
+    std::swap(m_chunkSize, rhs.m_chunkSize);
+    m_segments.swap(rhs.m_segments);
+    std::swap(m_readableBytes, rhs.m_readableBytes);
+    std::swap(m_writeChunk, rhs.m_writeChunk);
+    std::swap(m_writeOffset, rhs.m_writeOffset);
+}
+
+void CompositeByteBuffer::release()
+{
+    for (Segment &segment : m_segments)
+        segment.m_chunk->release();
+    m_segments.clear();
+    m_readableBytes = 0;
+    recycleWriteChunk();
+}
+
+void CompositeByteBuffer::append(const void * /*restrict*/ data, size_t len)
+{
+    const char *d = static_cast<const char *>(data);
+    while (len > 0)
+    {
+        if (tailWritable() == 0)
+            newWriteChunk();
+
+        size_t n = std::min(len, tailWritable());
+        ::memcpy(m_writeChunk->data() + m_writeOffset, d, n);
+        hasWritten(n);
+        d += n;
+        len -= n;
+    }
+}
+
+void CompositeByteBuffer::append(const CompositeByteBuffer &other)
+{
+    // other可能就是自己，先记下段数
+    size_t count = other.m_segments.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Segment &segment = other.m_segments[i];
+        append(segment.m_chunk, segment.m_data, segment.m_length);
+    }
+}
+
+void CompositeByteBuffer::append(CompositeByteBuffer &&other)
+{
+    if (&other == this)
+        return;
+
+    // 直接接管other的段和它们的引用，不用增减引用计数
+    for (const Segment &segment : other.m_segments)
+    {
+        if (!m_segments.empty() && m_segments.back().m_chunk == segment.m_chunk &&
+            m_segments.back().m_data + m_segments.back().m_length == segment.m_data)
+        {
+            m_segments.back().m_length += segment.m_length;
+            segment.m_chunk->release();
+        }
+        else
+        {
+            m_segments.push_back(segment);
+        }
+        m_readableBytes += segment.m_length;
+    }
+    other.m_segments.clear();
+    other.m_readableBytes = 0;
+    other.recycleWriteChunk();
+}
+
+void CompositeByteBuffer::append(BufferChunk *chunk, const char *data, size_t len)
+{
+    if (len == 0)
+        return;
+
+    // 和上一段在同一块里并且首尾相接时直接延长，上一段已经持有这块的引用
+    if (!m_segments.empty() && m_segments.back().m_chunk == chunk &&
+        m_segments.back().m_data + m_segments.back().m_length == data)
+    {
+        m_segments.back().m_length += len;
+    }
+    else
+    {
+        chunk->retain();
+        Segment segment = {chunk, data, len};
+        m_segments.push_back(segment);
+    }
+    m_readableBytes += len;
+}
+
+CompositeByteBuffer CompositeByteBuffer::slice(size_t offset, size_t len) const
+{
+    CompositeByteBuffer result(m_chunkSize);
+    if (offset > m_readableBytes || len > m_readableBytes - offset)
+        return result;
+
+    for (size_t i = 0; i < m_segments.size() && len > 0; ++i)
+    {
+        const Segment &segment = m_segments[i];
+        if (offset >= segment.m_length)
+        {
+            offset -= segment.m_length;
+            continue;
+        }
+
+        size_t n = std::min(len, segment.m_length - offset);
+        result.append(segment.m_chunk, segment.m_data + offset, n);
+        offset = 0;
+        len -= n;
+    }
+    return result;
+}
+
+CompositeByteBuffer CompositeByteBuffer::readSlice(size_t len)
+{
+    CompositeByteBuffer result(m_chunkSize);
+    if (len > m_readableBytes)
+        return result;
+
+    m_readableBytes -= len;
+    while (len > 0)
+    {
+        Segment &front = m_segments.front();
+        if (front.m_length <= len)
+        {
+            // 整段连同引用一起交给result
+            len -= front.m_length;
+            result.m_segments.push_back(front);
+            result.m_readableBytes += front.m_length;
+            m_segments.pop_front();
+        }
+        else
+        {
+            result.append(front.m_chunk, front.m_data, len);
+            front.m_data += len;
+            front.m_length -= len;
+            len = 0;
+        }
+    }
+    if (m_segments.empty())
+        recycleWriteChunk();
+    return result;
+}
+
+bool CompositeByteBuffer::retrieve(size_t len)
+{
+    if (len > m_readableBytes)
+        return false;
+
+    m_readableBytes -= len;
+    while (len > 0)
+    {
+        Segment &front = m_segments.front();
+        if (front.m_length <= len)
+        {
+            len -= front.m_length;
+            front.m_chunk->release();
+            m_segments.pop_front();
+        }
+        else
+        {
+            front.m_data += len;
+            front.m_length -= len;
+            len = 0;
+        }
+    }
+    if (m_segments.empty())
+        recycleWriteChunk();
+    return true;
+}
+
+std::string CompositeByteBuffer::retrieveAsString(size_t len)
+{
+    if (len > m_readableBytes)
+        return "";
+
+    std::string result(len, '\0');
+    copyOut(&result[0], len);
+    retrieve(len);
+    return result;
+}
+
+std::string CompositeByteBuffer::toString() const
+{
+    std::string result;
+    result.reserve(m_readableBytes);
+    for (const Segment &segment : m_segments)
+        result.append(segment.m_data, segment.m_length);
+    return result;
+}
+
+bool CompositeByteBuffer::copyOut(void *out, size_t len, size_t offset) const
+{
+    if (offset > m_readableBytes || len > m_readableBytes - offset)
+        return false;
+
+    char *dest = static_cast<char *>(out);
+    for (size_t i = 0; i < m_segments.size() && len > 0; ++i)
+    {
+        const Segment &segment = m_segments[i];
+        if (offset >= segment.m_length)
+        {
+            offset -= segment.m_length;
+            continue;
+        }
+
+        size_t n = std::min(len, segment.m_length - offset);
+        ::memcpy(dest, segment.m_data + offset, n);
+        dest += n;
+        len -= n;
+        offset = 0;
+    }
+    return true;
+}
+
+int64_t CompositeByteBuffer::find(char ch, size_t offset) const
+{
+    size_t base = 0;
+    for (const Segment &segment : m_segments)
+    {
+        if (offset < base + segment.m_length)
+        {
+            size_t skip = offset > base ? offset - base : 0;
+            const void *found = ::memchr(segment.m_data + skip, ch, segment.m_length - skip);
+            if (found != NULL)
+                return static_cast<int64_t>(base + (static_cast<const char *>(found) - segment.m_data));
+        }
+        base += segment.m_length;
+    }
+    return -1;
+}
+
+int64_t CompositeByteBuffer::peekInt64() const
+{
+    int64_t be64 = 0;
+    if (!copyOut(&be64, sizeof be64))
+        return -1;
+    return sockets::networkToHost64(be64);
+}
+
+int32_t CompositeByteBuffer::peekInt32() const
+{
+    int32_t be32 = 0;
+    if (!copyOut(&be32, sizeof be32))
+        return -1;
+    return sockets::networkToHost32(be32);
+}
+
+int16_t CompositeByteBuffer::peekInt16() const
+{
+    int16_t be16 = 0;
+    if (!copyOut(&be16, sizeof be16))
+        return -1;
+    return sockets::networkToHost16(be16);
+}
+
+int8_t CompositeByteBuffer::peekInt8() const
+{
+    if (m_segments.empty())
+        return -1;
+    return static_cast<int8_t>(*m_segments.front().m_data);
+}
+
+#ifndef _WIN32
+int CompositeByteBuffer::fillIovec(struct iovec *iov, int maxIov) const
+{
+    int count = 0;
+    for (size_t i = 0; i < m_segments.size() && count < maxIov; ++i, ++count)
+    {
+        iov[count].iov_base = const_cast<char *>(m_segments[i].m_data);
+        iov[count].iov_len = m_segments[i].m_length;
+    }
+    return count;
+}
+#endif
+
+int32_t CompositeByteBuffer::readFd(int fd, int *savedErrno, size_t expected)
+{
+    if (tailWritable() == 0)
+        newWriteChunk();
+    const size_t writable = tailWritable();
+#ifndef _WIN32
+    // 当前块剩余的空间不够expected时才多读进一个新块，新块用上了就换成可写块，没用上还给BufferPool
+    if (expected == 0)
+        expected = m_chunkSize - BufferChunk::kHeaderSize;
+    BufferChunk *spare = NULL;
+    struct iovec vec[2];
+    vec[0].iov_base = m_writeChunk->data() + m_writeOffset;
+    vec[0].iov_len = writable;
+    int iovcnt = 1;
+    if (writable < expected)
+    {
+        spare = BufferChunk::create(m_chunkSize - BufferChunk::kHeaderSize);
+        vec[1].iov_base = spare->data();
+        vec[1].iov_len = spare->capacity();
+        iovcnt = 2;
+    }
+    const ssize_t n = sockets::readv(fd, vec, iovcnt);
+#else
+    (void)expected;
+    const int32_t n = sockets::read(fd, m_writeChunk->data() + m_writeOffset, static_cast<int32_t>(writable));
+#endif
+    if (n <= 0)
+    {
+#ifdef _WIN32
+        *savedErrno = ::WSAGetLastError();
+#else
+        *savedErrno = errno;
+#endif
+    }
+    else if (static_cast<size_t>(n) <= writable)
+    {
+        hasWritten(n);
+    }
+#ifndef _WIN32
+    else
+    {
+        hasWritten(writable);
+        setWriteChunk(spare);
+        spare = NULL;
+        hasWritten(n - writable);
+    }
+
+    if (spare != NULL)
+        spare->release();
+#endif
+    return static_cast<int32_t>(n);
+}
+
+int32_t CompositeByteBuffer::writeFd(int fd, int *savedErrno)
+{
+    if (m_segments.empty())
+        return 0;
+
+#ifndef _WIN32
+    struct iovec vec[kMaxIovecs];
+    int count = fillIovec(vec, kMaxIovecs);
+    const ssize_t n = sockets::writev(fd, vec, count);
+#else
+    const Segment &front = m_segments.front();
+    // 共享进来的大视图可能超过2GB，一次只写int32_t放得下的部分
+    const int32_t n = sockets::write(fd, front.m_data, static_cast<int32_t>(std::min<size_t>(front.m_length, INT32_MAX)));
+#endif
+    if (n < 0)
+    {
+#ifdef _WIN32
+        *savedErrno = ::WSAGetLastError();
+#else
+        *savedErrno = errno;
+#endif
+    }
+    else
+    {
+        retrieve(n);
+    }
+    return static_cast<int32_t>(n);
+}
+
+size_t CompositeByteBuffer::tailWritable() const
+{
+    return m_writeChunk == NULL ? 0 : m_writeChunk->capacity() - m_writeOffset;
+}
+
+void CompositeByteBuffer::hasWritten(size_t len)
+{
+    append(m_writeChunk, m_writeChunk->data() + m_writeOffset, len);
+    m_writeOffset += len;
+}
+
+void CompositeByteBuffer::newWriteChunk()
+{
+    // 写满的块如果已经没有任何段引用，直接从头复用
+    if (m_writeChunk != NULL && m_writeChunk->refCount() == 1)
+    {
+        m_writeOffset = 0;
+        return;
+    }
+    setWriteChunk(BufferChunk::create(m_chunkSize - BufferChunk::kHeaderSize));
+}
+
+void CompositeByteBuffer::setWriteChunk(BufferChunk *chunk)
+{
+    if (m_writeChunk != NULL)
+        m_writeChunk->release();
+    m_writeChunk = chunk;
+    m_writeOffset = 0;
+}
+
+void CompositeByteBuffer::recycleWriteChunk()
+{
+    if (m_writeChunk != NULL && m_writeChunk->refCount() == 1)
+        m_writeOffset = 0;
+}
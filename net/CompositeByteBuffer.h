@@ -0,0 +1,277 @@
+/*
+ *  Filename:   CompositeByteBuffer.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:由多个引用计数内存块串起来的缓冲区，仿照Netty的CompositeByteBuf和slice/retain/release
+ *              ByteBuffer是一整块连续内存，追加大块数据要扩容拷贝，makeSpace还要挪动可读数据；
+ *              CompositeByteBuffer按块(默认16KB)从BufferPool申请内存，写满一块接着申请下一块，已有的数据从不挪动；
+ *              slice/readSlice得到的是共享同一批内存块的视图，只增加引用计数，不拷贝数据，
+ *              跨越块边界的数据也一样，视图可以交给应用层保存，也可以直接用writev发出去；
+ *              复制一个CompositeByteBuffer就是retain，析构或者release()就是release，最后一个引用释放时内存块还给BufferPool
+ *              只有缓冲区自己申请的最后一块可以继续追加，视图和共享进来的块都是只读的
+ *              同一个CompositeByteBuffer对象不是线程安全的，引用计数是原子的，不同线程可以各自持有共享同一块内存的视图
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <string.h>
+
+#include "../base/Platform.h"
+#include "Sockets.h"
+#include "Endian.h"
+#include "RingDeque.h"
+
+namespace net
+{
+    // 引用计数的内存块，头部和数据在同一块BufferPool内存里
+    class BufferChunk
+    {
+    public:
+        // 申请一块至少能放capacity字节的内存块，引用计数为1
+        static BufferChunk *create(size_t capacity);
+
+        void retain()
+        {
+            m_refCount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // 引用计数降到0时把内存还给BufferPool
+        void release()
+        {
+            if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                destroy();
+        }
+
+        // 返回1时说明没有别人持有，可以放心改写块里的数据
+        int refCount() const
+        {
+            return m_refCount.load(std::memory_order_acquire);
+        }
+
+        char *data()
+        {
+            return reinterpret_cast<char *>(this) + kHeaderSize;
+        }
+
+        size_t capacity() const
+        {
+            return m_blockSize - kHeaderSize;
+        }
+
+        // 块头占一个缓存行，数据从64字节对齐的位置开始
+        static const size_t kHeaderSize = 64;
+
+    private:
+        explicit BufferChunk(size_t blockSize) : m_refCount(1), m_blockSize(blockSize) {}
+        void destroy();
+
+        std::atomic<int> m_refCount;
+        size_t m_blockSize; // BufferPool返回的实际大小，释放时原样传回
+    };
+
+    class CompositeByteBuffer
+    {
+    public:
+        // 一段连续的可读数据，持有所在内存块的一个引用
+        struct Segment
+        {
+            BufferChunk *m_chunk;
+            const char *m_data;
+            size_t m_length;
+        };
+
+        // 每块的大小(包括块头)，正好是BufferPool的一个等级
+        static const size_t kDefaultChunkSize = 16 * 1024;
+
+        explicit CompositeByteBuffer(size_t chunkSize = kDefaultChunkSize)
+            : m_chunkSize(chunkSize),
+              m_readableBytes(0),
+              m_writeChunk(NULL),
+              m_writeOffset(0)
+        {
+        }
+
+        // 共享rhs的内存块(retain)，不拷贝数据
+        CompositeByteBuffer(const CompositeByteBuffer &rhs);
+
+        CompositeByteBuffer(CompositeByteBuffer &&rhs) noexcept
+            : m_chunkSize(rhs.m_chunkSize),
+              m_readableBytes(0),
+              m_writeChunk(NULL),
+              m_writeOffset(0)
+        {
+            swap(rhs);
+        }
+
+        CompositeByteBuffer &operator=(CompositeByteBuffer rhs)
+        {
+            swap(rhs);
+            return *this;
+        }
+
+        ~CompositeByteBuffer();
+
+        void swap(CompositeByteBuffer &rhs);
+
+        size_t readableBytes() const
+        {
+            return m_readableBytes;
+        }
+
+        bool empty() const
+        {
+            return m_readableBytes == 0;
+        }
+
+        size_t segmentCount() const
+        {
+            return m_segments.size();
+        }
+
+        const Segment &segment(size_t i) const
+        {
+            return m_segments[i];
+        }
+
+        // 放弃所有数据，释放所有段持有的内存块引用；可写块留着下次追加
+        void release();
+
+        void append(const std::string &str)
+        {
+            append(str.data(), str.size());
+        }
+
+        // 拷贝进当前可写的块，写满了申请新块
+        void append(const void * /*restrict*/ data, size_t len);
+        // 共享other的内存块，不拷贝
+        void append(const CompositeByteBuffer &other);
+        void append(CompositeByteBuffer &&other);
+        // 引用chunk里[data, data + len)这一段，增加chunk的引用计数
+        void append(BufferChunk *chunk, const char *data, size_t len);
+
+        void appendInt64(int64_t x)
+        {
+            int64_t be64 = sockets::hostToNetwork64(x);
+            append(&be64, sizeof be64);
+        }
+
+        void appendInt32(int32_t x)
+        {
+            int32_t be32 = sockets::hostToNetwork32(x);
+            append(&be32, sizeof be32);
+        }
+
+        void appendInt16(int16_t x)
+        {
+            int16_t be16 = sockets::hostToNetwork16(x);
+            append(&be16, sizeof be16);
+        }
+
+        void appendInt8(int8_t x)
+        {
+            append(&x, sizeof x);
+        }
+
+        // 从读位置往后offset字节开始、长度len的视图，不拷贝，不移动读位置；越界时返回空缓冲区
+        CompositeByteBuffer slice(size_t offset, size_t len) const;
+        // 前len字节的视图，并从当前缓冲区里取走
+        CompositeByteBuffer readSlice(size_t len);
+
+        bool retrieve(size_t len);
+
+        void retrieveAll()
+        {
+            release();
+        }
+
+        std::string retrieveAsString(size_t len);
+
+        std::string retrieveAllAsString()
+        {
+            return retrieveAsString(readableBytes());
+        }
+
+        std::string toString() const;
+
+        // 从读位置往后offset字节开始拷贝len字节到out，数据不够时返回false
+        bool copyOut(void *out, size_t len, size_t offset = 0) const;
+
+        // 前len字节在同一个内存块里时返回它们的地址，跨块或者数据不够时返回nullptr，调用者再用copyOut
+        const char *contiguous(size_t len) const
+        {
+            if (m_segments.empty() || m_segments.front().m_length < len)
+                return nullptr;
+            return m_segments.front().m_data;
+        }
+
+        // 第一个ch相对读位置的偏移，从读位置往后offset字节开始找，找不到返回-1
+        int64_t find(char ch, size_t offset = 0) const;
+
+        int64_t peekInt64() const;
+        int32_t peekInt32() const;
+        int16_t peekInt16() const;
+        int8_t peekInt8() const;
+
+        int64_t readInt64()
+        {
+            int64_t result = peekInt64();
+            retrieve(sizeof(int64_t));
+            return result;
+        }
+
+        int32_t readInt32()
+        {
+            int32_t result = peekInt32();
+            retrieve(sizeof(int32_t));
+            return result;
+        }
+
+        int16_t readInt16()
+        {
+            int16_t result = peekInt16();
+            retrieve(sizeof(int16_t));
+            return result;
+        }
+
+        int8_t readInt8()
+        {
+            int8_t result = peekInt8();
+            retrieve(sizeof(int8_t));
+            return result;
+        }
+
+#ifndef _WIN32
+        // 把可读数据按段填进iov，最多maxIov段，返回填了几段，给writev用
+        int fillIovec(struct iovec *iov, int maxIov) const;
+#endif
+
+        /// 直接读进当前块剩余的空间，数据不用再拷贝；剩余空间不到expected字节时再带上一个新块一起读，
+        /// 新块没用上就还回去，空间足够时不申请；expected为0时按一个块的大小算
+        /// @return result of read(2), @c errno is saved
+        int32_t readFd(int fd, int *savedErrno, size_t expected = 0);
+        /// 用writev把可读数据写出去，写出去的部分从缓冲区里取走
+        /// @return result of write(2), @c errno is saved
+        int32_t writeFd(int fd, int *savedErrno);
+
+    private:
+        // 可写块还能追加的字节数，没有可写块时为0
+        size_t tailWritable() const;
+        // 在当前块末尾追加了len字节，延长最后一段或者新起一段
+        void hasWritten(size_t len);
+        // 换一个新的可写块
+        void newWriteChunk();
+        void setWriteChunk(BufferChunk *chunk);
+        // 所有段都取走之后，可写块没有别人引用时从头开始复用
+        void recycleWriteChunk();
+
+        size_t m_chunkSize;
+        RingDeque<Segment> m_segments; // 队头取走、队尾追加交替进行，std::deque会反复申请和释放内部块
+        size_t m_readableBytes;
+
+        // 当前缓冲区自己申请的最后一块，单独持有一个引用，m_writeOffset之后的空间还没有任何视图引用，可以追加
+        BufferChunk *m_writeChunk;
+        size_t m_writeOffset;
+    };
+}
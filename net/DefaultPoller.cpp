@@ -0,0 +1,86 @@
+/*
+ *  Filename:   DefaultPoller.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:根据配置和系统支持情况创建Poller
+ */
+
+#include "Poller.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+
+#include "../base/AsyncLog.h"
+
+#ifdef _WIN32
+#include "SelectPoller.h"
+#else
+#include "EpollPoller.h"
+#include "PollPoller.h"
+#include "IoUringPoller.h"
+#endif
+
+using namespace net;
+
+namespace
+{
+    std::atomic<int> s_defaultPollerType(Poller::kDefault);
+
+    Poller::PollerType pollerTypeFromEnv()
+    {
+        const char *name = ::getenv("NETTY_CPP_POLLER");
+        if (name == NULL)
+            return Poller::kDefault;
+
+        if (strcmp(name, "select") == 0)
+            return Poller::kSelect;
+        if (strcmp(name, "poll") == 0)
+            return Poller::kPoll;
+        if (strcmp(name, "epoll") == 0)
+            return Poller::kEpoll;
+        if (strcmp(name, "io_uring") == 0)
+            return Poller::kIoUring;
+
+        LOG_WARN("unknown NETTY_CPP_POLLER: %s, use default poller", name);
+        return Poller::kDefault;
+    }
+}
+
+void Poller::setDefaultPollerType(PollerType type)
+{
+    s_defaultPollerType = type;
+}
+
+Poller *Poller::newDefaultPoller(EventLoop *loop)
+{
+    PollerType type = pollerTypeFromEnv();
+    if (type == kDefault)
+        type = static_cast<PollerType>(s_defaultPollerType.load());
+
+#ifdef _WIN32
+    (void)type;
+    return new SelectPoller(loop);
+#else
+    switch (type)
+    {
+    case kPoll:
+        return new PollPoller(loop);
+
+    case kIoUring:
+    {
+        // 内核版本太低或者io_uring被禁用(比如容器的seccomp策略)时退回到epoll
+        std::unique_ptr<IoUringPoller> poller(new IoUringPoller(loop));
+        if (poller->valid())
+            return poller.release();
+
+        LOG_WARN("io_uring is not supported by the kernel, fall back to epoll");
+        return new EPollPoller(loop);
+    }
+
+    default:
+        return new EPollPoller(loop);
+    }
+#endif
+}
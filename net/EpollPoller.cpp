@@ -11,6 +11,7 @@
 #include <string.h>
 #include "../base/Platform.h"
 #include "../base/AsyncLog.h"
+#include "../base/Clock.h"
 #include "EventLoop.h"
 #include "Channel.h"
 
@@ -42,8 +43,7 @@ EPollPoller::~EPollPoller()
 bool EPollPoller::hasChannel(Channel *channel) const
 {
     assertInLoopThread();
-    ChannelMap::const_iterator it = m_channels.find(channel->fd());
-    return it != m_channels.end() && it->second == channel;
+    return m_channels.contains(channel, channel->fd());
 }
 
 void EPollPoller::assertInLoopThread() const
@@ -51,14 +51,14 @@ void EPollPoller::assertInLoopThread() const
     m_ownerLoop->assertInLoopThread();
 }
 
-Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
+int64_t EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
     int numEvents = ::epoll_wait(m_epollfd,
                                  &*m_events.begin(),
                                  static_cast<int>(m_events.size()),
                                  timeoutMs);
     int savedErrno = errno;
-    Timestamp now(Timestamp::now());
+    int64_t now = Clock::monotonicUs();
     if (numEvents > 0)
     {
         // LOG_TRACE << numEvents << " events happended";
@@ -84,15 +84,15 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
     return now;
 }
 
-void EPollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels) const
+void EPollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels)
 {
     for (int i = 0; i < numEvents; ++i)
     {
-        Channel *channel = static_cast<Channel *>(m_events[i].data.ptr);
-        int fd = channel->fd();
-        ChannelMap::const_iterator it = m_channels.find(fd);
-        if (it == m_channels.end() || it->second != channel)
-            return;
+        // 已经不属于当前Channel的过期事件直接丢弃
+        ChannelTable<>::Slot *slot = m_channels.findByTag(m_events[i].data.u64);
+        if (slot == nullptr)
+            continue;
+        Channel *channel = slot->channel;
         channel->set_revents(m_events[i].events);
         activeChannels->push_back(channel);
     }
@@ -108,23 +108,22 @@ bool EPollPoller::updateChannel(Channel *channel)
         int fd = channel->fd();
         if (index == kNew)
         {
-            if (m_channels.find(fd) != m_channels.end())
+            if (m_channels.add(fd, channel) == nullptr)
             {
                 LOGE("fd = %d  must not exist in channels_", fd);
                 return false;
             }
-            m_channels[fd] = channel;
         }
         else // index == kDeleted
         {
-            if (m_channels.find(fd) == m_channels.end())
+            if (m_channels.find(fd) == nullptr)
             {
                 LOGE("fd = %d  must exist in channels_", fd);
                 return false;
             }
 
             // assert(channels_[fd] == channel);
-            if (m_channels[fd] != channel)
+            if (m_channels.find(fd) != channel)
             {
                 LOGE("current channel is not matched current fd, fd = %d", fd);
                 return false;
@@ -138,7 +137,7 @@ bool EPollPoller::updateChannel(Channel *channel)
     {
         // update existing one with EPOLL_CTL_MOD/DEL
         int fd = channel->fd();
-        if (m_channels.find(fd) == m_channels.end() || m_channels[fd] != channel || index != kAdded)
+        if (m_channels.find(fd) != channel || index != kAdded)
         {
             LOGE("current channel is not matched current fd, fd = %d, channel = 0x%x", fd, channel);
             return false;
@@ -165,21 +164,19 @@ void EPollPoller::removeChannel(Channel *channel)
     assertInLoopThread();
     int fd = channel->fd();
 
-    if (m_channels.find(fd) == m_channels.end() || m_channels[fd] != channel || !channel->isNoneEvent())
+    if (m_channels.find(fd) != channel || !channel->isNoneEvent())
         return;
 
     int index = channel->index();
     if (index != kAdded && index != kDeleted)
         return;
 
-    size_t n = m_channels.erase(fd);
-    if (n != 1)
-        return;
-
+    // 先从内核中删除再从表中删除，update()需要用到表中的generation
     if (index == kAdded)
     {
         update(XEPOLL_CTL_DEL, channel);
     }
+    m_channels.remove(fd);
     channel->set_index(kNew);
 }
 
@@ -188,8 +185,8 @@ bool EPollPoller::update(int operation, Channel *channel)
     struct epoll_event event;
     memset(&event, 0, sizeof event);
     event.events = channel->events();
-    event.data.ptr = channel;
     int fd = channel->fd();
+    event.data.u64 = m_channels.tag(fd);
     if (::epoll_ctl(m_epollfd, operation, fd, &event) < 0)
     {
         if (operation == XEPOLL_CTL_DEL)
@@ -10,10 +10,9 @@
 #ifndef _WIN32
 
 #include <vector>
-#include <map>
 
-#include "../base/Timestamp.h"
 #include "Poller.h"
+#include "ChannelTable.h"
 
 struct epoll_event;
 
@@ -27,18 +26,19 @@ namespace net
         EPollPoller(EventLoop *loop);
         virtual ~EPollPoller();
 
-        virtual Timestamp poll(int timeoutMs, ChannelList *activeChannels);
+        virtual int64_t poll(int timeoutMs, ChannelList *activeChannels);
         virtual bool updateChannel(Channel *channel);
         virtual void removeChannel(Channel *channel);
 
         virtual bool hasChannel(Channel *channel) const;
+        virtual bool supportsEdgeTriggered() const { return true; }
 
         void assertInLoopThread() const;
 
     private:
         static const int kInitEventListSize = 16;
 
-        void fillActiveChannels(int numEvents, ChannelList *activeChannels) const;
+        void fillActiveChannels(int numEvents, ChannelList *activeChannels);
         bool update(int operation, Channel *channel);
 
     private:
@@ -47,9 +47,8 @@ namespace net
         int m_epollfd;
         EventList m_events;
 
-        typedef std::map<int, Channel *> ChannelMap;
-
-        ChannelMap m_channels;
+        // epoll_event.data.u64里保存的是ChannelTable::tag()
+        ChannelTable<> m_channels;
         EventLoop *m_ownerLoop;
     };
 }
@@ -12,21 +12,40 @@
 #include <string.h>
 
 #include "../base/AsyncLog.h"
+#include "../base/Clock.h"
 #include "Channel.h"
 #include "Sockets.h"
 #include "InetAddress.h"
 
-#ifdef _WIN32
-#include "SelectPoller.h"
-#else
-#include "EpollPoller.h"
-#endif
+#include "Poller.h"
+#include "ZeroCopyReaper.h"
 
 using namespace net;
 
 thread_local EventLoop *t_loopInThisThread = 0;
 
-const int kPollTimeMs = 1;
+// Linux上定时器由timerfd驱动，poll可以一直阻塞到有事件或者被wakeup()唤醒
+// Windows上没有timerfd，poll的超时时间由最早到期的定时器决定，kPollTimeMs只是上限
+const int kPollTimeMs = 10000;
+// loop线程最多缓存多少个执行完的任务节点，多出来的直接释放
+const size_t kMaxFreeTasks = 1024;
+// pollReturnTime()换算用的墙上时间偏移的校正间隔，系统时间被调整后最多这么久就能反映出来
+const int64_t kWallClockSyncUs = 1000 * 1000;
+
+namespace
+{
+    // 自旋等待时降低CPU功耗，并让出流水线给同一个物理核上的另一个超线程
+    inline void cpuRelax()
+    {
+#if defined(_WIN32)
+        YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+}
 
 EventLoop *getEventLoopOfCurrentThread()
 {
@@ -39,20 +58,42 @@ EventLoop::EventLoop() : m_looping(false),
                          m_eventHandling(false),
                          m_doingOtherTasks(false),
                          m_threadId(std::this_thread::get_id()),
-                         m_timerQueue(new TimerQueue(this)),
+                         m_loopNowUs(Clock::monotonicUs()),
+                         m_wallClockOffsetUs(0),
+                         m_wallClockSyncUs(0),
                          m_iteration(0L),
-                         currentActiveChannel_(NULL)
+                         currentActiveChannel_(NULL),
+                         m_pendingCount(0),
+                         m_wakeupPending(false),
+                         m_freeTasks(NULL),
+                         m_freeTaskCount(0),
+                         m_busyPollUs(0),
+                         m_socketBusyPollUs(0),
+                         m_spinCount(0),
+                         m_spinHits(0),
+                         m_spinMicroSeconds(0),
+                         m_statsEnabled(false),
+                         m_stats(new LoopStats()),
+                         m_dispatchTimerNs(0),
+                         m_connectionCount(0),
+                         m_bytesTransferred(0)
 {
+    for (int i = 0; i < kConnectionTimeoutTypes; ++i)
+        m_timeoutCounts[i].store(0, std::memory_order_relaxed);
+    m_wallClockSyncUs = m_loopNowUs - kWallClockSyncUs;
+    updatePollReturnTime();
+
     createWakeupfd();
 
 #ifdef _WIN32
     m_wakeupChannel.reset(new Channel(this, m_wakeupFdRecv));
-    m_poller.reset(new SelectPoller(this));
-
 #else
     m_wakeupChannel.reset(new Channel(this, m_wakeupFd));
-    m_poller.reset(new EPollPoller(this));
 #endif
+    m_poller.reset(Poller::newDefaultPoller(this));
+
+    // TimerQueue在Linux上要把timerfd注册到poller上，所以必须在poller创建之后构造
+    m_timerQueue.reset(new TimerQueue(this));
 
     if (t_loopInThisThread)
     {
@@ -71,6 +112,7 @@ EventLoop::~EventLoop()
 {
     assertInLoopThread();
     LOG_DEBUG("EventLoop 0x%x destructs.", this);
+    m_zeroCopyReaper.reset();
 
     m_wakeupChannel->disableAll();
     m_wakeupChannel->remove();
@@ -83,6 +125,17 @@ EventLoop::~EventLoop()
     sockets::close(m_wakeupFd);
 #endif
 
+    while (PendingTask *task = m_pendingFunctors.pop())
+    {
+        delete task;
+    }
+    while (m_freeTasks != NULL)
+    {
+        PendingTask *task = m_freeTasks;
+        m_freeTasks = static_cast<PendingTask *>(task->m_next.load(std::memory_order_relaxed));
+        delete task;
+    }
+
     t_loopInThisThread = NULL;
 }
 
@@ -95,26 +148,66 @@ void EventLoop::loop()
 
     while (!m_quit)
     {
+#ifdef _WIN32
+        m_loopNowUs = Clock::monotonicUs();
         m_timerQueue->doTimer();
+        int timeoutMs = pollTimeoutMs();
+#else
+        int timeoutMs = kPollTimeMs;
+#endif
 
         m_activeChannels.clear();
-        m_pollReturnTime = m_poller->poll(kPollTimeMs, &m_activeChannels);
+        // 统计关闭时不读时钟
+        const bool statsEnabled = m_statsEnabled;
+        int64_t pollStart = statsEnabled ? LoopStats::nowNs() : 0;
+        if (m_busyPollUs > 0)
+            m_loopNowUs = busyPoll(timeoutMs);
+        else
+            m_loopNowUs = m_poller->poll(timeoutMs, &m_activeChannels);
+        updatePollReturnTime();
+        int64_t dispatchStart = statsEnabled ? LoopStats::nowNs() : 0;
+        if (statsEnabled)
+            m_stats->recordPoll(dispatchStart - pollStart, m_activeChannels.size());
+
         printActiveChannels();
         ++m_iteration;
         m_eventHandling = true;
+        int64_t handlerStart = dispatchStart;
+        m_dispatchTimerNs = 0;
         for (const auto &it : m_activeChannels)
         {
             currentActiveChannel_ = it;
             currentActiveChannel_->handleEvent(m_pollReturnTime);
+            if (statsEnabled)
+            {
+                int64_t handlerEnd = LoopStats::nowNs();
+                m_stats->recordHandler(it->fd(), handlerEnd - handlerStart);
+                handlerStart = handlerEnd;
+            }
         }
         currentActiveChannel_ = nullptr;
         m_eventHandling = false;
+        int64_t tasksStart = handlerStart;
+        // timerfd的回调在事件处理中执行定时器，这段时间已经记在定时器阶段里了
+        if (statsEnabled)
+            m_stats->recordDispatch(tasksStart - dispatchStart - m_dispatchTimerNs);
+
+        size_t queueDepth = m_pendingCount.load(std::memory_order_relaxed);
         doOtherTasks();
+        doIterationEndFunctors();
+        int64_t frameStart = statsEnabled ? LoopStats::nowNs() : 0;
+        if (statsEnabled)
+            m_stats->recordTasks(frameStart - tasksStart, queueDepth);
 
         if (m_frameFunctor)
         {
             m_frameFunctor();
+            if (statsEnabled)
+                m_stats->recordFrame(LoopStats::nowNs() - frameStart);
         }
+
+        if (statsEnabled)
+            m_stats->recordIteration(LoopStats::nowNs() - dispatchStart);
     }
 
     LOG_DEBUG("EventLoop 0x%0x stop looping", this);
@@ -135,7 +228,7 @@ void EventLoop::quit()
     }
 }
 
-void EventLoop::runInLoop(const Functor &cb)
+void EventLoop::runInLoop(Functor &&cb)
 {
     if (isInLoopThread())
     {
@@ -143,61 +236,208 @@ void EventLoop::runInLoop(const Functor &cb)
     }
     else
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
+    }
+}
+
+void EventLoop::queueInLoop(Functor &&cb)
+{
+    PendingTask *task = newTask(std::move(cb));
+    enqueue(task, task, 1);
+}
+
+void EventLoop::queueInLoop(std::vector<Functor> &&cbs)
+{
+    if (cbs.empty())
+        return;
+
+    PendingTask *first = newTask(std::move(cbs[0]));
+    PendingTask *last = first;
+    for (size_t i = 1; i < cbs.size(); ++i)
+    {
+        PendingTask *task = newTask(std::move(cbs[i]));
+        last->m_next.store(task, std::memory_order_relaxed);
+        last = task;
+    }
+    size_t count = cbs.size();
+    cbs.clear();
+
+    enqueue(first, last, count);
+}
+
+EventLoop::PendingTask *EventLoop::newTask(Functor &&cb)
+{
+    PendingTask *task = NULL;
+    if (m_freeTasks != NULL && isInLoopThread())
+    {
+        task = m_freeTasks;
+        m_freeTasks = static_cast<PendingTask *>(task->m_next.load(std::memory_order_relaxed));
+        --m_freeTaskCount;
+    }
+    else
+    {
+        task = new PendingTask();
     }
+    task->m_functor = std::move(cb);
+    return task;
 }
 
-void EventLoop::queueInLoop(const Functor &cb)
+void EventLoop::freeTask(PendingTask *task)
 {
+    // 先析构任务捕获的数据(比如连接的shared_ptr)，不要等到节点被复用的时候
+    task->m_functor = nullptr;
+    if (m_freeTaskCount >= kMaxFreeTasks)
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_pendingFunctors.push_back(cb);
+        delete task;
+        return;
     }
+    task->m_next.store(m_freeTasks, std::memory_order_relaxed);
+    m_freeTasks = task;
+    ++m_freeTaskCount;
+}
+
+void EventLoop::enqueue(PendingTask *first, PendingTask *last, size_t count)
+{
+    m_pendingFunctors.pushChain(first, last);
+    m_pendingCount.fetch_add(count, std::memory_order_release);
 
-    if (!isInLoopThread() || m_doingOtherTasks)
+    // 在loop线程里处理事件时加入的任务，本轮的doOtherTasks()就会执行，不需要唤醒
+    // 其他情况(别的线程、定时器回调、doOtherTasks()中)都要唤醒，否则poll会一直阻塞
+    // 队列从空变成非空时才写wakeupfd，loop处理之前的多次投递只唤醒一次
+    if (!isInLoopThread() || !m_eventHandling)
     {
-        wakeup();
+        if (!m_wakeupPending.exchange(true, std::memory_order_acq_rel))
+        {
+            wakeup();
+        }
     }
 }
 
-void EventLoop::setFrameFunctor(const Functor &cb)
+void EventLoop::recordTimerStats(int64_t durationNs)
 {
-    m_frameFunctor = cb;
+    m_stats->recordTimers(durationNs);
+    if (m_eventHandling)
+        m_dispatchTimerNs += durationNs;
 }
 
-TimerId EventLoop::runAt(const Timestamp &time, const TimerCallback &cb)
+void EventLoop::setBusyPoll(int64_t spinUs, int socketBusyPollUs)
 {
-    // 只执行一次
-    return m_timerQueue->addTimer(cb, time, 0, 1);
+    m_busyPollUs = spinUs > 0 ? spinUs : 0;
+    m_socketBusyPollUs = socketBusyPollUs > 0 ? socketBusyPollUs : 0;
 }
 
-TimerId EventLoop::runAfter(int64_t delay, const TimerCallback &cb)
+EventLoop::BusyPollStats EventLoop::busyPollStats() const
 {
-    Timestamp time(addTime(Timestamp::now(), delay));
-    return runAt(time, cb);
+    BusyPollStats stats;
+    stats.spins = m_spinCount.load(std::memory_order_relaxed);
+    stats.hits = m_spinHits.load(std::memory_order_relaxed);
+    stats.spinMicroSeconds = m_spinMicroSeconds.load(std::memory_order_relaxed);
+    return stats;
 }
 
-TimerId EventLoop::runEvery(int64_t interval, const TimerCallback &cb)
+int64_t EventLoop::busyPoll(int timeoutMs)
 {
-    Timestamp time(addTime(Timestamp::now(), interval));
-    //-1表示一直重复下去
-    return m_timerQueue->addTimer(cb, time, interval, -1);
+    // 自旋期间把唤醒标记置上，其他线程投递任务时就不会再写wakeupfd，由下面检查m_pendingCount发现
+    // 标记在doOtherTasks()中清除
+    m_wakeupPending.exchange(true, std::memory_order_acq_rel);
+
+    int64_t now = m_poller->poll(0, &m_activeChannels);
+    if (!m_activeChannels.empty() || m_pendingCount.load(std::memory_order_acquire) > 0)
+        return now;
+
+    int64_t start = now;
+    bool hit = false;
+    for (;;)
+    {
+        cpuRelax();
+        now = m_poller->poll(0, &m_activeChannels);
+        if (!m_activeChannels.empty() || m_pendingCount.load(std::memory_order_acquire) > 0)
+        {
+            hit = true;
+            break;
+        }
+        if (now - start >= m_busyPollUs)
+            break;
+    }
+    int64_t spinUs = now - start;
+
+    // 只有loop线程写，不需要原子加
+    m_spinCount.store(m_spinCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_spinMicroSeconds.store(m_spinMicroSeconds.load(std::memory_order_relaxed) + spinUs, std::memory_order_relaxed);
+    if (hit)
+    {
+        m_spinHits.store(m_spinHits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return now;
+    }
+
+    // 准备阻塞：先清掉唤醒标记再检查一次任务队列，清掉之后投递的任务一定会写wakeupfd
+    m_wakeupPending.exchange(false, std::memory_order_acq_rel);
+    if (m_pendingCount.load(std::memory_order_acquire) > 0)
+        return now;
+
+    return m_poller->poll(timeoutMs, &m_activeChannels);
+}
+
+void EventLoop::queueAtIterationEnd(Functor &&cb)
+{
+    assertInLoopThread();
+    m_iterationEndFunctors.push_back(std::move(cb));
+}
+
+void EventLoop::doIterationEndFunctors()
+{
+    // 回调里可能继续加入，换出来执行，直到没有新的为止；换出来的vector留着容量下一轮复用
+    std::vector<Functor> functors;
+    while (!m_iterationEndFunctors.empty())
+    {
+        functors.swap(m_iterationEndFunctors);
+        for (Functor &functor : functors)
+            functor();
+        functors.clear();
+    }
+    if (functors.capacity() > m_iterationEndFunctors.capacity())
+        functors.swap(m_iterationEndFunctors);
+}
+
+void EventLoop::setFrameFunctor(Functor &&cb)
+{
+    m_frameFunctor = std::move(cb);
+}
+
+void EventLoop::updatePollReturnTime()
+{
+    if (m_loopNowUs - m_wallClockSyncUs >= kWallClockSyncUs)
+    {
+        m_wallClockOffsetUs = Timestamp::now().microSecondsSinceEpoch() - Clock::monotonicUs();
+        m_wallClockSyncUs = m_loopNowUs;
+    }
+    m_pollReturnTime = Timestamp(m_loopNowUs + m_wallClockOffsetUs);
+}
+
+int64_t EventLoop::timerBase() const
+{
+    // 其他线程或者loop()开始之前m_loopNowUs可能已经过时很久，重新读时钟
+    if (isInLoopThread() && m_looping)
+        return m_loopNowUs;
+    return Clock::monotonicUs();
 }
 
 TimerId EventLoop::runAt(const Timestamp &time, TimerCallback &&cb)
 {
-    return m_timerQueue->addTimer(std::move(cb), time, 0, 1);
+    // 只执行一次，定时器内部用单调时钟
+    return m_timerQueue->addTimer(std::move(cb), Timestamp(Clock::fromWallClock(time)), 0, 1);
 }
 
 TimerId EventLoop::runAfter(int64_t delay, TimerCallback &&cb)
 {
-    Timestamp time(addTime(Timestamp::now(), delay));
-    return runAt(time, std::move(cb));
+    Timestamp time(addTime(Timestamp(timerBase()), delay));
+    return m_timerQueue->addTimer(std::move(cb), time, 0, 1);
 }
 
 TimerId EventLoop::runEvery(int64_t interval, TimerCallback &&cb)
 {
-    Timestamp time(addTime(Timestamp::now(), interval));
+    Timestamp time(addTime(Timestamp(timerBase()), interval));
+    //-1表示一直重复下去
     return m_timerQueue->addTimer(std::move(cb), time, interval, -1);
 }
 
@@ -245,6 +485,36 @@ bool EventLoop::hasChannel(Channel *channel)
     return m_poller->hasChannel(channel);
 }
 
+bool EventLoop::supportsEdgeTriggered() const
+{
+    return m_poller->supportsEdgeTriggered();
+}
+
+ZeroCopyReaper *EventLoop::zeroCopyReaper()
+{
+    assertInLoopThread();
+    if (!m_zeroCopyReaper)
+        m_zeroCopyReaper.reset(new ZeroCopyReaper(this));
+    return m_zeroCopyReaper.get();
+}
+
+#ifdef _WIN32
+int EventLoop::pollTimeoutMs() const
+{
+    Timestamp expiration = m_timerQueue->earliestExpiration();
+    if (!expiration.valid())
+        return kPollTimeMs;
+
+    int64_t delta = expiration.microSecondsSinceEpoch() - m_loopNowUs;
+    if (delta <= 0)
+        return 0;
+
+    // select只有毫秒精度，向上取整，避免定时器还没到期就醒来空转
+    int64_t timeoutMs = (delta + 999) / 1000;
+    return timeoutMs < kPollTimeMs ? static_cast<int>(timeoutMs) : kPollTimeMs;
+}
+#endif
+
 bool EventLoop::createWakeupfd()
 {
 #ifdef WIN32
@@ -370,18 +640,25 @@ bool EventLoop::handleRead()
 
 void EventLoop::doOtherTasks()
 {
-    std::vector<Functor> functors;
     m_doingOtherTasks = true;
 
-    {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        functors.swap(m_pendingFunctors);
-    }
+    // 先清掉唤醒标记再取任务，之后投递的任务会重新唤醒loop
+    m_wakeupPending.exchange(false, std::memory_order_acq_rel);
 
-    for (size_t i = 0; i < functors.size(); ++i)
+    // 只执行本轮开始时已经入队的任务，任务里再投递的任务留到下一轮，避免饿死I/O事件
+    size_t count = m_pendingCount.load(std::memory_order_acquire);
+    size_t done = 0;
+    while (done < count)
     {
-        functors[i]();
+        PendingTask *task = m_pendingFunctors.pop();
+        if (task == NULL)
+            break;
+
+        ++done;
+        task->m_functor();
+        freeTask(task);
     }
+    m_pendingCount.fetch_sub(done, std::memory_order_release);
 
     m_doingOtherTasks = false;
 }
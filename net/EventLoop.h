@@ -13,6 +13,7 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 
 #include "../base/Timestamp.h"
 #include "../base/Platform.h"
@@ -20,6 +21,8 @@
 #include "Sockets.h"
 #include "TimerId.h"
 #include "TimerQueue.h"
+#include "MpscQueue.h"
+#include "LoopStats.h"
 
 namespace net
 {
@@ -27,31 +30,92 @@ namespace net
     class Channel;
     class Poller;
     class CTimerHeap;
+    class ZeroCopyReaper;
 
     class EventLoop
     {
     public:
-        typedef std::function<void()> Functor;
+        // 任务只能移动，捕获的数据不超过56字节时不需要堆分配，见InplaceFunction
+        typedef InplaceFunction<void()> Functor;
         EventLoop();
         ~EventLoop();
         void loop();
         void quit();
+        // 本轮poll返回的墙上时间，用来显示和记录，由loopNow()换算，不再单独读系统时间
         Timestamp pollReturnTime() const { return m_pollReturnTime; }
+        // 本轮poll返回时的单调时钟(Clock::monotonicUs())，每轮循环只读一次时钟，只能在loop线程调用
+        // 定时器和连接超时都以它为准，不受系统时间调整的影响；同一轮里执行的回调和任务看到的是同一个值
+        int64_t loopNow() const { return m_loopNowUs; }
         int64_t iteration() const { return m_iteration; }
-        void runInLoop(const Functor &cb);
-        void queueInLoop(const Functor &cb);
-        TimerId runAt(const Timestamp &time, const TimerCallback &cb);
-        TimerId runAfter(int64_t delay, const TimerCallback &cb);
-        TimerId runEvery(int64_t interval, const TimerCallback &cb);
-        void cancel(TimerId timerId, bool off);
-        void remove(TimerId timerId);
+        void runInLoop(Functor &&cb);
+        void queueInLoop(Functor &&cb);
+        // 批量投递任务，整批只入队一次、最多唤醒一次
+        void queueInLoop(std::vector<Functor> &&cbs);
+        // 还没有执行的任务数，任意线程都可以调用
+        size_t queueSize() const { return m_pendingCount.load(std::memory_order_relaxed); }
+        // time是墙上时间，添加时换算成单调时钟，之后再调整系统时间不影响触发的时刻
         TimerId runAt(const Timestamp &time, TimerCallback &&cb);
+        // 在loop线程里调用时从loopNow()开始计时，同一轮里先执行的耗时会让定时器相应地提前
         TimerId runAfter(int64_t delay, TimerCallback &&cb);
         TimerId runEvery(int64_t interval, TimerCallback &&cb);
-        void setFrameFunctor(const Functor &cb);
+        void cancel(TimerId timerId, bool off);
+        void remove(TimerId timerId);
+        // 本轮处理完事件和任务之后、下一次poll之前执行，用来把本轮攒下的写操作合成一次，只能在loop线程里调用
+        // 执行期间再加入的回调也在本轮执行
+        void queueAtIterationEnd(Functor &&cb);
+        void setFrameFunctor(Functor &&cb);
         bool updateChannel(Channel *channel);
         void removeChannel(Channel *channel);
         bool hasChannel(Channel *channel);
+        // 当前Poller是否支持边缘触发，poll/select只支持水平触发
+        bool supportsEdgeTriggered() const;
+        // 接管已经析构的连接还在等零拷贝完成通知的内存，第一次用到时创建，只能在loop线程里调用
+        ZeroCopyReaper *zeroCopyReaper();
+
+        // 忙轮询模式：阻塞在poll之前先用0超时的poll自旋spinUs微秒，同时检查任务队列，
+        // 自旋期间其他线程投递任务不需要写wakeupfd，用CPU换延迟，spinUs为0表示关闭(默认)
+        // socketBusyPollUs大于0时，给这个loop上建立的连接设置SO_BUSY_POLL
+        // 只能在loop线程里或者loop()之前调用
+        void setBusyPoll(int64_t spinUs, int socketBusyPollUs = 0);
+        int64_t busyPollUs() const { return m_busyPollUs; }
+        int socketBusyPollUs() const { return m_socketBusyPollUs; }
+
+        struct BusyPollStats
+        {
+            int64_t spins;            // 自旋等待的次数
+            int64_t hits;             // 自旋期间等到了事件或任务，没有阻塞的次数
+            int64_t spinMicroSeconds; // 自旋花掉的总时间
+        };
+        // 任意线程都可以调用
+        BusyPollStats busyPollStats() const;
+
+        // 每轮循环的耗时统计，默认关闭，打开后每次事件处理多两次读时钟
+        // 只能在loop线程里或者loop()之前调用
+        void setStatsEnabled(bool on) { m_statsEnabled = on; }
+        bool statsEnabled() const { return m_statsEnabled; }
+        // 任意线程都可以读，不需要加锁
+        const LoopStats &stats() const { return *m_stats; }
+        // Internal use only. TimerQueue记录定时器阶段的耗时
+        void recordTimerStats(int64_t durationNs);
+
+        // 负载信息，EventLoopThreadPool按负载给新连接选择loop时读取，任意线程都可以调用
+        int connectionCount() const { return m_connectionCount.load(std::memory_order_relaxed); }
+        uint64_t bytesTransferred() const { return m_bytesTransferred.load(std::memory_order_relaxed); }
+        // Internal use only. TcpConnection构造和析构时调用，可能不在loop线程
+        void addConnection(int delta) { m_connectionCount.fetch_add(delta, std::memory_order_relaxed); }
+        // Internal use only. 只能在loop线程里调用
+        void addBytesTransferred(size_t n)
+        {
+            m_bytesTransferred.store(m_bytesTransferred.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        // 这个loop上的连接因为各类超时被回调处理或者关闭的次数，任意线程都可以调用
+        int64_t timeoutCount(ConnectionTimeout type) const { return m_timeoutCounts[type].load(std::memory_order_relaxed); }
+        // Internal use only. 只能在loop线程里调用
+        void recordTimeout(ConnectionTimeout type)
+        {
+            m_timeoutCounts[type].store(m_timeoutCounts[type].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
         void assertInLoopThread()
         {
             if (!isInLoopThread())
@@ -72,7 +136,26 @@ namespace net
         void abortNotInLoopThread();
         bool handleRead();
         void doOtherTasks();
+        void doIterationEndFunctors();
+        int64_t busyPoll(int timeoutMs);
+        // 由m_loopNowUs更新m_pollReturnTime，两个时钟的差值每秒校正一次
+        void updatePollReturnTime();
+        // runAfter()/runEvery()计时的起点
+        int64_t timerBase() const;
         void printActiveChannels() const;
+#ifdef _WIN32
+        // 根据最早到期的定时器计算poll的超时时间
+        int pollTimeoutMs() const;
+#endif
+
+        struct PendingTask : public MpscNode
+        {
+            Functor m_functor;
+        };
+        // loop线程自己投递任务时优先复用执行完的任务节点，其他线程投递时直接分配
+        PendingTask *newTask(Functor &&cb);
+        void freeTask(PendingTask *task);
+        void enqueue(PendingTask *first, PendingTask *last, size_t count);
 
     private:
         typedef std::vector<Channel *> ChannelList;
@@ -83,8 +166,12 @@ namespace net
         bool m_doingOtherTasks;
         const std::thread::id m_threadId;
         Timestamp m_pollReturnTime;
+        int64_t m_loopNowUs;
+        int64_t m_wallClockOffsetUs;  // 墙上时间减去单调时钟
+        int64_t m_wallClockSyncUs;    // 上一次校正m_wallClockOffsetUs时的单调时钟
         std::unique_ptr<Poller> m_poller;
         std::unique_ptr<TimerQueue> m_timerQueue;
+        std::unique_ptr<ZeroCopyReaper> m_zeroCopyReaper; // 析构时要注销Channel、删除定时器，在析构函数开头先释放
         int64_t m_iteration;
 
 #ifdef _WIN32
@@ -98,8 +185,27 @@ namespace net
 
         ChannelList m_activeChannels;
         Channel *currentActiveChannel_;
-        std::mutex m_mutex;
-        std::vector<Functor> m_pendingFunctors;
+        MpscQueue<PendingTask> m_pendingFunctors;
+        std::atomic<size_t> m_pendingCount;
+        std::atomic<bool> m_wakeupPending; // 已经写过wakeupfd但loop还没处理，合并多次唤醒
+        PendingTask *m_freeTasks;          // 执行完的任务节点，只有loop线程访问
+        size_t m_freeTaskCount;
         Functor m_frameFunctor;
+        std::vector<Functor> m_iterationEndFunctors;
+
+        int64_t m_busyPollUs;
+        int m_socketBusyPollUs;
+        // 只有loop线程写，其他线程读统计数据
+        std::atomic<int64_t> m_spinCount;
+        std::atomic<int64_t> m_spinHits;
+        std::atomic<int64_t> m_spinMicroSeconds;
+
+        bool m_statsEnabled;
+        std::unique_ptr<LoopStats> m_stats;
+        int64_t m_dispatchTimerNs; // 这一轮事件处理中timerfd回调执行定时器用的时间，从事件处理阶段里扣掉
+
+        std::atomic<int> m_connectionCount;
+        std::atomic<uint64_t> m_bytesTransferred; // 只有loop线程写
+        std::atomic<int64_t> m_timeoutCounts[kConnectionTimeoutTypes]; // 只有loop线程写
     };
 }
\ No newline at end of file
@@ -7,15 +7,69 @@
 
 #include "EventLoopThread.h"
 #include <functional>
+#include "../base/Platform.h"
+#include "../base/AsyncLog.h"
 #include "EventLoop.h"
 
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 using namespace net;
 
+namespace
+{
+    void setCurrentThreadName(const std::string &name)
+    {
+#ifndef _WIN32
+        // 内核限制线程名最长15个字符
+        std::string shortName = name.substr(0, 15);
+        ::pthread_setname_np(::pthread_self(), shortName.c_str());
+#else
+        (void)name;
+#endif
+    }
+
+    bool bindCurrentThreadToCpu(int cpu)
+    {
+#ifndef _WIN32
+        if (cpu < 0 || cpu >= CPU_SETSIZE)
+        {
+            LOG_ERROR("cpu %d out of range [0, %d)", cpu, CPU_SETSIZE);
+            return false;
+        }
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof cpuset, &cpuset);
+        if (ret != 0)
+        {
+            LOG_ERROR("pthread_setaffinity_np failed, cpu: %d, error: %d", cpu, ret);
+            return false;
+        }
+        return true;
+#else
+        // 亲和性掩码只有DWORD_PTR那么多位，超出的编号移位是未定义行为
+        const int kMaskBits = static_cast<int>(sizeof(DWORD_PTR) * 8);
+        if (cpu < 0 || cpu >= kMaskBits)
+        {
+            LOG_ERROR("cpu %d out of range [0, %d)", cpu, kMaskBits);
+            return false;
+        }
+        return ::SetThreadAffinityMask(::GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu) != 0;
+#endif
+    }
+}
+
 EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
-                                 const std::string &name /* = ""*/)
+                                 const std::string &name /* = ""*/,
+                                 int cpu /* = -1*/)
     : m_loop(NULL),
       m_exiting(false),
-      m_callback(cb)
+      m_callback(cb),
+      m_name(name),
+      m_cpu(cpu)
 {
 }
 
@@ -59,6 +113,14 @@ void EventLoopThread::stopLoop()
 
 void EventLoopThread::threadFunc()
 {
+    if (!m_name.empty())
+        setCurrentThreadName(m_name);
+
+    // 先绑定CPU再创建EventLoop，Linux默认按首次访问分配物理内存，
+    // 这样loop自己的数据结构(Poller、定时器、统计数据等)以及之后在这个线程里分配的缓冲区都在本线程所在的NUMA节点上
+    if (m_cpu >= 0)
+        bindCurrentThreadToCpu(m_cpu);
+
     EventLoop loop;
 
     if (m_callback)
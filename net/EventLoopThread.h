@@ -22,7 +22,8 @@ namespace net
     public:
         typedef std::function<void(EventLoop *)> ThreadInitCallback;
 
-        EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(), const std::string &name = "");
+        // name是线程名(Linux上最多15个字符)，cpu大于等于0时把线程绑定到这个CPU上
+        EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(), const std::string &name = "", int cpu = -1);
         ~EventLoopThread();
         EventLoop *startLoop();
         void stopLoop();
@@ -36,6 +37,8 @@ namespace net
         std::mutex m_mutex;
         std::condition_variable m_cond;
         ThreadInitCallback m_callback;
+        const std::string m_name;
+        const int m_cpu;
     };
 
 }
@@ -7,20 +7,28 @@
 
 #include "EventLoopThreadPool.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <sstream>
 #include <string>
+#include "../base/AsyncLog.h"
 #include "EventLoop.h"
 #include "EventLoopThread.h"
 #include "Callbacks.h"
 
+#ifndef _WIN32
+#include <sched.h>
+#endif
+
 using namespace net;
 
 EventLoopThreadPool::EventLoopThreadPool()
     : m_baseLoop(NULL),
       m_started(false),
       m_numThreads(0),
-      m_next(0)
+      m_next(0),
+      m_busyPollUs(0),
+      m_socketBusyPollUs(0)
 {
 }
 
@@ -33,9 +41,17 @@ void EventLoopThreadPool::init(EventLoop *baseLoop, int numThreads)
 {
     m_numThreads = numThreads;
     m_baseLoop = baseLoop;
+    if (m_name.empty())
+        m_name = "EventLoop";
+}
+
+void EventLoopThreadPool::setBusyPoll(int64_t spinUs, int socketBusyPollUs)
+{
+    m_busyPollUs = spinUs;
+    m_socketBusyPollUs = socketBusyPollUs;
 }
 
-void EventLoopThreadPool::start(const ThreadInitCallback &cb)
+void EventLoopThreadPool::start(const ThreadInitCallback &userCallback)
 {
     // assert(baseLoop_);
     if (m_baseLoop == NULL)
@@ -49,12 +65,30 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
 
     m_started = true;
 
+    // 忙轮询的设置要在loop线程里、loop()开始之前完成，所以放到线程初始化回调里
+    ThreadInitCallback cb = userCallback;
+    if (m_busyPollUs > 0 || m_socketBusyPollUs > 0)
+    {
+        int64_t busyPollUs = m_busyPollUs;
+        int socketBusyPollUs = m_socketBusyPollUs;
+        cb = [busyPollUs, socketBusyPollUs, userCallback](EventLoop *loop)
+        {
+            loop->setBusyPoll(busyPollUs, socketBusyPollUs);
+            if (userCallback)
+                userCallback(loop);
+        };
+    }
+
+    if (m_numThreads < 0)
+        m_numThreads = m_cpus.empty() ? availableCpuCount() : static_cast<int>(m_cpus.size());
+
     for (int i = 0; i < m_numThreads; ++i)
     {
         char buf[128];
         snprintf(buf, sizeof buf, "%s%d", m_name.c_str(), i);
 
-        std::unique_ptr<EventLoopThread> t(new EventLoopThread(cb, buf));
+        int cpu = m_cpus.empty() ? -1 : m_cpus[i % m_cpus.size()];
+        std::unique_ptr<EventLoopThread> t(new EventLoopThread(cb, buf, cpu));
         // EventLoopThread* t = new EventLoopThread(cb, buf);
         m_loops.push_back(t->startLoop());
         m_threads.push_back(std::move(t));
@@ -73,6 +107,19 @@ void EventLoopThreadPool::stop()
     }
 }
 
+void EventLoopThreadPool::setDispatchPolicy(LoopDispatcher::Policy policy)
+{
+    if (policy == LoopDispatcher::kRoundRobin)
+        m_dispatcher.reset();
+    else
+        m_dispatcher.reset(LoopDispatcher::create(policy));
+}
+
+void EventLoopThreadPool::setDispatcher(LoopDispatcher *dispatcher)
+{
+    m_dispatcher.reset(dispatcher);
+}
+
 EventLoop *EventLoopThreadPool::getNextLoop()
 {
     m_baseLoop->assertInLoopThread();
@@ -82,7 +129,20 @@ EventLoop *EventLoopThreadPool::getNextLoop()
 
     EventLoop *loop = m_baseLoop;
 
-    if (!m_loops.empty())
+    if (!m_loops.empty() && m_dispatcher)
+    {
+        // 负载信息都是原子变量，直接读，不需要和各个loop线程同步
+        m_loads.resize(m_loops.size());
+        for (size_t i = 0; i < m_loops.size(); ++i)
+        {
+            m_loads[i].connections = m_loops[i]->connectionCount();
+            m_loads[i].queueDepth = m_loops[i]->queueSize();
+            m_loads[i].bytesTransferred = m_loops[i]->bytesTransferred();
+        }
+        size_t index = m_dispatcher->select(m_loads, m_baseLoop->loopNow());
+        loop = m_loops[index < m_loops.size() ? index : 0];
+    }
+    else if (!m_loops.empty())
     {
         // round-robin
         loop = m_loops[m_next];
@@ -120,6 +180,78 @@ std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
     }
 }
 
+int EventLoopThreadPool::availableCpuCount()
+{
+#ifndef _WIN32
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (::sched_getaffinity(0, sizeof cpuset, &cpuset) == 0)
+    {
+        int count = CPU_COUNT(&cpuset);
+        if (count > 0)
+            return count;
+    }
+#endif
+    unsigned count = std::thread::hardware_concurrency();
+    return count > 0 ? static_cast<int>(count) : 1;
+}
+
+namespace
+{
+    // CPU编号的上限，Linux上cpu_set_t的大小，再大的编号也绑不上
+    const int kMaxCpu = 1024;
+
+    // 从p开始读一个十进制数，只接受数字，不接受空白和正负号
+    bool parseCpu(const char *&p, int *cpu)
+    {
+        if (*p < '0' || *p > '9')
+            return false;
+        long value = 0;
+        while (*p >= '0' && *p <= '9')
+        {
+            value = value * 10 + (*p - '0');
+            if (value >= kMaxCpu)
+                return false;
+            ++p;
+        }
+        *cpu = static_cast<int>(value);
+        return true;
+    }
+}
+
+std::vector<int> EventLoopThreadPool::parseCpuList(const std::string &cpuList)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(cpuList);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item.empty())
+            continue;
+
+        // 只接受"n"和"first-last"两种写法，first不大于last
+        const char *p = item.c_str();
+        int first = 0;
+        int last = 0;
+        bool ok = parseCpu(p, &first);
+        last = first;
+        if (ok && *p == '-')
+        {
+            ++p;
+            ok = parseCpu(p, &last);
+        }
+        if (!ok || *p != '\0' || last < first)
+        {
+            LOG_ERROR("invalid cpu list \"%s\" at \"%s\", cpus must be in [0, %d)", cpuList.c_str(), item.c_str(), kMaxCpu);
+            return std::vector<int>();
+        }
+
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
 const std::string EventLoopThreadPool::info() const
 {
     std::stringstream ss;
@@ -11,6 +11,9 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <stdint.h>
+
+#include "LoopDispatcher.h"
 
 namespace net
 {
@@ -25,12 +28,25 @@ namespace net
         EventLoopThreadPool();
         ~EventLoopThreadPool();
 
+        // numThreads小于0时按可用的CPU数创建线程，设置了绑定的CPU列表时就是列表的长度
         void init(EventLoop *baseLoop, int numThreads);
+        // 线程名的前缀，第i个线程名为name+i，需要在start()之前设置
+        void setName(const std::string &name) { m_name = name; }
+        // 第i个线程绑定到cpus[i % cpus.size()]上，为空表示不绑定，需要在start()之前设置
+        void setCpuAffinity(const std::vector<int> &cpus) { m_cpus = cpus; }
+        // 这个线程池里的所有loop使用忙轮询模式，见EventLoop::setBusyPoll()，需要在start()之前设置
+        // 延迟敏感的业务单独用一个开启忙轮询的线程池，不影响文件传输之类的大流量线程池
+        void setBusyPoll(int64_t spinUs, int socketBusyPollUs = 0);
         void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
         void stop();
 
-        /// round-robin
+        // getNextLoop()选择loop的策略，默认轮询，只能在base loop线程里调用
+        void setDispatchPolicy(LoopDispatcher::Policy policy);
+        // 自定义的选择策略，线程池接管dispatcher的所有权
+        void setDispatcher(LoopDispatcher *dispatcher);
+
+        /// round-robin by default, see setDispatchPolicy()
         EventLoop *getNextLoop();
 
         /// with the same hash code, it will always return the same EventLoop
@@ -50,14 +66,24 @@ namespace net
 
         const std::string info() const;
 
+        // 当前进程可以使用的CPU数(考虑taskset/cgroup的限制)，至少为1
+        static int availableCpuCount();
+        // 解析"0-3,8,10-11"格式的CPU列表，格式错误(比如"0-"、"3-1"、"1x")时记一条错误日志，返回空
+        static std::vector<int> parseCpuList(const std::string &cpuList);
+
     private:
         EventLoop *m_baseLoop;
         std::string m_name;
         bool m_started;
         int m_numThreads;
         int m_next;
+        std::vector<int> m_cpus;
+        int64_t m_busyPollUs;
+        int m_socketBusyPollUs;
         std::vector<std::unique_ptr<EventLoopThread>> m_threads;
         std::vector<EventLoop *> m_loops;
+        std::unique_ptr<LoopDispatcher> m_dispatcher; // 为空时按轮询
+        std::vector<LoopLoad> m_loads;                // 复用，避免每个新连接都分配内存
     };
 
 }
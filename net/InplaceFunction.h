@@ -0,0 +1,192 @@
+/*
+ *  Filename:   InplaceFunction.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:只能移动不能拷贝的函数对象，捕获的数据不超过Capacity字节时直接存放在对象内部，
+ *              超过时才退回到堆上分配，用来代替EventLoop任务队列和定时器里的std::function
+ *              libstdc++的std::function只有16字节的内联空间，而且要求可平凡拷贝，
+ *              std::bind一个成员函数加shared_ptr就要在堆上分配；
+ *              不支持拷贝，捕获了string之类的数据时也只会移动，不会再拷贝一次
+ */
+
+#pragma once
+
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+
+namespace net
+{
+    // 默认的内联空间加上一个操作表指针正好是一个64字节的缓存行，
+    // 足够放下"成员函数指针+shared_ptr+一个参数"或者"成员函数指针+this+string"
+    const size_t kInplaceFunctionDefaultCapacity = 56;
+
+    template <typename Signature, size_t Capacity = kInplaceFunctionDefaultCapacity>
+    class InplaceFunction;
+
+    template <typename R, typename... Args, size_t Capacity>
+    class InplaceFunction<R(Args...), Capacity>
+    {
+    public:
+        InplaceFunction() : m_ops(NULL) {}
+        InplaceFunction(std::nullptr_t) : m_ops(NULL) {}
+
+        template <typename F,
+                  typename Functor = typename std::decay<F>::type,
+                  typename = typename std::enable_if<!std::is_same<Functor, InplaceFunction>::value &&
+                                                     !std::is_same<Functor, std::nullptr_t>::value>::type,
+                  typename = decltype(static_cast<R>(std::declval<Functor &>()(std::declval<Args>()...)))>
+        InplaceFunction(F &&f) : m_ops(NULL)
+        {
+            construct<Functor>(std::forward<F>(f));
+        }
+
+        InplaceFunction(InplaceFunction &&rhs) noexcept : m_ops(rhs.m_ops)
+        {
+            if (m_ops != NULL)
+            {
+                m_ops->relocate(m_storage, rhs.m_storage);
+                rhs.m_ops = NULL;
+            }
+        }
+
+        InplaceFunction &operator=(InplaceFunction &&rhs) noexcept
+        {
+            if (this != &rhs)
+            {
+                reset();
+                if (rhs.m_ops != NULL)
+                {
+                    rhs.m_ops->relocate(m_storage, rhs.m_storage);
+                    m_ops = rhs.m_ops;
+                    rhs.m_ops = NULL;
+                }
+            }
+            return *this;
+        }
+
+        InplaceFunction &operator=(std::nullptr_t)
+        {
+            reset();
+            return *this;
+        }
+
+        InplaceFunction(const InplaceFunction &rhs) = delete;
+        InplaceFunction &operator=(const InplaceFunction &rhs) = delete;
+
+        ~InplaceFunction()
+        {
+            reset();
+        }
+
+        explicit operator bool() const { return m_ops != NULL; }
+
+        // 和std::function一样，const对象也可以调用，调用空对象是未定义行为
+        R operator()(Args... args) const
+        {
+            return m_ops->invoke(const_cast<unsigned char *>(m_storage), std::forward<Args>(args)...);
+        }
+
+        // 类型为F的可调用对象能否直接存放在内部，不需要堆分配
+        template <typename F>
+        static constexpr bool storedInline()
+        {
+            return sizeof(F) <= Capacity && alignof(F) <= alignof(std::max_align_t) &&
+                   std::is_nothrow_move_constructible<F>::value;
+        }
+
+    private:
+        struct Ops
+        {
+            R (*invoke)(void *storage, Args &&...args);
+            // 把src里的对象移动到dst，并析构src里的对象
+            void (*relocate)(void *dst, void *src);
+            void (*destroy)(void *storage);
+        };
+
+        template <typename F>
+        struct InlineOps
+        {
+            static R invoke(void *storage, Args &&...args)
+            {
+                return static_cast<R>((*static_cast<F *>(storage))(std::forward<Args>(args)...));
+            }
+            static void relocate(void *dst, void *src)
+            {
+                F *f = static_cast<F *>(src);
+                new (dst) F(std::move(*f));
+                f->~F();
+            }
+            static void destroy(void *storage)
+            {
+                static_cast<F *>(storage)->~F();
+            }
+            static const Ops ops;
+        };
+
+        template <typename F>
+        struct HeapOps
+        {
+            static F *&pointer(void *storage) { return *static_cast<F **>(storage); }
+            static R invoke(void *storage, Args &&...args)
+            {
+                return static_cast<R>((*pointer(storage))(std::forward<Args>(args)...));
+            }
+            static void relocate(void *dst, void *src)
+            {
+                new (dst) F *(pointer(src));
+            }
+            static void destroy(void *storage)
+            {
+                delete pointer(storage);
+            }
+            static const Ops ops;
+        };
+
+        template <typename F, typename Arg>
+        typename std::enable_if<storedInline<F>()>::type construct(Arg &&f)
+        {
+            new (m_storage) F(std::forward<Arg>(f));
+            m_ops = &InlineOps<F>::ops;
+        }
+
+        template <typename F, typename Arg>
+        typename std::enable_if<!storedInline<F>()>::type construct(Arg &&f)
+        {
+            new (m_storage) F *(new F(std::forward<Arg>(f)));
+            m_ops = &HeapOps<F>::ops;
+        }
+
+        void reset()
+        {
+            if (m_ops != NULL)
+            {
+                m_ops->destroy(m_storage);
+                m_ops = NULL;
+            }
+        }
+
+    private:
+        static_assert(Capacity >= sizeof(void *), "InplaceFunction capacity must hold at least a pointer");
+
+        alignas(std::max_align_t) unsigned char m_storage[Capacity];
+        const Ops *m_ops;
+    };
+
+    template <typename R, typename... Args, size_t Capacity>
+    template <typename F>
+    const typename InplaceFunction<R(Args...), Capacity>::Ops
+        InplaceFunction<R(Args...), Capacity>::InlineOps<F>::ops = {&InlineOps<F>::invoke, &InlineOps<F>::relocate, &InlineOps<F>::destroy};
+
+    template <typename R, typename... Args, size_t Capacity>
+    template <typename F>
+    const typename InplaceFunction<R(Args...), Capacity>::Ops
+        InplaceFunction<R(Args...), Capacity>::HeapOps<F>::ops = {&HeapOps<F>::invoke, &HeapOps<F>::relocate, &HeapOps<F>::destroy};
+
+    template <typename R, typename... Args, size_t Capacity>
+    bool operator==(const InplaceFunction<R(Args...), Capacity> &f, std::nullptr_t) { return !f; }
+
+    template <typename R, typename... Args, size_t Capacity>
+    bool operator!=(const InplaceFunction<R(Args...), Capacity> &f, std::nullptr_t) { return static_cast<bool>(f); }
+}
@@ -0,0 +1,428 @@
+/*
+ *  Filename:   IoUringPoller.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:使用io_uring的poll实现的Poller类，Linux 5.13以上可用
+ */
+
+#include "IoUringPoller.h"
+
+#ifndef _WIN32
+#include <string.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "../base/Platform.h"
+#include "../base/AsyncLog.h"
+#include "../base/Clock.h"
+#include "EventLoop.h"
+#include "Channel.h"
+
+using namespace net;
+
+namespace
+{
+    const int kNew = -1;
+    const int kAdded = 1;
+    const int kDeleted = 2;
+
+    // POLL_REMOVE的完成事件不需要处理，用0标识，所以generation从1开始
+    const uint64_t kIgnoredUserData = 0;
+
+    // multishot poll需要5.13，没有专门的feature位，用同一个版本引入的RSRC_TAGS来判断
+    const unsigned kRequiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+
+    int ioUringSetup(unsigned entries, struct io_uring_params *params)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int ioUringEnter(int ringfd, unsigned toSubmit, unsigned minComplete, unsigned flags, const void *arg, size_t argsz)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, ringfd, toSubmit, minComplete, flags, arg, argsz));
+    }
+}
+
+IoUringPoller::IoUringPoller(EventLoop *loop, unsigned entries)
+    : m_ringfd(-1),
+      m_ownerLoop(loop),
+      m_nextGeneration(1),
+      m_pollRound(0),
+      m_sqRing(NULL),
+      m_sqRingSize(0),
+      m_sqHead(NULL),
+      m_sqTail(NULL),
+      m_sqMask(NULL),
+      m_sqArray(NULL),
+      m_sqEntries(0),
+      m_sqLocalTail(0),
+      m_sqes(NULL),
+      m_sqesSize(0),
+      m_cqRing(NULL),
+      m_cqRingSize(0),
+      m_cqHead(NULL),
+      m_cqTail(NULL),
+      m_cqMask(NULL),
+      m_cqes(NULL)
+{
+    if (!setupRing(entries))
+    {
+        LOG_WARN("IoUringPoller::IoUringPoller setup io_uring failed, errno: %d, errorinfo: %s", errno, strerror(errno));
+    }
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    if (m_sqes != NULL)
+        ::munmap(m_sqes, m_sqesSize);
+
+    if (m_sqRing != NULL)
+        ::munmap(m_sqRing, m_sqRingSize);
+
+    if (m_ringfd >= 0)
+        ::close(m_ringfd);
+}
+
+bool IoUringPoller::setupRing(unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof params);
+    int ringfd = ioUringSetup(entries, &params);
+    if (ringfd < 0)
+        return false;
+
+    if ((params.features & kRequiredFeatures) != kRequiredFeatures)
+    {
+        ::close(ringfd);
+        errno = ENOSYS;
+        return false;
+    }
+
+    // SINGLE_MMAP：提交队列和完成队列共用一次mmap
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (m_cqRingSize > m_sqRingSize)
+        m_sqRingSize = m_cqRingSize;
+    m_cqRingSize = m_sqRingSize;
+
+    m_sqRing = ::mmap(NULL, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED)
+    {
+        m_sqRing = NULL;
+        ::close(ringfd);
+        return false;
+    }
+    m_cqRing = m_sqRing;
+
+    m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = ::mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        ::munmap(m_sqRing, m_sqRingSize);
+        m_sqRing = NULL;
+        ::close(ringfd);
+        return false;
+    }
+    m_sqes = static_cast<struct io_uring_sqe *>(sqes);
+
+    char *sq = static_cast<char *>(m_sqRing);
+    m_sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    m_sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    m_sqEntries = params.sq_entries;
+    m_sqLocalTail = *m_sqTail;
+
+    char *cq = static_cast<char *>(m_cqRing);
+    m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    m_cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    m_ringfd = ringfd;
+    return true;
+}
+
+bool IoUringPoller::hasChannel(Channel *channel) const
+{
+    assertInLoopThread();
+    return m_channels.contains(channel, channel->fd());
+}
+
+void IoUringPoller::assertInLoopThread() const
+{
+    m_ownerLoop->assertInLoopThread();
+}
+
+uint64_t IoUringPoller::makeUserData(int fd, uint32_t generation)
+{
+    return ChannelMap::makeTag(fd, generation);
+}
+
+int64_t IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    ++m_pollRound;
+
+    // 触发过的one-shot poll和被内核终止的multishot poll(比如完成队列溢出)在这里重新登记
+    for (int fd : m_rearmFds)
+    {
+        ChannelEntry *entry = m_channels.slot(fd);
+        if (entry != nullptr && entry->armedEvents == 0 &&
+            entry->channel->index() == kAdded && !entry->channel->isNoneEvent())
+        {
+            armPoll(fd, *entry);
+        }
+    }
+    m_rearmFds.clear();
+
+    // 完成队列里已经有事件时不阻塞，只提交
+    unsigned cqReady = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE) - *m_cqHead;
+    int ret = submitAndWait(cqReady > 0 ? 0 : 1, timeoutMs);
+    int savedErrno = errno;
+    int64_t now = Clock::monotonicUs();
+
+    if (ret < 0 && savedErrno != ETIME && savedErrno != EINTR && savedErrno != EBUSY)
+    {
+        errno = savedErrno;
+        LOG_SYSERROR("IoUringPoller::poll()");
+    }
+
+    fillActiveChannels(activeChannels);
+    return now;
+}
+
+void IoUringPoller::fillActiveChannels(ChannelList *activeChannels)
+{
+    unsigned head = *m_cqHead;
+    unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        const struct io_uring_cqe *cqe = &m_cqes[head & *m_cqMask];
+        uint64_t userData = cqe->user_data;
+        int32_t res = cqe->res;
+        uint32_t flags = cqe->flags;
+
+        if (userData == kIgnoredUserData)
+            continue;
+
+        int fd = static_cast<int>(userData >> 32);
+        uint32_t generation = static_cast<uint32_t>(userData);
+        ChannelEntry *slot = m_channels.slot(fd);
+        // 已经删除或者重新登记过的fd，丢弃旧的完成事件
+        if (slot == nullptr || slot->pollGeneration != generation)
+            continue;
+
+        ChannelEntry &entry = *slot;
+        int revents = 0;
+        if (res < 0)
+        {
+            // poll被内核终止或者登记失败，不管什么原因都在下一次poll()时重新登记，否则这个fd再也收不到事件；
+            // 自己撤销的poll的generation已经清零，到不了这里，ECANCELED是内核撤销的，直接重新登记就行
+            entry.armedEvents = 0;
+            m_rearmFds.push_back(fd);
+            if (res == -ECANCELED)
+                continue;
+
+            // 其他错误当作fd出错交给Channel的错误回调，和epoll报告EPOLLERR一样，出错一直存在就每轮都报告
+            LOG_DEBUG("io_uring poll failed, fd = %d, error: %s", fd, strerror(-res));
+            revents = XPOLLERR;
+        }
+        else
+        {
+            revents = res;
+            if (!(flags & IORING_CQE_F_MORE))
+            {
+                entry.armedEvents = 0;
+                m_rearmFds.push_back(fd);
+            }
+        }
+
+        Channel *channel = entry.channel;
+        if (entry.pollRound == m_pollRound)
+        {
+            channel->add_revents(revents);
+        }
+        else
+        {
+            entry.pollRound = m_pollRound;
+            channel->set_revents(revents);
+            activeChannels->push_back(channel);
+        }
+    }
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+}
+
+bool IoUringPoller::updateChannel(Channel *channel)
+{
+    assertInLoopThread();
+    LOG_DEBUG("fd = %d  events = %d", channel->fd(), channel->events());
+    const int index = channel->index();
+    int fd = channel->fd();
+    if (index == kNew || index == kDeleted)
+    {
+        if (index == kNew)
+        {
+            if (m_channels.add(fd, channel) == nullptr)
+            {
+                LOG_ERROR("fd = %d  must not exist in channels_", fd);
+                return false;
+            }
+        }
+        else // index == kDeleted
+        {
+            if (m_channels.find(fd) != channel)
+            {
+                LOG_ERROR("current channel is not matched current fd, fd = %d", fd);
+                return false;
+            }
+        }
+        channel->set_index(kAdded);
+
+        if (channel->isNoneEvent())
+            return true;
+
+        armPoll(fd, *m_channels.slot(fd));
+        return true;
+    }
+
+    ChannelEntry *slot = m_channels.slot(fd);
+    if (slot == nullptr || slot->channel != channel || index != kAdded)
+    {
+        LOG_ERROR("current channel is not matched current fd, fd = %d, channel = 0x%x", fd, channel);
+        return false;
+    }
+
+    ChannelEntry &entry = *slot;
+    if (channel->isNoneEvent())
+    {
+        cancelPoll(fd, entry);
+        channel->set_index(kDeleted);
+    }
+    else if (entry.armedEvents != static_cast<uint32_t>(channel->events()))
+    {
+        // 事件变化时撤销旧的poll再登记新的，两个SQE在下次poll()时一起提交
+        cancelPoll(fd, entry);
+        armPoll(fd, entry);
+    }
+
+    return true;
+}
+
+void IoUringPoller::removeChannel(Channel *channel)
+{
+    assertInLoopThread();
+    int fd = channel->fd();
+
+    ChannelEntry *slot = m_channels.slot(fd);
+    if (slot == nullptr || slot->channel != channel || !channel->isNoneEvent())
+        return;
+
+    int index = channel->index();
+    if (index != kAdded && index != kDeleted)
+        return;
+
+    cancelPoll(fd, *slot);
+    m_channels.remove(fd);
+    channel->set_index(kNew);
+}
+
+void IoUringPoller::armPoll(int fd, ChannelEntry &entry)
+{
+    struct io_uring_sqe *sqe = getSqe();
+    if (sqe == NULL)
+    {
+        LOG_ERROR("io_uring submission queue is full, fd = %d", fd);
+        return;
+    }
+
+    uint32_t generation = m_nextGeneration++;
+    if (m_nextGeneration == 0)
+        m_nextGeneration = 1;
+
+    // multishot poll只在fd状态变化时产生新的完成事件，语义和EPOLLET一样，所以只给边缘触发的Channel用
+    // 水平触发的Channel用one-shot poll，触发后在下一次poll()时重新登记，登记时fd仍然就绪会立刻完成
+    uint32_t events = static_cast<uint32_t>(entry.channel->events());
+    bool multishot = (events & EPOLLET) != 0;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events & ~static_cast<uint32_t>(EPOLLET);
+    sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = makeUserData(fd, generation);
+
+    entry.pollGeneration = generation;
+    entry.armedEvents = events;
+}
+
+void IoUringPoller::cancelPoll(int fd, ChannelEntry &entry)
+{
+    if (entry.armedEvents != 0)
+    {
+        struct io_uring_sqe *sqe = getSqe();
+        if (sqe != NULL)
+        {
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = makeUserData(fd, entry.pollGeneration);
+            sqe->user_data = kIgnoredUserData;
+        }
+        else
+        {
+            LOG_ERROR("io_uring submission queue is full, fd = %d", fd);
+        }
+    }
+
+    // 之后收到的这个fd的旧事件都会因为generation不匹配被丢弃
+    entry.pollGeneration = 0;
+    entry.armedEvents = 0;
+}
+
+struct io_uring_sqe *IoUringPoller::getSqe()
+{
+    unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    if (m_sqLocalTail - head >= m_sqEntries)
+    {
+        // 提交队列满了，先把已经填好的提交掉
+        submitAndWait(0, 0);
+        head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        if (m_sqLocalTail - head >= m_sqEntries)
+            return NULL;
+    }
+
+    unsigned index = m_sqLocalTail & *m_sqMask;
+    struct io_uring_sqe *sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof *sqe);
+    m_sqArray[index] = index;
+    ++m_sqLocalTail;
+    return sqe;
+}
+
+int IoUringPoller::submitAndWait(unsigned waitNr, int timeoutMs)
+{
+    unsigned toSubmit = m_sqLocalTail - *m_sqTail;
+    __atomic_store_n(m_sqTail, m_sqLocalTail, __ATOMIC_RELEASE);
+
+    if (toSubmit == 0 && waitNr == 0)
+        return 0;
+
+    unsigned flags = 0;
+    if (waitNr == 0)
+        return ioUringEnter(m_ringfd, toSubmit, 0, flags, NULL, _NSIG / 8);
+
+    flags |= IORING_ENTER_GETEVENTS;
+    if (timeoutMs < 0)
+        return ioUringEnter(m_ringfd, toSubmit, waitNr, flags, NULL, _NSIG / 8);
+
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof arg);
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    flags |= IORING_ENTER_EXT_ARG;
+    return ioUringEnter(m_ringfd, toSubmit, waitNr, flags, &arg, sizeof arg);
+}
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ *  Filename:   IoUringPoller.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:使用io_uring的poll实现的Poller类，Linux 5.13以上可用
+ *              边缘触发(EPOLLET)的fd用multishot poll，只需要提交一次POLL_ADD，
+ *              水平触发的fd用one-shot poll，触发后重新登记，
+ *              注册、修改、删除、重新登记都只是填SQE，统一在下一次poll()时和等待一起提交，
+ *              一轮循环只需要一次io_uring_enter系统调用
+ */
+
+#pragma once
+
+#ifndef _WIN32
+
+#include <vector>
+#include <stdint.h>
+
+#include "Poller.h"
+#include "ChannelTable.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace net
+{
+    class EventLoop;
+
+    class IoUringPoller : public Poller
+    {
+    public:
+        IoUringPoller(EventLoop *loop, unsigned entries = kDefaultEntries);
+        virtual ~IoUringPoller();
+
+        // 内核是否支持，构造失败时由调用者退回到其他Poller
+        bool valid() const { return m_ringfd >= 0; }
+
+        virtual int64_t poll(int timeoutMs, ChannelList *activeChannels);
+        virtual bool updateChannel(Channel *channel);
+        virtual void removeChannel(Channel *channel);
+
+        virtual bool hasChannel(Channel *channel) const;
+        virtual bool supportsEdgeTriggered() const { return true; }
+
+        void assertInLoopThread() const;
+
+    private:
+        static const unsigned kDefaultEntries = 1024;
+
+        struct PollState
+        {
+            uint32_t pollGeneration = 0; // 每次提交POLL_ADD都换一个新的，用来丢弃过期的完成事件
+            uint32_t armedEvents = 0;    // 当前内核中登记的事件，0表示没有登记
+            int64_t pollRound = 0;       // 在第几轮poll中被加入activeChannels，用来合并同一个fd的多个完成事件
+        };
+        typedef ChannelTable<PollState> ChannelMap;
+        typedef ChannelMap::Slot ChannelEntry;
+
+        bool setupRing(unsigned entries);
+        io_uring_sqe *getSqe();
+        int submitAndWait(unsigned waitNr, int timeoutMs);
+        void armPoll(int fd, ChannelEntry &entry);
+        void cancelPoll(int fd, ChannelEntry &entry);
+        void fillActiveChannels(ChannelList *activeChannels);
+
+        static uint64_t makeUserData(int fd, uint32_t generation);
+
+    private:
+        int m_ringfd;
+        EventLoop *m_ownerLoop;
+        ChannelMap m_channels;
+        uint32_t m_nextGeneration;
+        int64_t m_pollRound;
+        std::vector<int> m_rearmFds; // 已经触发的one-shot poll、被内核终止或者出错的poll，需要重新登记的fd
+
+        // 内核共享的提交队列
+        void *m_sqRing;
+        size_t m_sqRingSize;
+        unsigned *m_sqHead;
+        unsigned *m_sqTail;
+        unsigned *m_sqMask;
+        unsigned *m_sqArray;
+        unsigned m_sqEntries;
+        unsigned m_sqLocalTail; // 已经填好但还没提交的SQE
+        io_uring_sqe *m_sqes;
+        size_t m_sqesSize;
+
+        // 内核共享的完成队列
+        void *m_cqRing;
+        size_t m_cqRingSize;
+        unsigned *m_cqHead;
+        unsigned *m_cqTail;
+        unsigned *m_cqMask;
+        io_uring_cqe *m_cqes;
+    };
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ *  Filename:   LoopDispatcher.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:EventLoopThreadPool给新连接选择loop的策略
+ */
+
+#include "LoopDispatcher.h"
+
+using namespace net;
+
+namespace
+{
+    // 每隔多久重新计算一次收发速率
+    const int64_t kSampleIntervalUs = 100 * 1000;
+    // 速率的指数加权系数，越大越看重最近一次采样
+    const double kRateAlpha = 0.5;
+    // 每秒收发1MB折算成一个连接的负载
+    const double kBytesPerSecondPerConnection = 1024.0 * 1024.0;
+}
+
+LoopDispatcher *LoopDispatcher::create(Policy policy)
+{
+    switch (policy)
+    {
+    case kLeastLoaded:
+        return new LeastLoadedDispatcher();
+    case kPowerOfTwoChoices:
+        return new PowerOfTwoChoicesDispatcher();
+    case kRoundRobin:
+    default:
+        return new RoundRobinDispatcher();
+    }
+}
+
+size_t RoundRobinDispatcher::select(const std::vector<LoopLoad> &loads, int64_t nowUs)
+{
+    (void)nowUs;
+    if (m_next >= loads.size())
+        m_next = 0;
+    return m_next++;
+}
+
+LoadAwareDispatcher::LoadAwareDispatcher() : m_lastSampleUs(0)
+{
+}
+
+void LoadAwareDispatcher::sample(const std::vector<LoopLoad> &loads, int64_t nowUs)
+{
+    if (m_lastBytes.size() != loads.size())
+    {
+        m_lastBytes.resize(loads.size());
+        m_bytesPerSecond.assign(loads.size(), 0.0);
+        for (size_t i = 0; i < loads.size(); ++i)
+            m_lastBytes[i] = loads[i].bytesTransferred;
+        m_lastSampleUs = nowUs;
+        return;
+    }
+
+    int64_t elapsedUs = nowUs - m_lastSampleUs;
+    if (elapsedUs < kSampleIntervalUs)
+        return;
+
+    for (size_t i = 0; i < loads.size(); ++i)
+    {
+        double rate = static_cast<double>(loads[i].bytesTransferred - m_lastBytes[i]) * 1000000.0 / static_cast<double>(elapsedUs);
+        m_bytesPerSecond[i] = kRateAlpha * rate + (1 - kRateAlpha) * m_bytesPerSecond[i];
+        m_lastBytes[i] = loads[i].bytesTransferred;
+    }
+    m_lastSampleUs = nowUs;
+}
+
+double LoadAwareDispatcher::score(const std::vector<LoopLoad> &loads, size_t index) const
+{
+    const LoopLoad &load = loads[index];
+    double rate = index < m_bytesPerSecond.size() ? m_bytesPerSecond[index] : 0.0;
+    return load.connections + static_cast<double>(load.queueDepth) + rate / kBytesPerSecondPerConnection;
+}
+
+size_t LeastLoadedDispatcher::select(const std::vector<LoopLoad> &loads, int64_t nowUs)
+{
+    sample(loads, nowUs);
+
+    size_t n = loads.size();
+    if (m_start >= n)
+        m_start = 0;
+
+    size_t best = m_start;
+    double bestScore = score(loads, best);
+    for (size_t k = 1; k < n; ++k)
+    {
+        size_t i = (m_start + k) % n;
+        double s = score(loads, i);
+        if (s < bestScore)
+        {
+            best = i;
+            bestScore = s;
+        }
+    }
+    ++m_start;
+    return best;
+}
+
+uint64_t PowerOfTwoChoicesDispatcher::nextRandom()
+{
+    // xorshift64，够用且没有锁
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 7;
+    m_seed ^= m_seed << 17;
+    return m_seed;
+}
+
+size_t PowerOfTwoChoicesDispatcher::select(const std::vector<LoopLoad> &loads, int64_t nowUs)
+{
+    sample(loads, nowUs);
+
+    size_t n = loads.size();
+    if (n < 2)
+        return 0;
+
+    size_t a = static_cast<size_t>(nextRandom() % n);
+    size_t b = static_cast<size_t>(nextRandom() % (n - 1));
+    if (b >= a)
+        ++b;
+    return score(loads, b) < score(loads, a) ? b : a;
+}
@@ -0,0 +1,96 @@
+/*
+ *  Filename:   LoopDispatcher.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:EventLoopThreadPool给新连接选择loop的策略
+ *              轮询只看顺序，少数几个大流量的长连接可能恰好落在同一个loop上，
+ *              按负载选择的策略综合连接数、任务队列深度和最近的收发速率，
+ *              负载信息由EventLoop实时更新，选择时直接读取，不需要加锁
+ */
+
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace net
+{
+    // 某一时刻一个loop的负载
+    struct LoopLoad
+    {
+        int connections;           // 当前的连接数
+        size_t queueDepth;         // 还没有执行的任务数
+        uint64_t bytesTransferred; // 累计收发的字节数，用来计算速率
+    };
+
+    class LoopDispatcher
+    {
+    public:
+        enum Policy
+        {
+            kRoundRobin,
+            kLeastLoaded,
+            kPowerOfTwoChoices,
+        };
+
+        static LoopDispatcher *create(Policy policy);
+
+        virtual ~LoopDispatcher() {}
+
+        // loads[i]是第i个loop当前的负载，nowUs是当前时间(微秒)，返回选中的下标
+        // 只在一个线程里调用(通常是accept所在的base loop)
+        virtual size_t select(const std::vector<LoopLoad> &loads, int64_t nowUs) = 0;
+    };
+
+    class RoundRobinDispatcher : public LoopDispatcher
+    {
+    public:
+        RoundRobinDispatcher() : m_next(0) {}
+        virtual size_t select(const std::vector<LoopLoad> &loads, int64_t nowUs);
+
+    private:
+        size_t m_next;
+    };
+
+    // 把连接数、队列深度和收发速率折算成一个负载分数，分数越小越空闲
+    class LoadAwareDispatcher : public LoopDispatcher
+    {
+    public:
+        LoadAwareDispatcher();
+
+    protected:
+        // 调用score()之前先调用，按固定间隔更新每个loop的收发速率
+        void sample(const std::vector<LoopLoad> &loads, int64_t nowUs);
+        double score(const std::vector<LoopLoad> &loads, size_t index) const;
+
+    private:
+        std::vector<uint64_t> m_lastBytes;
+        std::vector<double> m_bytesPerSecond; // 指数加权平均后的速率
+        int64_t m_lastSampleUs;
+    };
+
+    // 每次扫描所有loop，选负载最小的，负载相同时轮流选，避免都落到第一个loop上
+    class LeastLoadedDispatcher : public LoadAwareDispatcher
+    {
+    public:
+        LeastLoadedDispatcher() : m_start(0) {}
+        virtual size_t select(const std::vector<LoopLoad> &loads, int64_t nowUs);
+
+    private:
+        size_t m_start;
+    };
+
+    // 随机选两个loop取负载小的那个，负载信息有延迟时也不会所有新连接都涌向同一个loop
+    class PowerOfTwoChoicesDispatcher : public LoadAwareDispatcher
+    {
+    public:
+        PowerOfTwoChoicesDispatcher() : m_seed(0x9E3779B97F4A7C15ULL) {}
+        virtual size_t select(const std::vector<LoopLoad> &loads, int64_t nowUs);
+
+    private:
+        uint64_t nextRandom();
+
+        uint64_t m_seed;
+    };
+}
@@ -0,0 +1,240 @@
+/*
+ *  Filename:   LoopStats.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:EventLoop每轮循环的统计数据
+ */
+
+#include "LoopStats.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "../base/Clock.h"
+
+using namespace net;
+
+namespace
+{
+    int highestBit(uint64_t value)
+    {
+#if defined(__GNUC__)
+        return 63 - __builtin_clzll(value);
+#else
+        int bit = 0;
+        while (value >>= 1)
+            ++bit;
+        return bit;
+#endif
+    }
+
+    void appendHistogram(std::ostringstream &oss, const char *name, const LatencyHistogram &histogram)
+    {
+        LatencyHistogram::Snapshot s = histogram.snapshot();
+        oss << name << ": count=" << s.count
+            << " mean=" << static_cast<uint64_t>(s.mean())
+            << " p50=" << s.percentile(50)
+            << " p99=" << s.percentile(99)
+            << " p999=" << s.percentile(99.9)
+            << " max=" << s.max << "\n";
+    }
+}
+
+LatencyHistogram::LatencyHistogram() : m_count(0), m_sum(0), m_max(0)
+{
+    for (int i = 0; i < kBucketCount; ++i)
+        m_buckets[i].store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucketIndex(uint64_t value)
+{
+    if (value < static_cast<uint64_t>(kSubBuckets))
+        return static_cast<int>(value);
+
+    int shift = highestBit(value) - kSubBucketBits;
+    int sub = static_cast<int>((value >> shift) & (kSubBuckets - 1));
+    return (shift + 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < kSubBuckets)
+        return static_cast<uint64_t>(index);
+
+    int shift = index / kSubBuckets - 1;
+    uint64_t sub = static_cast<uint64_t>(index % kSubBuckets);
+    // 最后一个桶左移后回绕成0，减1正好是UINT64_MAX
+    return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value)
+{
+    add(m_buckets[bucketIndex(value)], 1);
+    add(m_sum, value);
+    if (value > m_max.load(std::memory_order_relaxed))
+        m_max.store(value, std::memory_order_relaxed);
+    // count最后更新，读者用它判断样本数，不会比桶里的样本多
+    m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    Snapshot s;
+    s.count = m_count.load(std::memory_order_acquire);
+    s.sum = m_sum.load(std::memory_order_relaxed);
+    s.max = m_max.load(std::memory_order_relaxed);
+    s.buckets.resize(kBucketCount);
+    for (int i = 0; i < kBucketCount; ++i)
+        s.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+    return s;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const
+{
+    uint64_t total = 0;
+    for (uint64_t n : buckets)
+        total += n;
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total) + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > total)
+        rank = total;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(LatencyHistogram::bucketUpperBound(static_cast<int>(i)), max);
+    }
+    return max;
+}
+
+LoopStats::LoopStats() : m_iterations(0), m_slowSeq(0), m_slowThreshold(0)
+{
+    for (int i = 0; i < kSlowHandlers; ++i)
+    {
+        m_slowFds[i].store(-1, std::memory_order_relaxed);
+        m_slowDurations[i].store(0, std::memory_order_relaxed);
+        m_slowWhens[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+int64_t LoopStats::nowNs()
+{
+    // 启用了TSC时直接读TSC，见Clock::enableTsc()
+    return Clock::fastNowNs();
+}
+
+void LoopStats::recordPoll(int64_t blockedNs, size_t activeChannels)
+{
+    m_iterations.store(m_iterations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_pollBlockedNs.record(static_cast<uint64_t>(blockedNs));
+    m_activeChannels.record(activeChannels);
+}
+
+void LoopStats::recordHandler(int fd, int64_t durationNs)
+{
+    // 绝大多数调用在这里就返回了
+    if (durationNs <= m_slowThreshold)
+        return;
+
+    int slot = 0;
+    for (int i = 1; i < kSlowHandlers; ++i)
+    {
+        if (m_slowDurations[i].load(std::memory_order_relaxed) < m_slowDurations[slot].load(std::memory_order_relaxed))
+            slot = i;
+    }
+
+    uint32_t seq = m_slowSeq.load(std::memory_order_relaxed);
+    m_slowSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_slowFds[slot].store(fd, std::memory_order_relaxed);
+    m_slowDurations[slot].store(durationNs, std::memory_order_relaxed);
+    m_slowWhens[slot].store(Timestamp::now().microSecondsSinceEpoch(), std::memory_order_relaxed);
+    m_slowSeq.store(seq + 2, std::memory_order_release);
+
+    int64_t threshold = m_slowDurations[0].load(std::memory_order_relaxed);
+    for (int i = 1; i < kSlowHandlers; ++i)
+        threshold = std::min(threshold, m_slowDurations[i].load(std::memory_order_relaxed));
+    m_slowThreshold = threshold;
+}
+
+void LoopStats::recordDispatch(int64_t durationNs)
+{
+    m_dispatchNs.record(static_cast<uint64_t>(durationNs));
+}
+
+void LoopStats::recordTimers(int64_t durationNs)
+{
+    m_timersNs.record(static_cast<uint64_t>(durationNs));
+}
+
+void LoopStats::recordTasks(int64_t durationNs, size_t queueDepth)
+{
+    m_tasksNs.record(static_cast<uint64_t>(durationNs));
+    m_queueDepth.record(queueDepth);
+}
+
+void LoopStats::recordFrame(int64_t durationNs)
+{
+    m_frameNs.record(static_cast<uint64_t>(durationNs));
+}
+
+void LoopStats::recordIteration(int64_t durationNs)
+{
+    m_iterationNs.record(static_cast<uint64_t>(durationNs));
+}
+
+std::vector<LoopStats::SlowHandler> LoopStats::slowestHandlers() const
+{
+    std::vector<SlowHandler> handlers;
+    for (;;)
+    {
+        handlers.clear();
+        uint32_t seq = m_slowSeq.load(std::memory_order_acquire);
+        if (seq & 1)
+            continue;
+
+        for (int i = 0; i < kSlowHandlers; ++i)
+        {
+            SlowHandler h;
+            h.fd = m_slowFds[i].load(std::memory_order_relaxed);
+            h.durationNs = m_slowDurations[i].load(std::memory_order_relaxed);
+            h.when = Timestamp(m_slowWhens[i].load(std::memory_order_relaxed));
+            if (h.fd >= 0)
+                handlers.push_back(h);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_slowSeq.load(std::memory_order_relaxed) == seq)
+            break;
+    }
+
+    std::sort(handlers.begin(), handlers.end(), [](const SlowHandler &l, const SlowHandler &r)
+              { return l.durationNs > r.durationNs; });
+    return handlers;
+}
+
+std::string LoopStats::toString() const
+{
+    std::ostringstream oss;
+    oss << "iterations: " << iterations() << "\n";
+    appendHistogram(oss, "poll blocked ns", m_pollBlockedNs);
+    appendHistogram(oss, "active channels", m_activeChannels);
+    appendHistogram(oss, "dispatch ns", m_dispatchNs);
+    appendHistogram(oss, "timers ns", m_timersNs);
+    appendHistogram(oss, "tasks ns", m_tasksNs);
+    appendHistogram(oss, "queue depth", m_queueDepth);
+    appendHistogram(oss, "frame ns", m_frameNs);
+    appendHistogram(oss, "iteration ns", m_iterationNs);
+    for (const SlowHandler &h : slowestHandlers())
+    {
+        oss << "slow handler: fd=" << h.fd << " ns=" << h.durationNs
+            << " at " << h.when.toFormattedString() << "\n";
+    }
+    return oss.str();
+}
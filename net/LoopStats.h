@@ -0,0 +1,133 @@
+/*
+ *  Filename:   LoopStats.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:EventLoop每轮循环的统计数据，包括poll阻塞时间、每次唤醒的活跃Channel数、
+ *              各阶段(事件处理、定时器、任务队列、帧回调)耗时、任务队列深度和最慢的几次事件处理
+ *              只有loop线程写，写的时候不加锁也不用原子加，其他线程随时可以读
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "../base/Timestamp.h"
+
+namespace net
+{
+    // 对数-线性分桶的直方图(类似HdrHistogram)，每个2的幂区间再均分成8个桶，相对误差不超过12.5%
+    // 单线程写，多线程读，读到的数据可能比最新的少几个样本
+    class LatencyHistogram
+    {
+    public:
+        LatencyHistogram();
+
+        LatencyHistogram(const LatencyHistogram &rhs) = delete;
+        LatencyHistogram &operator=(const LatencyHistogram &rhs) = delete;
+
+        // 只能由写线程调用
+        void record(uint64_t value);
+
+        struct Snapshot
+        {
+            uint64_t count;
+            uint64_t sum;
+            uint64_t max;
+            std::vector<uint64_t> buckets;
+
+            double mean() const { return count == 0 ? 0.0 : static_cast<double>(sum) / count; }
+            // p取值0到100，返回所在桶的上界，不会超过max
+            uint64_t percentile(double p) const;
+        };
+        // 任意线程调用
+        Snapshot snapshot() const;
+
+        static int bucketIndex(uint64_t value);
+        static uint64_t bucketUpperBound(int index);
+
+    private:
+        static const int kSubBucketBits = 3;
+        static const int kSubBuckets = 1 << kSubBucketBits;
+        static const int kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+        // 只有一个写线程，用load+store代替fetch_add，省掉总线锁
+        static void add(std::atomic<uint64_t> &counter, uint64_t n)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        std::atomic<uint64_t> m_count;
+        std::atomic<uint64_t> m_sum;
+        std::atomic<uint64_t> m_max;
+        std::atomic<uint64_t> m_buckets[kBucketCount];
+    };
+
+    class LoopStats
+    {
+    public:
+        struct SlowHandler
+        {
+            int fd;
+            int64_t durationNs;
+            Timestamp when;
+        };
+
+        LoopStats();
+
+        LoopStats(const LoopStats &rhs) = delete;
+        LoopStats &operator=(const LoopStats &rhs) = delete;
+
+        // 单调时钟，纳秒，启用了TSC时走Clock::fastNowNs()的快速路径
+        static int64_t nowNs();
+
+        // 以下只能由loop线程调用
+        void recordPoll(int64_t blockedNs, size_t activeChannels);
+        void recordHandler(int fd, int64_t durationNs);
+        void recordDispatch(int64_t durationNs);
+        void recordTimers(int64_t durationNs);
+        void recordTasks(int64_t durationNs, size_t queueDepth);
+        void recordFrame(int64_t durationNs);
+        void recordIteration(int64_t durationNs);
+
+        // 以下任意线程都可以调用
+        int64_t iterations() const { return m_iterations.load(std::memory_order_relaxed); }
+        const LatencyHistogram &pollBlockedNs() const { return m_pollBlockedNs; }
+        const LatencyHistogram &activeChannels() const { return m_activeChannels; }
+        // 事件处理阶段不含timerfd回调里执行定时器的时间，那部分只算在timersNs里
+        const LatencyHistogram &dispatchNs() const { return m_dispatchNs; }
+        const LatencyHistogram &timersNs() const { return m_timersNs; }
+        const LatencyHistogram &tasksNs() const { return m_tasksNs; }
+        const LatencyHistogram &frameNs() const { return m_frameNs; }
+        const LatencyHistogram &iterationNs() const { return m_iterationNs; }
+        const LatencyHistogram &queueDepth() const { return m_queueDepth; }
+        // 按耗时从大到小排序
+        std::vector<SlowHandler> slowestHandlers() const;
+
+        // 所有统计数据的可读文本，用于日志和调试
+        std::string toString() const;
+
+    private:
+        static const int kSlowHandlers = 8;
+
+        std::atomic<int64_t> m_iterations;
+        LatencyHistogram m_pollBlockedNs;
+        LatencyHistogram m_activeChannels;
+        LatencyHistogram m_dispatchNs;
+        LatencyHistogram m_timersNs;
+        LatencyHistogram m_tasksNs;
+        LatencyHistogram m_frameNs;
+        LatencyHistogram m_iterationNs; // 一轮循环除去poll阻塞以外的时间
+        LatencyHistogram m_queueDepth;
+
+        // 最慢的几次事件处理，用顺序锁(seqlock)保护：写之前序号变成奇数，写完变成偶数，
+        // 读的时候序号是奇数或者前后不一致就重读，loop线程不会被读者阻塞
+        std::atomic<uint32_t> m_slowSeq;
+        std::atomic<int> m_slowFds[kSlowHandlers];
+        std::atomic<int64_t> m_slowDurations[kSlowHandlers];
+        std::atomic<int64_t> m_slowWhens[kSlowHandlers];
+        int64_t m_slowThreshold; // 当前记录里最小的耗时，只有loop线程访问
+    };
+}
@@ -0,0 +1,102 @@
+/*
+ *  Filename:   MpscQueue.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:侵入式无锁多生产者单消费者队列(Dmitry Vyukov的算法)
+ *              生产者只做一次原子exchange，消费者不需要任何原子RMW操作，
+ *              元素需要继承MpscNode，队列本身不负责分配和释放元素
+ */
+
+#pragma once
+
+#include <atomic>
+
+namespace net
+{
+    struct MpscNode
+    {
+        std::atomic<MpscNode *> m_next{nullptr};
+    };
+
+    template <typename T>
+    class MpscQueue
+    {
+    public:
+        MpscQueue() : m_head(&m_stub), m_tail(&m_stub)
+        {
+        }
+
+        MpscQueue(const MpscQueue &rhs) = delete;
+        MpscQueue &operator=(const MpscQueue &rhs) = delete;
+
+        // 任意线程调用
+        void push(T *node)
+        {
+            pushChain(node, node);
+        }
+
+        // 批量入队，first到last已经通过m_next串好，整条链只需要一次原子exchange
+        void pushChain(T *first, T *last)
+        {
+            pushNodes(first, last);
+        }
+
+        // 只能由消费者线程调用
+        // 返回nullptr表示队列为空，或者有生产者正在入队(稍后再取即可)
+        T *pop()
+        {
+            MpscNode *tail = m_tail;
+            MpscNode *next = tail->m_next.load(std::memory_order_acquire);
+            if (tail == &m_stub)
+            {
+                if (next == nullptr)
+                    return nullptr;
+
+                m_tail = next;
+                tail = next;
+                next = next->m_next.load(std::memory_order_acquire);
+            }
+
+            if (next != nullptr)
+            {
+                m_tail = next;
+                return static_cast<T *>(tail);
+            }
+
+            MpscNode *head = m_head.load(std::memory_order_acquire);
+            if (tail != head)
+                return nullptr;
+
+            // 队列里只剩最后一个元素，把stub放回去，这样才能把最后一个元素取出来
+            pushNodes(&m_stub, &m_stub);
+            next = tail->m_next.load(std::memory_order_acquire);
+            if (next != nullptr)
+            {
+                m_tail = next;
+                return static_cast<T *>(tail);
+            }
+
+            return nullptr;
+        }
+
+        // 只能由消费者线程调用
+        bool empty() const
+        {
+            return m_tail == &m_stub && m_stub.m_next.load(std::memory_order_acquire) == nullptr;
+        }
+
+    private:
+        void pushNodes(MpscNode *first, MpscNode *last)
+        {
+            last->m_next.store(nullptr, std::memory_order_relaxed);
+            MpscNode *prev = m_head.exchange(last, std::memory_order_acq_rel);
+            prev->m_next.store(first, std::memory_order_release);
+        }
+
+    private:
+        // 生产者和消费者各用各的缓存行，避免伪共享
+        alignas(64) std::atomic<MpscNode *> m_head; // 生产者入队的位置
+        alignas(64) MpscNode *m_tail;               // 消费者出队的位置
+        MpscNode m_stub;
+    };
+}
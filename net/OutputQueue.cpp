@@ -0,0 +1,516 @@
+/*
+ *  Filename:   OutputQueue.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:TcpConnection的输出队列
+ */
+
+#include "OutputQueue.h"
+
+#include <algorithm>
+
+#ifndef _WIN32
+#include <limits.h>
+#include <netinet/in.h>
+#include <sys/sendfile.h>
+#endif
+// MSG_ZEROCOPY和错误队列里的完成通知只有Linux有
+#ifdef __linux__
+#include <linux/errqueue.h>
+#define NET_HAS_ZEROCOPY 1
+#endif
+
+#include "../base/AsyncLog.h"
+#include "Sockets.h"
+
+using namespace net;
+
+namespace
+{
+    // 一次write、writev和sendfile最多发这么多，和Linux单次读写的上限(MAX_RW_COUNT)一样，
+    // 也在int32_t的范围内，sockets::write的长度参数不会溢出
+    const size_t kMaxWriteBytes = 0x7ffff000;
+
+#ifdef NET_HAS_ZEROCOPY
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+#endif
+
+    // 编号会回绕，按差值判断id是否在[lo, hi]里
+    bool idInRange(uint32_t id, uint32_t lo, uint32_t hi)
+    {
+        return static_cast<int32_t>(id - lo) >= 0 && static_cast<int32_t>(hi - id) >= 0;
+    }
+}
+
+const size_t OutputQueue::kCopyThreshold;
+const int OutputQueue::kMaxIovecs;
+const size_t OutputQueue::kMaxZeroCopyPinnedBytes;
+const int OutputQueue::kMaxZeroCopyBackoff;
+
+OutputQueue::Entry::Entry(Entry &&rhs) noexcept
+    : m_kind(rhs.m_kind),
+      m_buffer(std::move(rhs.m_buffer)),
+      m_owner(std::move(rhs.m_owner)),
+      m_data(rhs.m_data),
+      m_size(rhs.m_size),
+      m_offset(rhs.m_offset),
+      m_fd(rhs.m_fd),
+      m_fileOffset(rhs.m_fileOffset),
+      m_length(rhs.m_length)
+{
+    rhs.m_fd = -1;
+}
+
+OutputQueue::Entry::~Entry()
+{
+    if (m_fd >= 0)
+        ::close(m_fd);
+}
+
+size_t OutputQueue::Entry::readableBytes() const
+{
+    switch (m_kind)
+    {
+    case kBuffer:
+        return m_buffer.readableBytes();
+    case kBlob:
+        return m_size - m_offset;
+    default:
+        return m_length;
+    }
+}
+
+OutputQueue::OutputQueue()
+    : m_bytes(0),
+      m_zeroCopyThreshold(0),
+      m_zeroCopyPinnedBytes(0),
+      m_zeroCopyNextId(0),
+      m_zeroCopyCopied(0),
+      m_zeroCopyBackoff(0),
+      m_zeroCopySkips(0)
+{
+}
+
+size_t OutputQueue::segmentCount() const
+{
+    size_t count = 0;
+    for (const Entry &entry : m_entries)
+        count += entry.m_kind == kBuffer ? entry.m_buffer.segmentCount() : 1;
+    return count;
+}
+
+CompositeByteBuffer &OutputQueue::tailBuffer()
+{
+    if (m_entries.empty() || m_entries.back().m_kind != kBuffer)
+        m_entries.emplace_back(kBuffer);
+    return m_entries.back().m_buffer;
+}
+
+void OutputQueue::append(const void *data, size_t len)
+{
+    if (len == 0)
+        return;
+    tailBuffer().append(data, len);
+    m_bytes += len;
+}
+
+void OutputQueue::append(std::string &&str)
+{
+    if (str.size() < kCopyThreshold)
+    {
+        append(str.data(), str.size());
+        return;
+    }
+
+    std::shared_ptr<std::string> owner = std::make_shared<std::string>(std::move(str));
+    appendBlob(owner, owner->data(), owner->size());
+}
+
+void OutputQueue::append(ByteBuffer &&buf)
+{
+    if (buf.readableBytes() < kCopyThreshold)
+    {
+        append(buf.peek(), buf.readableBytes());
+        buf.retrieveAll();
+        return;
+    }
+
+    // 移动之后内存地址不变，peek()仍然指向同一块数据
+    std::shared_ptr<ByteBuffer> owner = std::make_shared<ByteBuffer>(std::move(buf));
+    appendBlob(owner, owner->peek(), owner->readableBytes());
+}
+
+void OutputQueue::appendBlob(std::shared_ptr<const void> owner, const char *data, size_t size)
+{
+    m_bytes += size;
+    m_entries.emplace_back(kBlob);
+    Entry &entry = m_entries.back();
+    entry.m_owner = std::move(owner);
+    entry.m_data = data;
+    entry.m_size = size;
+}
+
+void OutputQueue::append(const CompositeByteBuffer &buf)
+{
+    if (buf.empty())
+        return;
+
+    CompositeByteBuffer &tail = tailBuffer();
+    if (buf.readableBytes() < kCopyThreshold)
+    {
+        // 小块数据拷贝比增减引用计数(原子操作)还便宜
+        for (size_t i = 0; i < buf.segmentCount(); ++i)
+            tail.append(buf.segment(i).m_data, buf.segment(i).m_length);
+    }
+    else
+    {
+        tail.append(buf);
+    }
+    m_bytes += buf.readableBytes();
+}
+
+void OutputQueue::append(CompositeByteBuffer &&buf)
+{
+    if (buf.readableBytes() < kCopyThreshold)
+    {
+        append(static_cast<const CompositeByteBuffer &>(buf));
+        return;
+    }
+    m_bytes += buf.readableBytes();
+    tailBuffer().append(std::move(buf));
+}
+
+void OutputQueue::appendFile(int fd, int64_t offset, size_t len)
+{
+    if (len == 0)
+    {
+        ::close(fd);
+        return;
+    }
+
+    m_entries.emplace_back(kFile);
+    Entry &entry = m_entries.back();
+    entry.m_fd = fd;
+    entry.m_fileOffset = offset;
+    entry.m_length = len;
+    m_bytes += len;
+}
+
+ssize_t OutputQueue::writeTo(int sockfd, int *savedErrno, size_t *attempted, size_t maxBytes)
+{
+    // 前面已经发完的空段(保留下来复用内存块的CompositeByteBuffer)直接跳过
+    while (!m_entries.empty() && m_entries.front().readableBytes() == 0 && m_entries.size() > 1)
+        m_entries.pop_front();
+
+    // 顺便收掉已经到达的完成通知，不能只靠错误事件：有的Poller不报告错误，暂停读之后fd也可能不在Poller里
+    if (!m_zeroCopySends.empty())
+        handleZeroCopyCompletions(sockfd);
+
+    size_t ignored = 0;
+    if (attempted == NULL)
+        attempted = &ignored;
+    *attempted = 0;
+    if (m_bytes == 0 || maxBytes == 0)
+        return 0;
+
+    if (m_entries.front().m_kind == kFile)
+        return writeFile(sockfd, m_entries.front(), savedErrno, attempted, maxBytes);
+    return writeMemory(sockfd, savedErrno, attempted, maxBytes);
+}
+
+ssize_t OutputQueue::writeMemory(int sockfd, int *savedErrno, size_t *attempted, size_t maxBytes)
+{
+    maxBytes = std::min(maxBytes, kMaxWriteBytes);
+#ifndef _WIN32
+    // 一个连接积压的段很多时数组很大，放在线程局部存储里，不占栈
+    static thread_local struct iovec vec[kMaxIovecs];
+    int maxIov = std::min(kMaxIovecs, IOV_MAX);
+    int count = 0;
+    for (size_t i = 0; i < m_entries.size() && count < maxIov; ++i)
+    {
+        const Entry &entry = m_entries[i];
+        if (entry.m_kind == kFile)
+            break;
+
+        if (entry.m_kind == kBuffer)
+        {
+            int filled = entry.m_buffer.fillIovec(vec + count, maxIov - count);
+            for (int j = count; j < count + filled; ++j)
+                *attempted += vec[j].iov_len;
+            count += filled;
+        }
+        else if (entry.m_size > entry.m_offset)
+        {
+            vec[count].iov_base = const_cast<char *>(entry.m_data + entry.m_offset);
+            vec[count].iov_len = entry.m_size - entry.m_offset;
+            *attempted += vec[count].iov_len;
+            ++count;
+        }
+    }
+
+    // 超出maxBytes的部分截掉，留到下一次
+    if (*attempted > maxBytes)
+    {
+        size_t left = maxBytes;
+        int kept = 0;
+        for (; left > 0; ++kept)
+        {
+            vec[kept].iov_len = std::min(vec[kept].iov_len, left);
+            left -= vec[kept].iov_len;
+        }
+        count = kept;
+        *attempted = maxBytes;
+    }
+
+    ssize_t n = -1;
+    bool zeroCopy = useZeroCopy(*attempted);
+#ifdef NET_HAS_ZEROCOPY
+    if (zeroCopy)
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof msg);
+        msg.msg_iov = vec;
+        msg.msg_iovlen = count;
+        n = ::sendmsg(sockfd, &msg, MSG_ZEROCOPY);
+        // 锁定的内存超过了optmem_max，这一次改成普通发送
+        if (n < 0 && errno == ENOBUFS)
+            zeroCopy = false;
+    }
+#endif
+    if (!zeroCopy)
+    {
+        n = count == 1 ? sockets::write(sockfd, vec[0].iov_base, static_cast<int32_t>(vec[0].iov_len))
+                       : sockets::writev(sockfd, vec, count);
+    }
+    else if (n > 0)
+    {
+        pinZeroCopy(n);
+    }
+#else
+    const Entry &front = m_entries.front();
+    const char *data = NULL;
+    if (front.m_kind == kBuffer)
+    {
+        const CompositeByteBuffer::Segment &segment = front.m_buffer.segment(0);
+        data = segment.m_data;
+        *attempted = segment.m_length;
+    }
+    else
+    {
+        data = front.m_data + front.m_offset;
+        *attempted = front.m_size - front.m_offset;
+    }
+    *attempted = std::min(*attempted, maxBytes);
+    ssize_t n = sockets::write(sockfd, data, static_cast<int32_t>(*attempted));
+#endif
+    if (n < 0)
+    {
+#ifdef _WIN32
+        *savedErrno = ::WSAGetLastError();
+#else
+        *savedErrno = errno;
+#endif
+        return n;
+    }
+
+    consume(n);
+    return n;
+}
+
+ssize_t OutputQueue::writeFile(int sockfd, Entry &entry, int *savedErrno, size_t *attempted, size_t maxBytes)
+{
+    *attempted = std::min(std::min(entry.m_length, kMaxWriteBytes), maxBytes);
+#ifndef _WIN32
+    off_t offset = static_cast<off_t>(entry.m_fileOffset);
+    ssize_t n = ::sendfile(sockfd, entry.m_fd, &offset, *attempted);
+#else
+    // Windows上没有sendfile，读到内存里再发
+    char buf[64 * 1024];
+    *attempted = std::min(*attempted, sizeof buf);
+    ssize_t n = -1;
+    if (::_lseeki64(entry.m_fd, entry.m_fileOffset, SEEK_SET) >= 0)
+    {
+        int got = ::_read(entry.m_fd, buf, static_cast<unsigned int>(*attempted));
+        n = got <= 0 ? got : sockets::write(sockfd, buf, got);
+    }
+#endif
+    if (n < 0)
+    {
+#ifdef _WIN32
+        *savedErrno = ::WSAGetLastError();
+#else
+        *savedErrno = errno;
+#endif
+        return n;
+    }
+    if (n == 0)
+    {
+        // 文件比登记的长度短，剩下的数据永远发不出去，后面的数据也就错位了，只能当作出错
+        *savedErrno = EIO;
+        return -1;
+    }
+
+    consume(n);
+    return n;
+}
+
+void OutputQueue::consume(size_t n)
+{
+    m_bytes -= n;
+    while (n > 0)
+    {
+        Entry &front = m_entries.front();
+        size_t readable = front.readableBytes();
+        size_t taken = std::min(n, readable);
+        if (front.m_kind == kBuffer)
+            front.m_buffer.retrieve(taken);
+        else if (front.m_kind == kBlob)
+            front.m_offset += taken;
+        else
+        {
+            front.m_fileOffset += taken;
+            front.m_length -= taken;
+        }
+        n -= taken;
+
+        // 最后一个CompositeByteBuffer留着，它的内存块没有别人引用时接着往里追加
+        if (taken == readable && (front.m_kind != kBuffer || m_entries.size() > 1))
+            m_entries.pop_front();
+    }
+}
+
+bool OutputQueue::useZeroCopy(size_t bytes)
+{
+#ifdef NET_HAS_ZEROCOPY
+    if (m_zeroCopyThreshold == 0 || bytes < m_zeroCopyThreshold)
+        return false;
+    // 等通知的内存已经很多了，这次先拷贝
+    if (m_zeroCopyPinnedBytes >= kMaxZeroCopyPinnedBytes)
+        return false;
+    if (m_zeroCopySkips > 0)
+    {
+        --m_zeroCopySkips;
+        return false;
+    }
+    return true;
+#else
+    (void)bytes;
+    return false;
+#endif
+}
+
+void OutputQueue::pinZeroCopy(size_t n)
+{
+    m_zeroCopySends.emplace_back();
+    ZeroCopySend &send = m_zeroCopySends.back();
+    send.m_id = m_zeroCopyNextId++;
+    send.m_done = false;
+    send.m_bytes = n;
+    m_zeroCopyPinnedBytes += n;
+    for (size_t i = 0; n > 0; ++i)
+    {
+        const Entry &entry = m_entries[i];
+        size_t taken = std::min(n, entry.readableBytes());
+        if (taken == 0)
+            continue;
+        // 视图只增加内存块的引用计数，队列取走这部分数据之后内存块仍然有效
+        if (entry.m_kind == kBuffer)
+            send.m_buffer.append(entry.m_buffer.slice(0, taken));
+        else
+            send.m_owners.push_back(entry.m_owner);
+        n -= taken;
+    }
+}
+
+int OutputQueue::completeZeroCopy(uint32_t lo, uint32_t hi)
+{
+    int completed = 0;
+    for (ZeroCopySend &send : m_zeroCopySends)
+    {
+        if (!send.m_done && idInRange(send.m_id, lo, hi))
+        {
+            send.m_done = true;
+            ++completed;
+        }
+    }
+    // 通知一般按顺序到达，队头完成了才释放，乱序时先标记
+    while (!m_zeroCopySends.empty() && m_zeroCopySends.front().m_done)
+    {
+        m_zeroCopyPinnedBytes -= m_zeroCopySends.front().m_bytes;
+        m_zeroCopySends.pop_front();
+    }
+    return completed;
+}
+
+int OutputQueue::handleZeroCopyCompletions(int sockfd)
+{
+    int completed = 0;
+#ifdef NET_HAS_ZEROCOPY
+    for (;;)
+    {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof msg);
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+        // 错误队列读空了返回EAGAIN
+        if (::recvmsg(sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            break;
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            bool recvErr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                           (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+            if (!recvErr)
+                continue;
+
+            const struct sock_extended_err *err = reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cm));
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err->ee_errno != 0)
+                continue;
+
+            // 内核没能直接引用内存页，退回了拷贝，零拷贝只会多出通知的开销，
+            // 接下来的几次改用普通发送，次数翻倍，过后再试；内核不再拷贝时退避清零
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                ++m_zeroCopyCopied;
+                if (m_zeroCopyBackoff == 0)
+                    LOGI("OutputQueue, fd = %d, kernel copied MSG_ZEROCOPY data, backing off", sockfd);
+                m_zeroCopyBackoff = std::min(std::max(m_zeroCopyBackoff * 2, 1), kMaxZeroCopyBackoff);
+                m_zeroCopySkips = m_zeroCopyBackoff;
+            }
+            else
+            {
+                m_zeroCopyBackoff = 0;
+            }
+            completed += completeZeroCopy(err->ee_info, err->ee_data);
+        }
+    }
+#else
+    (void)sockfd;
+#endif
+    return completed;
+}
+
+void OutputQueue::clear()
+{
+    // m_zeroCopySends不能清：内核可能还在从这些内存页发数据，内存块回到BufferPool被重用的话发出去的数据就错了
+    m_entries.clear();
+    m_bytes = 0;
+}
+
+void OutputQueue::moveZeroCopySendsTo(OutputQueue *other)
+{
+    for (ZeroCopySend &send : m_zeroCopySends)
+        other->m_zeroCopySends.push_back(std::move(send));
+    other->m_zeroCopyPinnedBytes += m_zeroCopyPinnedBytes;
+    m_zeroCopySends.clear();
+    m_zeroCopyPinnedBytes = 0;
+}
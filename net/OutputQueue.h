@@ -0,0 +1,188 @@
+/*
+ *  Filename:   OutputQueue.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:TcpConnection的输出队列，按顺序排队等待发送的数据段，一次writev尽量多发几段
+ *              拷贝进来的小块数据和共享的CompositeByteBuffer视图放进同一个CompositeByteBuffer，
+ *              小块数据一个接一个地拷进内存块，已有的数据从不挪动，大的视图只增加引用计数；
+ *              移动进来的大字符串和ByteBuffer直接持有，不拷贝；文件区间记下fd、偏移和长度，轮到它时用sendfile发送，fd由队列关闭
+ *              readableBytes()是所有段的字节数之和(包括文件区间)，高水位判断用它
+ *              零拷贝模式：一次要写的内存数据不少于阈值时带MSG_ZEROCOPY发送，内核直接引用这些内存页，
+ *              发出去的部分从队列里取走，但内存块和字符串要等内核从socket错误队列通知发送完成之后才释放，
+ *              clear()也不释放它们；连接关闭时还没收到通知的交给所在loop的ZeroCopyReaper，等通知到了再释放
+ *              只在连接所属的loop线程里使用
+ */
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../base/Platform.h"
+#include "ByteBuffer.h"
+#include "CompositeByteBuffer.h"
+
+namespace net
+{
+    class OutputQueue
+    {
+    public:
+        // 比这个短的字符串和视图拷进内存块，和前后的小消息合成一段；更长的直接持有或者共享
+        static const size_t kCopyThreshold = 4096;
+        static const size_t kNoLimit = static_cast<size_t>(-1);
+        // 一次writev最多带的段数，不超过IOV_MAX
+        static const int kMaxIovecs = 1024;
+        // 等完成通知的零拷贝数据超过这么多时新的数据改用普通发送，通知来不及收时内存不会一直涨
+        static const size_t kMaxZeroCopyPinnedBytes = 64 * 1024 * 1024;
+        static const int kMaxZeroCopyBackoff = 1024;
+
+        OutputQueue();
+
+        size_t readableBytes() const
+        {
+            return m_bytes;
+        }
+
+        bool empty() const
+        {
+            return m_bytes == 0;
+        }
+
+        size_t segmentCount() const;
+
+        void append(const void *data, size_t len);
+        void append(std::string &&str);
+        // 持有buf的内存，不拷贝，buf变成空的
+        void append(ByteBuffer &&buf);
+        // 共享buf的内存块，不拷贝
+        void append(const CompositeByteBuffer &buf);
+        void append(CompositeByteBuffer &&buf);
+        // 发送fd里从offset开始的len字节，fd交给队列，发完、clear()或者队列析构时关闭
+        void appendFile(int fd, int64_t offset, size_t len);
+
+        /// 从队头开始写到sockfd：连续的内存段合成一次writev，队头是文件区间时用一次sendfile
+        /// 写出去的部分从队列里取走，attempted返回这一次尝试写的字节数，小于它说明socket发送缓冲区满了
+        /// maxBytes限制这一次最多写的字节数，流量整形时是令牌桶里现有的量
+        /// @return 写出的字节数，出错返回-1，@c errno is saved
+        ssize_t writeTo(int sockfd, int *savedErrno, size_t *attempted = NULL, size_t maxBytes = kNoLimit);
+
+        // 一次要写的内存数据不少于threshold字节时用MSG_ZEROCOPY发送，0表示不用(默认)
+        // socket要先打开SO_ZEROCOPY，见Socket::setZeroCopy()；只在Linux上有效
+        // 重新设置时清掉内核拷贝数据之后的退避
+        void setZeroCopyThreshold(size_t threshold)
+        {
+            m_zeroCopyThreshold = threshold;
+            m_zeroCopyBackoff = 0;
+            m_zeroCopySkips = 0;
+        }
+
+        size_t zeroCopyThreshold() const
+        {
+            return m_zeroCopyThreshold;
+        }
+
+        // 已经发出、还在等内核完成通知的零拷贝发送次数和字节数
+        size_t zeroCopyPending() const
+        {
+            return m_zeroCopySends.size();
+        }
+
+        size_t zeroCopyPinnedBytes() const
+        {
+            return m_zeroCopyPinnedBytes;
+        }
+
+        // 内核报告数据实际被拷贝了的完成通知次数(比如发往回环地址)
+        // 收到这样的通知之后接下来的若干次改用普通发送，次数按1、2、4…翻倍到kMaxZeroCopyBackoff，
+        // 之后再试零拷贝，内核不再拷贝时退避清零；用户设置的阈值不变
+        int64_t zeroCopyCopied() const
+        {
+            return m_zeroCopyCopied;
+        }
+
+        // 内核正在拷贝零拷贝的数据，现在处于退避中
+        bool zeroCopyBackingOff() const
+        {
+            return m_zeroCopyBackoff > 0;
+        }
+
+        /// 从sockfd的错误队列里读出所有零拷贝完成通知，释放对应发送引用的内存
+        /// @return 这次完成的发送次数
+        int handleZeroCopyCompletions(int sockfd);
+
+        // 丢弃所有还没有发出去的数据；等待零拷贝完成通知的内存还被内核引用着，留到收到通知或者队列析构
+        void clear();
+
+        // 把还在等完成通知的零拷贝发送连同它们引用的内存交给other，
+        // 连接关闭时交给ZeroCopyReaper接着等通知，见TcpConnection的析构函数
+        void moveZeroCopySendsTo(OutputQueue *other);
+
+    private:
+        enum Kind
+        {
+            kBuffer,
+            kBlob,
+            kFile
+        };
+
+        struct Entry
+        {
+            Kind m_kind;
+            CompositeByteBuffer m_buffer; // kBuffer
+            std::shared_ptr<const void> m_owner; // kBlob，持有[m_data, m_data + m_size)所在的string或者ByteBuffer，零拷贝发送时共享
+            const char *m_data;
+            size_t m_size;
+            size_t m_offset;                     // m_offset之前的已经发出去了
+            int m_fd;                     // kFile，从m_fileOffset开始还剩m_length字节
+            int64_t m_fileOffset;
+            size_t m_length;
+
+            explicit Entry(Kind kind) : m_kind(kind), m_data(NULL), m_size(0), m_offset(0), m_fd(-1), m_fileOffset(0), m_length(0) {}
+            Entry(Entry &&rhs) noexcept;
+            ~Entry();
+
+            size_t readableBytes() const;
+
+        private:
+            Entry(const Entry &) = delete;
+            Entry &operator=(const Entry &) = delete;
+        };
+
+        // 一次零拷贝发送引用的数据，内核通知完成之前不能释放
+        struct ZeroCopySend
+        {
+            uint32_t m_id; // 内核按每次成功的零拷贝发送从0开始编号，通知里是编号的范围
+            bool m_done;
+            size_t m_bytes;
+            CompositeByteBuffer m_buffer;
+            std::vector<std::shared_ptr<const void>> m_owners;
+        };
+
+        // 队尾可以继续追加的CompositeByteBuffer，没有时新建一个
+        CompositeByteBuffer &tailBuffer();
+        void appendBlob(std::shared_ptr<const void> owner, const char *data, size_t size);
+        ssize_t writeFile(int sockfd, Entry &entry, int *savedErrno, size_t *attempted, size_t maxBytes);
+        ssize_t writeMemory(int sockfd, int *savedErrno, size_t *attempted, size_t maxBytes);
+        // 从队头取走n字节
+        void consume(size_t n);
+        // 队头的n字节刚用零拷贝发出去，在取走之前记下它们引用的内存
+        void pinZeroCopy(size_t n);
+        // 编号在[lo, hi]之间的零拷贝发送完成了，返回完成的次数
+        int completeZeroCopy(uint32_t lo, uint32_t hi);
+        // 这一次writev要不要带MSG_ZEROCOPY
+        bool useZeroCopy(size_t bytes);
+
+        std::deque<Entry> m_entries;
+        size_t m_bytes;
+
+        size_t m_zeroCopyThreshold;
+        std::deque<ZeroCopySend> m_zeroCopySends;
+        size_t m_zeroCopyPinnedBytes;
+        uint32_t m_zeroCopyNextId;
+        int64_t m_zeroCopyCopied;
+        int m_zeroCopyBackoff;  // 内核拷贝了数据之后要跳过的零拷贝次数，0表示没有退避
+        int m_zeroCopySkips;    // 这一轮退避还要跳过的次数
+    };
+}
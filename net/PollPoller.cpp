@@ -10,6 +10,7 @@
 #ifndef _WIN32
 
 #include "../base/AsyncLog.h"
+#include "../base/Clock.h"
 #include "Channel.h"
 #include "EventLoop.h"
 
@@ -26,12 +27,12 @@ PollPoller::~PollPoller()
 {
 }
 
-Timestamp PollPoller::poll(int timeoutMs, ChannelList *activeChannels)
+int64_t PollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
     // XXX pollfds_ shouldn't change
     int numEvents = ::poll(&*m_pollfds.begin(), m_pollfds.size(), timeoutMs);
     int savedErrno = errno;
-    Timestamp now(Timestamp::now());
+    int64_t now = Clock::monotonicUs();
     if (numEvents > 0)
     {
         LOG_DEBUG("%d  events happended", numEvents);
@@ -59,12 +60,9 @@ void PollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels)
         if (pfd->revents > 0)
         {
             --numEvents;
-            ChannelMap::const_iterator ch = m_channels.find(pfd->fd);
-            if (ch == m_channels.end())
-                continue;
-
-            Channel *channel = ch->second;
-            if (channel->fd() != pfd->fd)
+            // 被忽略的pollfd的fd是负数，find()会返回nullptr
+            Channel *channel = m_channels.find(pfd->fd);
+            if (channel == nullptr)
                 continue;
 
             channel->set_revents(pfd->revents);
@@ -81,7 +79,7 @@ bool PollPoller::updateChannel(Channel *channel)
     {
         // a new one, add to pollfds_
         // assert(channels_.find(channel->fd()) == channels_.end());
-        if (m_channels.find(channel->fd()) != m_channels.end())
+        if (m_channels.add(channel->fd(), channel) == nullptr)
             return false;
 
         struct pollfd pfd;
@@ -91,14 +89,13 @@ bool PollPoller::updateChannel(Channel *channel)
         m_pollfds.push_back(pfd);
         int idx = static_cast<int>(m_pollfds.size()) - 1;
         channel->set_index(idx);
-        m_channels[pfd.fd] = channel;
     }
     else
     {
         // update existing one
         // assert(channels_.find(channel->fd()) != channels_.end());
         // assert(channels_[channel->fd()] == channel);
-        if (m_channels.find(channel->fd()) == m_channels.end() || m_channels[channel->fd()] != channel)
+        if (m_channels.find(channel->fd()) != channel)
             return false;
 
         int idx = channel->index();
@@ -130,7 +127,7 @@ void PollPoller::removeChannel(Channel *channel)
     // assert(channels_[channel->fd()] == channel);
     // assert(channel->isNoneEvent());
 
-    if (m_channels.find(channel->fd()) == m_channels.end() || m_channels[channel->fd()] != channel || !channel->isNoneEvent())
+    if (m_channels.find(channel->fd()) != channel || !channel->isNoneEvent())
         return;
 
     int idx = channel->index();
@@ -143,9 +140,7 @@ void PollPoller::removeChannel(Channel *channel)
     // TODO: 为什么是 -channel->fd()？
     // assert(pfd.fd == -channel->fd() - 1 && pfd.events == channel->events());
 
-    size_t n = m_channels.erase(channel->fd());
-    // assert(n == 1); (void)n;
-    if (n != 1)
+    if (!m_channels.remove(channel->fd()))
         return;
 
     if (size_t(idx) == m_pollfds.size() - 1)
@@ -160,11 +155,17 @@ void PollPoller::removeChannel(Channel *channel)
         {
             channelAtEnd = -channelAtEnd - 1;
         }
-        m_channels[channelAtEnd]->set_index(idx);
+        m_channels.find(channelAtEnd)->set_index(idx);
         m_pollfds.pop_back();
     }
 }
 
+bool PollPoller::hasChannel(Channel *channel) const
+{
+    assertInLoopThread();
+    return m_channels.contains(channel, channel->fd());
+}
+
 void PollPoller::assertInLoopThread() const
 {
     m_ownerLoop->assertInLoopThread();
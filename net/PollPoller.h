@@ -9,9 +9,9 @@
 
 #ifndef _WIN32
 #include "Poller.h"
+#include "ChannelTable.h"
 
 #include <vector>
-#include <map>
 
 struct pollfd;
 
@@ -26,9 +26,10 @@ namespace net
         PollPoller(EventLoop *loop);
         virtual ~PollPoller();
 
-        virtual Timestamp poll(int timeoutMs, ChannelList *activeChannels);
+        virtual int64_t poll(int timeoutMs, ChannelList *activeChannels);
         virtual bool updateChannel(Channel *channel);
         virtual void removeChannel(Channel *channel);
+        virtual bool hasChannel(Channel *channel) const;
 
         void assertInLoopThread() const;
 
@@ -37,9 +38,8 @@ namespace net
 
     private:
         typedef std::vector<struct pollfd> PollFdList;
-        typedef std::map<int, Channel *> ChannelMap;
 
-        ChannelMap m_channels;
+        ChannelTable<> m_channels;
         PollFdList m_pollfds;
         EventLoop *m_ownerLoop;
     };
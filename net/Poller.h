@@ -8,25 +8,45 @@
 #pragma once
 
 #include <vector>
-#include "../base/Timestamp.h"
+#include <stdint.h>
 
 namespace net
 {
     class Channel;
+    class EventLoop;
 
     class Poller
     {
     public:
         Poller();
-        ~Poller();
+        virtual ~Poller();
 
     public:
         typedef std::vector<Channel *> ChannelList;
 
-        virtual Timestamp poll(int timeoutMs, ChannelList *activeChannels) = 0;
+        enum PollerType
+        {
+            kDefault,
+            kSelect,
+            kPoll,
+            kEpoll,
+            kIoUring,
+        };
+
+        // 按照设置的类型创建Poller，环境变量NETTY_CPP_POLLER(select/poll/epoll/io_uring)优先
+        // 当前系统不支持时退回到平台默认的实现(Linux上是epoll，Windows上是select)
+        static Poller *newDefaultPoller(EventLoop *loop);
+        // 之后创建的EventLoop使用的Poller类型，需要在创建EventLoop之前设置
+        static void setDefaultPollerType(PollerType type);
+
+        // 返回poll返回时的单调时钟(Clock::monotonicUs())，EventLoop每轮只用这一次时钟读数
+        virtual int64_t poll(int timeoutMs, ChannelList *activeChannels) = 0;
         virtual bool updateChannel(Channel *channel) = 0;
         virtual void removeChannel(Channel *channel) = 0;
 
         virtual bool hasChannel(Channel *channel) const = 0;
+
+        // 是否支持边缘触发(EPOLLET)，不支持的Poller会忽略EPOLLET标志，按水平触发处理
+        virtual bool supportsEdgeTriggered() const { return false; }
     };
 }
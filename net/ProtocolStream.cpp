@@ -338,6 +338,11 @@ namespace net
     {
         return WriteCString(str.c_str(), str.length());
     }
+    bool BinaryStreamWriter::WriteCStringLength(size_t len)
+    {
+        write7BitEncoded(len, *m_data);
+        return true;
+    }
     const char *BinaryStreamWriter::GetData() const
     {
         return m_data->data();
@@ -399,9 +404,13 @@ namespace net
         return true;
     }
     void BinaryStreamWriter::Flush()
+    {
+        Flush(0);
+    }
+    void BinaryStreamWriter::Flush(size_t externalLength)
     {
         char *ptr = &(*m_data)[0];
-        unsigned int ulen = htonl(m_data->length());
+        unsigned int ulen = htonl(m_data->length() + externalLength);
         memcpy(ptr, &ulen, sizeof(ulen));
     }
     void BinaryStreamWriter::Clear()
@@ -87,6 +87,9 @@ namespace net
         virtual size_t GetSize() const;
         bool WriteCString(const char *str, size_t len);
         bool WriteString(const std::string &str);
+        // 只写字符串的长度，len字节的内容不放进m_data，由调用者紧接着单独发送(比如用sendfile直接发文件内容)
+        // 之后要用Flush(len)把这部分计入总长度
+        bool WriteCStringLength(size_t len);
         bool WriteDouble(double value, bool isNULL = false);
         bool WriteInt64(int64_t value, bool isNULL = false);
         bool WriteInt32(int32_t i, bool isNULL = false);
@@ -94,6 +97,8 @@ namespace net
         bool WriteChar(char c, bool isNULL = false);
         size_t GetCurrentPos() const { return m_data->length(); }
         void Flush();
+        // externalLength是没有放进m_data、随后单独发送的字节数
+        void Flush(size_t externalLength);
         void Clear();
 
     private:
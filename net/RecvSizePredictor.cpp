@@ -0,0 +1,93 @@
+/*
+ *  Filename:   RecvSizePredictor.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:预测连接下一次read能读到多少字节
+ */
+
+#include "RecvSizePredictor.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace net;
+
+namespace
+{
+    const int kIndexIncrement = 4;
+    const int kIndexDecrement = 1;
+
+    std::vector<size_t> makeSizeTable()
+    {
+        std::vector<size_t> table;
+        for (size_t size = 16; size < 512; size += 16)
+            table.push_back(size);
+        // 最大到1GB，再大的读没有意义
+        for (size_t size = 512; size <= (static_cast<size_t>(1) << 30); size <<= 1)
+            table.push_back(size);
+        return table;
+    }
+
+    const std::vector<size_t> &sizeTable()
+    {
+        static const std::vector<size_t> table = makeSizeTable();
+        return table;
+    }
+
+    // 不小于size的第一档
+    int indexOf(size_t size)
+    {
+        const std::vector<size_t> &table = sizeTable();
+        std::vector<size_t>::const_iterator it = std::lower_bound(table.begin(), table.end(), size);
+        if (it == table.end())
+            return static_cast<int>(table.size()) - 1;
+        return static_cast<int>(it - table.begin());
+    }
+}
+
+const size_t RecvSizePredictor::kDefaultMinimum;
+const size_t RecvSizePredictor::kDefaultInitial;
+const size_t RecvSizePredictor::kDefaultMaximum;
+
+RecvSizePredictor::RecvSizePredictor(size_t minimum, size_t initial, size_t maximum)
+{
+    reset(minimum, initial, maximum);
+}
+
+void RecvSizePredictor::reset(size_t minimum, size_t initial, size_t maximum)
+{
+    m_minIndex = indexOf(minimum);
+    m_maxIndex = std::max(indexOf(maximum), m_minIndex);
+    m_index = std::min(std::max(indexOf(initial), m_minIndex), m_maxIndex);
+    m_nextSize = sizeTable()[m_index];
+    m_decreaseNow = false;
+}
+
+void RecvSizePredictor::record(size_t actualBytes)
+{
+    const std::vector<size_t> &table = sizeTable();
+    if (actualBytes <= table[std::max(0, m_index - kIndexDecrement)])
+    {
+        if (m_decreaseNow)
+        {
+            m_index = std::max(m_index - kIndexDecrement, m_minIndex);
+            m_nextSize = table[m_index];
+            m_decreaseNow = false;
+        }
+        else
+        {
+            m_decreaseNow = true;
+        }
+    }
+    else if (actualBytes >= m_nextSize)
+    {
+        recordFull();
+    }
+}
+
+void RecvSizePredictor::recordFull()
+{
+    m_index = std::min(m_index + kIndexIncrement, m_maxIndex);
+    m_nextSize = sizeTable()[m_index];
+    m_decreaseNow = false;
+}
@@ -0,0 +1,50 @@
+/*
+ *  Filename:   RecvSizePredictor.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:预测连接下一次read能读到多少字节，仿照Netty的AdaptiveRecvByteBufAllocator
+ *              大小从一张表里取：512字节以下按16字节递增，再往上按2的幂递增；
+ *              一轮读到的字节数不少于预测值时一次跳4档，连续两轮都比低一档还小时才降1档，
+ *              涨得快降得慢，偶尔一次小包不会让缓冲区立刻缩小
+ *              每个TcpConnection一个，只在所属loop线程里使用
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+namespace net
+{
+    class RecvSizePredictor
+    {
+    public:
+        static const size_t kDefaultMinimum = 64;
+        static const size_t kDefaultInitial = 2048;
+        static const size_t kDefaultMaximum = 64 * 1024;
+
+        RecvSizePredictor(size_t minimum = kDefaultMinimum,
+                          size_t initial = kDefaultInitial,
+                          size_t maximum = kDefaultMaximum);
+
+        // minimum <= initial <= maximum，都会对齐到表里的档位
+        void reset(size_t minimum, size_t initial, size_t maximum);
+
+        // 下一次read应该准备的空间
+        size_t nextSize() const
+        {
+            return m_nextSize;
+        }
+
+        // 一轮读完(读到EAGAIN或者没有读满)后用这一轮的总字节数调整
+        void record(size_t actualBytes);
+        // 一次read把准备的空间读满了，说明socket里还有更多数据，立即调大
+        void recordFull();
+
+    private:
+        int m_minIndex;
+        int m_maxIndex;
+        int m_index;
+        size_t m_nextSize;
+        bool m_decreaseNow;
+    };
+}
@@ -0,0 +1,109 @@
+/*
+ *  Filename:   RingDeque.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:首尾都能O(1)进出的环形数组，容量是2的幂，装满时翻倍，从不缩小
+ *              std::deque在队头出、队尾进交替进行时，每走过一个内部块就要释放一块、再申请一块，
+ *              默认构造也要分配内存；这里默认构造不分配，容量够用之后进出都不再分配内存
+ *              只用于可以按值拷贝的小对象，push_back扩容时元素的引用和迭代器失效
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+namespace net
+{
+    template <typename T>
+    class RingDeque
+    {
+    public:
+        template <typename Ring, typename Value>
+        class Iterator
+        {
+        public:
+            Iterator(Ring *ring, size_t index) : m_ring(ring), m_index(index) {}
+            Value &operator*() const { return (*m_ring)[m_index]; }
+            Value *operator->() const { return &(*m_ring)[m_index]; }
+            Iterator &operator++()
+            {
+                ++m_index;
+                return *this;
+            }
+            bool operator!=(const Iterator &rhs) const { return m_index != rhs.m_index; }
+            bool operator==(const Iterator &rhs) const { return m_index == rhs.m_index; }
+
+        private:
+            Ring *m_ring;
+            size_t m_index;
+        };
+        typedef Iterator<RingDeque, T> iterator;
+        typedef Iterator<const RingDeque, const T> const_iterator;
+
+        RingDeque() : m_head(0), m_size(0) {}
+
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+
+        T &operator[](size_t i) { return m_slots[(m_head + i) & (m_slots.size() - 1)]; }
+        const T &operator[](size_t i) const { return m_slots[(m_head + i) & (m_slots.size() - 1)]; }
+        T &front() { return (*this)[0]; }
+        const T &front() const { return (*this)[0]; }
+        T &back() { return (*this)[m_size - 1]; }
+        const T &back() const { return (*this)[m_size - 1]; }
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, m_size); }
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, m_size); }
+
+        void push_back(const T &value)
+        {
+            if (m_size == m_slots.size())
+                grow();
+            m_slots[(m_head + m_size) & (m_slots.size() - 1)] = value;
+            ++m_size;
+        }
+
+        void pop_front()
+        {
+            m_head = (m_head + 1) & (m_slots.size() - 1);
+            --m_size;
+        }
+
+        // 保留容量
+        void clear()
+        {
+            m_head = 0;
+            m_size = 0;
+        }
+
+        void swap(RingDeque &rhs)
+        {
+            m_slots.swap(rhs.m_slots);
+            std::swap(m_head, rhs.m_head);
+            std::swap(m_size, rhs.m_size);
+        }
+
+    private:
+        void grow()
+        {
+            std::vector<T> slots(m_slots.empty() ? kInitialCapacity : m_slots.size() * 2);
+            for (size_t i = 0; i < m_size; ++i)
+                slots[i] = (*this)[i];
+            m_slots.swap(slots);
+            m_head = 0;
+        }
+
+        static const size_t kInitialCapacity = 8;
+
+        std::vector<T> m_slots;
+        size_t m_head;
+        size_t m_size;
+    };
+
+    template <typename T>
+    const size_t RingDeque<T>::kInitialCapacity;
+}
@@ -12,6 +12,7 @@
 
 #include "../base/Platform.h"
 #include "../base/AsyncLog.h"
+#include "../base/Clock.h"
 #include "EventLoop.h"
 #include "Channel.h"
 
@@ -44,7 +45,7 @@ void SelectPoller::assertInLoopThread() const
     m_ownerLoop->assertInLoopThread();
 }
 
-Timestamp SelectPoller::poll(int timeoutMs, ChannelList *activeChannels)
+int64_t SelectPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
     fd_set readfds, writefds;
     FD_ZERO(&readfds);
@@ -71,7 +72,7 @@ Timestamp SelectPoller::poll(int timeoutMs, ChannelList *activeChannels)
     timeout.tv_sec = timeoutMs / 1000;
     timeout.tv_usec = (timeoutMs - timeoutMs / 1000 * 1000) * 1000;
     int numEvents = select(maxfd + 1, &readfds, &writefds, NULL, &timeout);
-    Timestamp now(Timestamp::now());
+    int64_t now = Clock::monotonicUs();
     if (numEvents > 0)
     {
         fillActiveChannels(numEvents, activeChannels, readfds, writefds);
@@ -22,7 +22,7 @@ namespace net
         SelectPoller(EventLoop *loop);
         virtual ~SelectPoller();
 
-        virtual Timestamp poll(int timeoutMs, ChannelList *activeChannels);
+        virtual int64_t poll(int timeoutMs, ChannelList *activeChannels);
         virtual bool updateChannel(Channel *channel);
         virtual void removeChannel(Channel *channel);
         virtual bool hasChannel(Channel *channel) const;
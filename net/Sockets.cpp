@@ -61,6 +61,16 @@ void Socket::setTcpNoDelay(bool on)
     // FIXME CHECK
 }
 
+void Socket::setTcpCork(bool on)
+{
+#if !defined(WIN32) && defined(TCP_CORK)
+    int optval = on ? 1 : 0;
+    ::setsockopt(m_sockfd, IPPROTO_TCP, TCP_CORK, &optval, static_cast<socklen_t>(sizeof optval));
+#else
+    (void)on;
+#endif
+}
+
 void Socket::setReuseAddr(bool on)
 {
     sockets::setReuseAddr(m_sockfd, on);
@@ -82,6 +92,38 @@ void Socket::setKeepAlive(bool on)
     // FIXME CHECK
 }
 
+bool Socket::setBusyPoll(int usec)
+{
+#if !defined(WIN32) && defined(SO_BUSY_POLL)
+    int optval = usec;
+    if (::setsockopt(m_sockfd, SOL_SOCKET, SO_BUSY_POLL, &optval, static_cast<socklen_t>(sizeof optval)) < 0)
+    {
+        LOGSYSE("Socket::setBusyPoll, fd = %d, usec = %d", m_sockfd, usec);
+        return false;
+    }
+    return true;
+#else
+    (void)usec;
+    return false;
+#endif
+}
+
+bool Socket::setZeroCopy(bool on)
+{
+#if !defined(WIN32) && defined(SO_ZEROCOPY)
+    int optval = on ? 1 : 0;
+    if (::setsockopt(m_sockfd, SOL_SOCKET, SO_ZEROCOPY, &optval, static_cast<socklen_t>(sizeof optval)) < 0)
+    {
+        LOGSYSE("Socket::setZeroCopy, fd = %d, on = %d", m_sockfd, on);
+        return false;
+    }
+    return true;
+#else
+    (void)on;
+    return false;
+#endif
+}
+
 // namespace
 //{
 //   //typedef struct sockaddr SA;
@@ -208,7 +250,9 @@ SOCKET sockets::accept(SOCKET sockfd, struct sockaddr_in *addr)
             LOGF("unexpected error of ::accept %d", savedErrno);
 #else
         int savedErrno = errno;
-        LOGSYSE("Socket::accept");
+        // 边缘触发模式下每次都要accept到EAGAIN为止，这种情况不记日志
+        if (savedErrno != EAGAIN)
+            LOGSYSE("Socket::accept");
         switch (savedErrno)
         {
         case EAGAIN:
@@ -285,6 +329,11 @@ ssize_t sockets::readv(SOCKET sockfd, const struct iovec *iov, int iovcnt)
 {
     return ::readv(sockfd, iov, iovcnt);
 }
+
+ssize_t sockets::writev(SOCKET sockfd, const struct iovec *iov, int iovcnt)
+{
+    return ::writev(sockfd, iov, iovcnt);
+}
 #endif
 
 int32_t sockets::write(SOCKET sockfd, const void *buf, int32_t count)
@@ -32,9 +32,16 @@ namespace net
 
         void shutdownWrite();
         void setTcpNoDelay(bool on);
+        // TCP_CORK：打开期间不足一个MSS的数据先不发，关闭时一起发出去，只有Linux支持
+        void setTcpCork(bool on);
         void setReuseAddr(bool on);
         void setReusePort(bool on);
         void setKeepAlive(bool on);
+        // 设置SO_BUSY_POLL，读这个socket时没有数据就在网卡队列上忙等usec微秒，只有Linux支持
+        // 超过net.core.busy_read的值需要CAP_NET_ADMIN权限
+        bool setBusyPoll(int usec);
+        // 打开SO_ZEROCOPY，之后带MSG_ZEROCOPY的send不再把数据拷进内核，只有Linux 4.14以上的TCP socket支持
+        bool setZeroCopy(bool on);
 
     private:
         const SOCKET m_sockfd;
@@ -57,6 +64,7 @@ namespace net
         int32_t read(SOCKET sockfd, void *buf, int32_t count);
 #ifndef WIN32
         ssize_t readv(SOCKET sockfd, const struct iovec *iov, int iovcnt);
+        ssize_t writev(SOCKET sockfd, const struct iovec *iov, int iovcnt);
 #endif
         int32_t write(SOCKET sockfd, const void *buf, int32_t count);
         void close(SOCKET sockfd);
@@ -57,6 +57,7 @@ TcpClient::TcpClient(EventLoop* loop,
     m_messageCallback(defaultMessageCallback),
     m_retry(false),
     m_connect(true),
+    m_edgeTriggered(false),
     m_nextConnId(1)
 {
     m_connector->setNewConnectionCallback(
@@ -141,6 +142,7 @@ void TcpClient::newConnection(int sockfd)
     conn->setMessageCallback(m_messageCallback);
     conn->setWriteCompleteCallback(m_writeCompleteCallback);
     conn->setCloseCallback(std::bind(&TcpClient::removeConnection, this, std::placeholders::_1)); // FIXME: unsafe
+    conn->setEdgeTriggered(m_edgeTriggered);
 
     {
         std::unique_lock<std::mutex> lock(m_mutex);
@@ -35,6 +35,8 @@ namespace net
 
         EventLoop *getLoop() const { return m_loop; }
         void enableRetry() { m_retry = true; }
+        // 新建立的连接使用边缘触发模式，需要在connect()之前设置
+        void setEdgeTriggered(bool on) { m_edgeTriggered = on; }
 
         const std::string &name() const
         {
@@ -69,6 +71,7 @@ namespace net
         WriteCompleteCallback m_writeCompleteCallback;
         bool m_retry;
         bool m_connect;
+        bool m_edgeTriggered;
 
         int m_nextConnId;
         mutable std::mutex m_mutex;
@@ -8,6 +8,7 @@
 #include "TcpConnection.h"
 
 #include <functional>
+#include <algorithm>
 #include <thread>
 #include <sstream>
 #include <errno.h>
@@ -16,9 +17,29 @@
 #include "Sockets.h"
 #include "EventLoop.h"
 #include "Channel.h"
+#include "ZeroCopyReaper.h"
 
 using namespace net;
 
+namespace
+{
+    // 每次事件最多调用read/write的次数，避免一个数据量很大的连接长时间占住loop；
+    // 边缘触发模式下超出后投递到任务队列里继续，水平触发模式下等下一次事件
+    const int kMaxReadsPerRound = 16;
+    const int kMaxWritesPerRound = 16;
+
+    // 全局输出上限和统计，所有loop线程共用
+    std::atomic<size_t> g_outputHighBytes(0);
+    std::atomic<size_t> g_outputLowBytes(0);
+    std::atomic<int64_t> g_outputBytes(0);
+    std::atomic<int64_t> g_readPausedUs(0);
+
+    // 所有连接共用的流量整形
+    TrafficShaper g_trafficShaper;
+    // 流量整形暂停读写的最短时间，欠账很少时不值得设一次定时器
+    const int64_t kMinShapingDelayUs = 1000;
+}
+
 void net::defaultConnectionCallback(const TcpConnectionPtr &conn)
 {
     LOGD("%s -> is %s",
@@ -41,14 +62,39 @@ TcpConnection::TcpConnection(EventLoop *loop, const string &nameArg, int sockfd,
       m_channel(new Channel(loop, sockfd)),
       m_localAddr(localAddr),
       m_peerAddr(peerAddr),
-      m_highWaterMark(64 * 1024 * 1024)
+      m_highWaterMark(64 * 1024 * 1024),
+      m_drainQueued(false),
+      m_zeroCopy(false),
+      m_autoCork(false),
+      m_tcpCork(false),
+      m_flushQueued(false),
+      m_corkedSends(0),
+      m_corkFlushes(0),
+      m_flowHighMark(0),
+      m_flowLowMark(0),
+      m_accountedBytes(0),
+      m_pausingSources(false),
+      m_readPauses(0),
+      m_readPauseStartUs(0),
+      m_readPausedUs(0),
+      m_readPauseCount(0),
+      m_readThrottled(false),
+      m_writeThrottled(false),
+      m_lastReadUs(0),
+      m_lastWriteUs(0),
+      m_timeoutTimerUs(0)
 {
+    for (int i = 0; i < kConnectionTimeoutTypes; ++i)
+        m_timeoutUs[i] = 0;
+
     m_channel->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
     m_channel->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
     m_channel->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
     m_channel->setErrorCallback(std::bind(&TcpConnection::handleError, this));
     LOGD("TcpConnection::ctor[%s] at 0x%x fd=%d", m_name.c_str(), this, sockfd);
     m_socket->setKeepAlive(true);
+    // 在accept线程里构造，连接数立刻计入，下一个新连接选择loop时就能看到
+    m_loop->addConnection(1);
 }
 
 TcpConnection::~TcpConnection()
@@ -56,6 +102,31 @@ TcpConnection::~TcpConnection()
     LOGD("TcpConnection::dtor[%s] at 0x%x fd=%d state=%s",
          m_name.c_str(), this, m_channel->fd(), stateToString());
     // assert(state_ == kDisconnected);
+    // 投递的任务持有连接，走到这里时发送队列里一般已经没有数据了，有的话直接丢弃
+    while (PendingSend *pending = m_pendingSends.pop())
+    {
+        if (pending->m_fd >= 0)
+            ::close(pending->m_fd);
+        delete pending;
+    }
+    // 连接没有经过handleClose()/connectDestroyed()就析构时，在这里退还计数、恢复上游的读
+    g_outputBytes.fetch_sub(static_cast<int64_t>(m_accountedBytes), std::memory_order_relaxed);
+    for (const std::weak_ptr<TcpConnection> &source : m_pausedSources)
+    {
+        TcpConnectionPtr conn = source.lock();
+        if (conn)
+            conn->resumeReading();
+    }
+    // 内核可能还在从零拷贝的内存页发数据：先收掉已经到达的完成通知，还有没到的就把socket dup一份，
+    // 连同这些内存交给loop的ZeroCopyReaper接着等，这里照常关闭自己的fd
+    if (m_zeroCopy)
+    {
+        m_outputQueue.handleZeroCopyCompletions(m_socket->fd());
+        if (m_outputQueue.zeroCopyPending() > 0)
+            handOverZeroCopySends();
+        m_socket.reset();
+    }
+    m_loop->addConnection(-1);
 }
 
 void TcpConnection::send(const void *data, int len)
@@ -68,11 +139,10 @@ void TcpConnection::send(const void *data, int len)
         }
         else
         {
-            string message(static_cast<const char *>(data), len);
-            m_loop->runInLoop(
-                std::bind(static_cast<void (TcpConnection::*)(const string &)>(&TcpConnection::sendInLoop),
-                          this, // FIXME
-                          message));
+            // 只在这里拷贝一次，之后移动进发送队列
+            PendingSend *pending = new PendingSend(PendingSend::kString);
+            pending->m_string.assign(static_cast<const char *>(data), len);
+            queueSend(pending);
         }
     }
 }
@@ -87,36 +157,163 @@ void TcpConnection::send(const string &message)
         }
         else
         {
-            m_loop->runInLoop(
-                std::bind(static_cast<void (TcpConnection::*)(const string &)>(&TcpConnection::sendInLoop),
-                          this, // FIXME
-                          message));
-            // std::forward<string>(message)));
+            PendingSend *pending = new PendingSend(PendingSend::kString);
+            pending->m_string = message;
+            queueSend(pending);
+        }
+    }
+}
+
+void TcpConnection::send(string &&message)
+{
+    if (m_state == kConnected)
+    {
+        if (m_loop->isInLoopThread())
+        {
+            size_t oldLen = m_outputQueue.readableBytes();
+            m_outputQueue.append(std::move(message));
+            writeQueued(oldLen);
+        }
+        else
+        {
+            PendingSend *pending = new PendingSend(PendingSend::kString);
+            pending->m_string.swap(message);
+            queueSend(pending);
+        }
+    }
+}
+
+void TcpConnection::send(ByteBuffer &&buf)
+{
+    if (m_state == kConnected)
+    {
+        if (m_loop->isInLoopThread())
+        {
+            size_t oldLen = m_outputQueue.readableBytes();
+            m_outputQueue.append(std::move(buf));
+            writeQueued(oldLen);
+        }
+        else
+        {
+            PendingSend *pending = new PendingSend(PendingSend::kByteBuffer);
+            pending->m_byteBuffer.swap(buf);
+            queueSend(pending);
+        }
+    }
+}
+
+void TcpConnection::send(const CompositeByteBuffer &buf)
+{
+    if (m_state == kConnected)
+    {
+        if (m_loop->isInLoopThread())
+        {
+            sendBufferInLoop(buf);
+        }
+        else
+        {
+            // 复制的只是视图，内存块的引用计数是原子的，可以交给loop线程
+            PendingSend *pending = new PendingSend(PendingSend::kBuffer);
+            pending->m_buffer.reset(new CompositeByteBuffer(buf));
+            queueSend(pending);
+        }
+    }
+}
+
+void TcpConnection::send(CompositeByteBuffer &&buf)
+{
+    if (m_state == kConnected)
+    {
+        if (m_loop->isInLoopThread())
+        {
+            size_t oldLen = m_outputQueue.readableBytes();
+            m_outputQueue.append(std::move(buf));
+            writeQueued(oldLen);
+        }
+        else
+        {
+            PendingSend *pending = new PendingSend(PendingSend::kBuffer);
+            pending->m_buffer.reset(new CompositeByteBuffer(std::move(buf)));
+            queueSend(pending);
         }
     }
 }
 
-// FIXME efficiency!!!
 void TcpConnection::send(ByteBuffer *buf)
 {
     if (m_state == kConnected)
     {
         if (m_loop->isInLoopThread())
         {
+            // loop线程里直接写，写不完的才拷进输出队列
             sendInLoop(buf->peek(), buf->readableBytes());
             buf->retrieveAll();
         }
         else
         {
-            m_loop->runInLoop(
-                std::bind(static_cast<void (TcpConnection::*)(const string &)>(&TcpConnection::sendInLoop),
-                          this, // FIXME
-                          buf->retrieveAllAsString()));
-            // std::forward<string>(message)));
+            // 交换出buf的内存交给loop线程，buf变成空的
+            ByteBuffer message;
+            message.swap(*buf);
+            send(std::move(message));
         }
     }
 }
 
+void TcpConnection::queueSend(PendingSend *pending)
+{
+    m_pendingSends.push(pending);
+    // drainPendingSends()开始执行时先清掉标志再取数据，标志还在说明这次放进去的数据一定会被它取到
+    if (!m_drainQueued.exchange(true, std::memory_order_acq_rel))
+        m_loop->queueInLoop(std::bind(&TcpConnection::drainPendingSends, shared_from_this()));
+}
+
+void TcpConnection::drainPendingSends()
+{
+    m_loop->assertInLoopThread();
+    m_drainQueued.exchange(false, std::memory_order_acq_rel);
+
+    size_t oldLen = m_outputQueue.readableBytes();
+    bool disconnected = m_state == kDisconnected;
+    int count = 0;
+    while (PendingSend *pending = m_pendingSends.pop())
+    {
+        if (!disconnected)
+        {
+            switch (pending->m_kind)
+            {
+            case PendingSend::kString:
+                m_outputQueue.append(std::move(pending->m_string));
+                break;
+            case PendingSend::kByteBuffer:
+                m_outputQueue.append(std::move(pending->m_byteBuffer));
+                break;
+            case PendingSend::kBuffer:
+                m_outputQueue.append(std::move(*pending->m_buffer));
+                break;
+            case PendingSend::kFile:
+                m_outputQueue.appendFile(pending->m_fd, pending->m_fileOffset, pending->m_length);
+                pending->m_fd = -1;
+                break;
+            }
+        }
+        else if (pending->m_fd >= 0)
+        {
+            ::close(pending->m_fd);
+        }
+        delete pending;
+        ++count;
+    }
+
+    if (disconnected)
+    {
+        if (count > 0)
+            LOGW("disconnected, give up writing");
+        return;
+    }
+    // 攒下来的所有数据一起写，小消息合成一次writev
+    writeQueued(oldLen);
+}
+
 void TcpConnection::sendInLoop(const string &message)
 {
     sendInLoop(message.c_str(), message.size());
@@ -133,8 +330,17 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
         LOGW("disconnected, give up writing");
         return;
     }
+    // 限速时不能绕过输出队列直接写
+    if (m_autoCork || shapingWrites())
+    {
+        size_t oldLen = m_outputQueue.readableBytes();
+        m_outputQueue.append(data, len);
+        writeQueued(oldLen);
+        return;
+    }
     // if no thing in output queue, try writing directly
-    if (!m_channel->isWriting() && m_outputBuffer.readableBytes() == 0)
+    // 边缘触发模式下写事件一直是注册着的，所以只看输出队列是否为空
+    if (m_outputQueue.empty())
     {
         nwrote = sockets::write(m_channel->fd(), data, len);
         // TODO: 打印threadid用于调试，后面去掉
@@ -144,10 +350,12 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
 
         if (nwrote >= 0)
         {
+            m_loop->addBytesTransferred(nwrote);
+            m_lastWriteUs = m_loop->loopNow();
             remaining = len - nwrote;
             if (remaining == 0 && m_writeCompleteCallback)
             {
-                m_loop->queueInLoop(std::bind(m_writeCompleteCallback, shared_from_this()));
+                m_loop->queueInLoop(std::bind(&TcpConnection::writeCompleteInLoop, shared_from_this()));
             }
         }
         else // nwrote < 0
@@ -170,17 +378,240 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
 
     if (!faultError && remaining > 0)
     {
-        size_t oldLen = m_outputBuffer.readableBytes();
-        if (oldLen + remaining >= m_highWaterMark && oldLen < m_highWaterMark && m_highWaterMarkCallback)
+        size_t oldLen = m_outputQueue.readableBytes();
+        m_outputQueue.append(static_cast<const char *>(data) + nwrote, remaining);
+        outputQueued(oldLen);
+    }
+}
+
+void TcpConnection::sendBufferInLoop(const CompositeByteBuffer &buf)
+{
+    m_loop->assertInLoopThread();
+    if (m_state == kDisconnected)
+    {
+        LOGW("disconnected, give up writing");
+        return;
+    }
+
+    size_t oldLen = m_outputQueue.readableBytes();
+    m_outputQueue.append(buf);
+    writeQueued(oldLen);
+}
+
+void TcpConnection::sendFile(int fd, int64_t offset, size_t len)
+{
+    if (m_state != kConnected)
+        return;
+
+    int dupfd = ::dup(fd);
+    if (dupfd < 0)
+    {
+        LOGSYSE("TcpConnection::sendFile dup");
+        return;
+    }
+
+    if (m_loop->isInLoopThread())
+    {
+        sendFileInLoop(dupfd, offset, len);
+    }
+    else
+    {
+        // 和其他线程里的send走同一个发送队列，保证先后顺序
+        PendingSend *pending = new PendingSend(PendingSend::kFile);
+        pending->m_fd = dupfd;
+        pending->m_fileOffset = offset;
+        pending->m_length = len;
+        queueSend(pending);
+    }
+}
+
+void TcpConnection::sendFileInLoop(int fd, int64_t offset, size_t len)
+{
+    m_loop->assertInLoopThread();
+    if (m_state == kDisconnected)
+    {
+        LOGW("disconnected, give up sending file");
+        ::close(fd);
+        return;
+    }
+
+    size_t oldLen = m_outputQueue.readableBytes();
+    m_outputQueue.appendFile(fd, offset, len);
+    writeQueued(oldLen);
+}
+
+void TcpConnection::writeQueued(size_t oldLen)
+{
+    // 本轮已经有数据等着合并写，或者队列原来是空的(原本会直接写一次)，都推迟到本轮结束
+    if (m_autoCork && (oldLen == 0 || m_flushQueued))
+    {
+        ++m_corkedSends;
+        if (!m_flushQueued)
         {
-            m_loop->queueInLoop(std::bind(m_highWaterMarkCallback, shared_from_this(), oldLen + remaining));
+            m_flushQueued = true;
+            m_loop->queueAtIterationEnd(std::bind(&TcpConnection::flushInLoop, shared_from_this()));
         }
-        m_outputBuffer.append(static_cast<const char *>(data) + nwrote, remaining);
-        if (!m_channel->isWriting())
+        return;
+    }
+
+    if (oldLen == 0)
+    {
+        // 队列原来是空的，直接写一次(writev或者sendfile)，发不完的留在队列里
+        int savedErrno = 0;
+        ssize_t n = writeOutput(&savedErrno);
+        if (n >= 0)
         {
-            m_channel->enableWriting();
+            m_loop->addBytesTransferred(n);
+            m_lastWriteUs = m_loop->loopNow();
+            if (m_outputQueue.empty() && m_writeCompleteCallback)
+                m_loop->queueInLoop(std::bind(&TcpConnection::writeCompleteInLoop, shared_from_this()));
+        }
+        else if (savedErrno != EWOULDBLOCK)
+        {
+            errno = savedErrno;
+            LOGSYSE("TcpConnection::sendInLoop");
+            if (savedErrno == EPIPE || savedErrno == ECONNRESET)
+            {
+                m_outputQueue.clear();
+                return;
+            }
         }
     }
+
+    if (!m_outputQueue.empty())
+        outputQueued(oldLen);
+    else
+        updateFlowControl();
+}
+
+void TcpConnection::flush()
+{
+    if (m_loop->isInLoopThread())
+        flushInLoop();
+    else
+        m_loop->runInLoop(std::bind(&TcpConnection::flushInLoop, shared_from_this()));
+}
+
+void TcpConnection::flushInLoop()
+{
+    m_loop->assertInLoopThread();
+    m_flushQueued = false;
+    if (m_state == kDisconnected || m_outputQueue.empty())
+        return;
+
+    ++m_corkFlushes;
+    if (m_tcpCork)
+        m_socket->setTcpCork(true);
+    // 内存段和文件区间要分几次写，一直写到发送缓冲区满或者写完
+    ssize_t total = 0;
+    while (!m_outputQueue.empty())
+    {
+        int savedErrno = 0;
+        size_t attempted = 0;
+        ssize_t n = writeOutput(&savedErrno, &attempted);
+        if (n > 0)
+        {
+            total += n;
+            if (static_cast<size_t>(n) < attempted)
+                break;
+        }
+        else
+        {
+            if (n < 0 && savedErrno != EWOULDBLOCK && savedErrno != EINTR)
+            {
+                errno = savedErrno;
+                LOGSYSE("TcpConnection::flushInLoop");
+                if (savedErrno == EPIPE || savedErrno == ECONNRESET)
+                    m_outputQueue.clear();
+            }
+            break;
+        }
+    }
+    if (m_tcpCork)
+        m_socket->setTcpCork(false);
+
+    if (total > 0)
+    {
+        m_loop->addBytesTransferred(total);
+        m_lastWriteUs = m_loop->loopNow();
+    }
+
+    if (m_outputQueue.empty())
+    {
+        if (m_channel->isWriting() && !m_channel->isEdgeTriggered())
+            m_channel->disableWriting();
+        if (total > 0 && m_writeCompleteCallback)
+            m_loop->queueInLoop(std::bind(&TcpConnection::writeCompleteInLoop, shared_from_this()));
+        if (m_state == kDisconnecting)
+            shutdownInLoop();
+        updateFlowControl();
+    }
+    else
+    {
+        // 攒下的数据这时才算进入输出队列，检查高水位，开始计写超时
+        outputQueued(0);
+    }
+}
+
+void TcpConnection::outputQueued(size_t oldLen)
+{
+    size_t newLen = m_outputQueue.readableBytes();
+    if (newLen >= m_highWaterMark && oldLen < m_highWaterMark && m_highWaterMarkCallback)
+    {
+        m_loop->queueInLoop(std::bind(m_highWaterMarkCallback, shared_from_this(), newLen));
+    }
+    if (oldLen == 0)
+    {
+        // 输出队列从空变成非空，写超时从这里开始计时
+        m_lastWriteUs = m_loop->loopNow();
+        if (m_timeoutUs[kWriteTimeout] > 0)
+            scheduleTimeout();
+    }
+    // 边缘触发模式下第一次需要时才注册写事件，之后一直保持；限速暂停写时由定时器接着写
+    if (!m_channel->isWriting() && !m_writeThrottled)
+    {
+        m_channel->enableWriting();
+    }
+    updateFlowControl();
+}
+
+void TcpConnection::watchZeroCopyCompletions()
+{
+    if (m_state == kDisconnected)
+        return;
+    bool pending = m_outputQueue.zeroCopyPending() > 0;
+    if (pending && !m_channel->isWatchingErrors())
+        m_channel->enableErrors();
+    else if (!pending && m_channel->isWatchingErrors())
+        m_channel->disableErrors();
+}
+
+void TcpConnection::handOverZeroCopySends()
+{
+#ifndef _WIN32
+    int fd = ::dup(m_socket->fd());
+    if (fd < 0)
+    {
+        // 宁可泄漏也不能把内核还在用的内存还给BufferPool
+        LOGSYSE("TcpConnection::handOverZeroCopySends [%s] dup error, leak %d bytes",
+                m_name.c_str(), static_cast<int>(m_outputQueue.zeroCopyPinnedBytes()));
+        m_outputQueue.moveZeroCopySendsTo(new OutputQueue);
+        return;
+    }
+    std::unique_ptr<OutputQueue> pins(new OutputQueue);
+    m_outputQueue.moveZeroCopySendsTo(pins.get());
+    // 析构函数不一定在loop线程里执行
+    EventLoop *loop = m_loop;
+    m_loop->runInLoop([loop, fd, pins = std::move(pins)]() mutable
+                      { loop->zeroCopyReaper()->adopt(fd, std::move(pins)); });
+#endif
+}
+
+void TcpConnection::writeCompleteInLoop()
+{
+    // 执行时再取回调，投递的任务里只捕获shared_ptr，不用拷贝一份std::function
+    if (m_writeCompleteCallback)
+        m_writeCompleteCallback(shared_from_this());
 }
 
 void TcpConnection::shutdown()
@@ -197,7 +628,7 @@ void TcpConnection::shutdown()
 void TcpConnection::shutdownInLoop()
 {
     m_loop->assertInLoopThread();
-    if (!m_channel->isWriting())
+    if (m_outputQueue.empty())
     {
         // we are not writing
         m_socket->shutdownWrite();
@@ -246,6 +677,333 @@ void TcpConnection::setTcpNoDelay(bool on)
     m_socket->setTcpNoDelay(on);
 }
 
+void TcpConnection::setReceiveSizeRange(size_t minimum, size_t initial, size_t maximum)
+{
+    m_recvPredictor.reset(minimum, initial, maximum);
+}
+
+bool TcpConnection::setZeroCopyThreshold(size_t threshold)
+{
+    // 已经打开过SO_ZEROCOPY时只改阈值，关闭时socket选项留着，不带MSG_ZEROCOPY的发送不受影响
+    if (threshold > 0 && !m_zeroCopy)
+    {
+        if (!m_socket->setZeroCopy(true))
+            return false;
+        m_zeroCopy = true;
+    }
+    m_outputQueue.setZeroCopyThreshold(threshold);
+    return true;
+}
+
+void TcpConnection::setFlowControl(size_t highMark, size_t lowMark)
+{
+    m_flowHighMark = highMark;
+    m_flowLowMark = std::min(lowMark, highMark);
+    updateFlowControl();
+}
+
+void TcpConnection::linkUpstream(const TcpConnectionPtr &upstream)
+{
+    m_upstreams.erase(std::remove_if(m_upstreams.begin(), m_upstreams.end(),
+                                     [](const std::weak_ptr<TcpConnection> &conn)
+                                     { return conn.expired(); }),
+                      m_upstreams.end());
+    m_upstreams.push_back(upstream);
+}
+
+void TcpConnection::setGlobalOutputLimit(size_t highBytes, size_t lowBytes)
+{
+    g_outputLowBytes.store(std::min(lowBytes, highBytes), std::memory_order_relaxed);
+    g_outputHighBytes.store(highBytes, std::memory_order_relaxed);
+}
+
+int64_t TcpConnection::globalOutputBytes()
+{
+    return g_outputBytes.load(std::memory_order_relaxed);
+}
+
+int64_t TcpConnection::globalReadPausedUs()
+{
+    return g_readPausedUs.load(std::memory_order_relaxed);
+}
+
+void TcpConnection::pauseReading()
+{
+    if (m_loop->isInLoopThread())
+        pauseReadingInLoop();
+    else
+        m_loop->runInLoop(std::bind(&TcpConnection::pauseReadingInLoop, shared_from_this()));
+}
+
+void TcpConnection::resumeReading()
+{
+    if (m_loop->isInLoopThread())
+        resumeReadingInLoop();
+    else
+        m_loop->runInLoop(std::bind(&TcpConnection::resumeReadingInLoop, shared_from_this()));
+}
+
+void TcpConnection::pauseReadingInLoop()
+{
+    m_loop->assertInLoopThread();
+    if (m_readPauses++ > 0)
+        return;
+
+    m_readPauseStartUs = m_loop->loopNow();
+    ++m_readPauseCount;
+    if (m_state == kConnected || m_state == kDisconnecting)
+        m_channel->disableReading();
+}
+
+void TcpConnection::resumeReadingInLoop()
+{
+    m_loop->assertInLoopThread();
+    if (m_readPauses == 0 || --m_readPauses > 0)
+        return;
+
+    int64_t pausedUs = m_loop->loopNow() - m_readPauseStartUs;
+    m_readPausedUs += pausedUs;
+    g_readPausedUs.fetch_add(pausedUs, std::memory_order_relaxed);
+    if (m_state == kConnected || m_state == kDisconnecting)
+        m_channel->enableReading();
+}
+
+int64_t TcpConnection::readPausedUs() const
+{
+    if (m_readPauses > 0)
+        return m_readPausedUs + m_loop->loopNow() - m_readPauseStartUs;
+    return m_readPausedUs;
+}
+
+void TcpConnection::updateFlowControl()
+{
+    size_t globalHigh = g_outputHighBytes.load(std::memory_order_relaxed);
+    // 没有开流量控制的连接只比较几个成员，不碰全局的原子变量
+    if (m_flowHighMark == 0 && globalHigh == 0 && m_accountedBytes == 0 && !m_pausingSources)
+        return;
+
+    size_t bytes = m_state == kDisconnected ? 0 : m_outputQueue.readableBytes();
+    int64_t delta = static_cast<int64_t>(bytes) - static_cast<int64_t>(m_accountedBytes);
+    int64_t total = g_outputBytes.fetch_add(delta, std::memory_order_relaxed) + delta;
+    m_accountedBytes = bytes;
+
+    if (!m_pausingSources)
+    {
+        // 全局超限时只暂停自己有积压的连接
+        bool over = bytes > 0 &&
+                    ((m_flowHighMark > 0 && bytes >= m_flowHighMark) ||
+                     (globalHigh > 0 && total >= static_cast<int64_t>(globalHigh)));
+        if (over)
+            pauseSources();
+    }
+    else
+    {
+        size_t globalLow = g_outputLowBytes.load(std::memory_order_relaxed);
+        bool under = bytes == 0 ||
+                     ((m_flowHighMark == 0 || bytes <= m_flowLowMark) &&
+                      (globalHigh == 0 || total <= static_cast<int64_t>(globalLow)));
+        if (under)
+            resumeSources();
+    }
+}
+
+void TcpConnection::pauseSources()
+{
+    m_pausingSources = true;
+    if (m_upstreams.empty())
+        m_pausedSources.push_back(shared_from_this());
+    else
+        m_pausedSources = m_upstreams;
+
+    for (const std::weak_ptr<TcpConnection> &source : m_pausedSources)
+    {
+        TcpConnectionPtr conn = source.lock();
+        if (conn)
+            conn->pauseReading();
+    }
+}
+
+void TcpConnection::resumeSources()
+{
+    m_pausingSources = false;
+    // 恢复的是暂停时记下的那些连接，中间新登记的上游没有被暂停过
+    std::vector<std::weak_ptr<TcpConnection>> sources;
+    sources.swap(m_pausedSources);
+    for (const std::weak_ptr<TcpConnection> &source : sources)
+    {
+        TcpConnectionPtr conn = source.lock();
+        if (conn)
+            conn->resumeReading();
+    }
+}
+
+void TcpConnection::setTrafficShaping(int64_t readBytesPerSecond, int64_t writeBytesPerSecond)
+{
+    m_shaper.setRates(readBytesPerSecond, writeBytesPerSecond);
+}
+
+void TcpConnection::setSharedTrafficShaper(const std::shared_ptr<TrafficShaper> &shaper)
+{
+    m_sharedShaper = shaper;
+}
+
+void TcpConnection::setGlobalTrafficShaping(int64_t readBytesPerSecond, int64_t writeBytesPerSecond)
+{
+    g_trafficShaper.setRates(readBytesPerSecond, writeBytesPerSecond);
+}
+
+const TrafficShaper &TcpConnection::globalTrafficShaper()
+{
+    return g_trafficShaper;
+}
+
+int TcpConnection::activeShapers(TrafficShaper *shapers[3], bool reads)
+{
+    // 不限速的整形器只读一个原子变量
+    int count = 0;
+    if (reads ? m_shaper.shapingReads() : m_shaper.shapingWrites())
+        shapers[count++] = &m_shaper;
+    if (m_sharedShaper && (reads ? m_sharedShaper->shapingReads() : m_sharedShaper->shapingWrites()))
+        shapers[count++] = m_sharedShaper.get();
+    if (reads ? g_trafficShaper.shapingReads() : g_trafficShaper.shapingWrites())
+        shapers[count++] = &g_trafficShaper;
+    return count;
+}
+
+bool TcpConnection::shapingWrites()
+{
+    TrafficShaper *shapers[3];
+    return activeShapers(shapers, false) > 0;
+}
+
+ssize_t TcpConnection::writeOutput(int *savedErrno, size_t *attempted)
+{
+    TrafficShaper *shapers[3];
+    int count = activeShapers(shapers, false);
+    if (count == 0)
+    {
+        ssize_t n = m_outputQueue.writeTo(m_channel->fd(), savedErrno, attempted);
+        if (m_zeroCopy)
+            watchZeroCopyCompletions();
+        return n;
+    }
+
+    size_t ignored = 0;
+    if (attempted == NULL)
+        attempted = &ignored;
+    *attempted = 0;
+    if (m_writeThrottled)
+    {
+        *savedErrno = EWOULDBLOCK;
+        return -1;
+    }
+
+    int64_t now = m_loop->loopNow();
+    size_t quota = OutputQueue::kNoLimit;
+    for (int i = 0; i < count; ++i)
+        quota = shapers[i]->writeQuota(quota, now);
+    ssize_t n = m_outputQueue.writeTo(m_channel->fd(), savedErrno, attempted, quota);
+    if (m_zeroCopy)
+        watchZeroCopyCompletions();
+    if (n > 0)
+    {
+        for (int i = 0; i < count; ++i)
+            shapers[i]->onWrite(n, now);
+    }
+
+    // 令牌用完了还有数据，暂停写，不再等可写事件
+    if (!m_outputQueue.empty() && (quota == 0 || (n > 0 && static_cast<size_t>(n) == quota)))
+    {
+        throttleWriting(shapers, count);
+        if (n == 0)
+        {
+            *savedErrno = EWOULDBLOCK;
+            return -1;
+        }
+    }
+    return n;
+}
+
+void TcpConnection::throttleWriting(TrafficShaper *const *shapers, int count)
+{
+    // 等令牌攒够一个burst(数据少时够发完就行)，每次放出去的块大小均匀
+    int64_t now = m_loop->loopNow();
+    int64_t delay = kMinShapingDelayUs;
+    for (int i = 0; i < count; ++i)
+        delay = std::max(delay, shapers[i]->writeDelayUs(m_outputQueue.readableBytes(), now));
+
+    m_writeThrottled = true;
+    if (m_channel->isWriting() && !m_channel->isEdgeTriggered())
+        m_channel->disableWriting();
+    std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+    m_writeShapingTimer = m_loop->runAfter(delay, [weakConn]()
+                                           {
+                                               TcpConnectionPtr conn = weakConn.lock();
+                                               if (conn)
+                                                   conn->handleWriteShapingTimer(); });
+}
+
+void TcpConnection::handleWriteShapingTimer()
+{
+    m_loop->assertInLoopThread();
+    m_writeThrottled = false;
+    if (m_state == kDisconnected || m_outputQueue.empty())
+        return;
+
+    // 边缘触发模式下socket一直可写，不会再有通知，两种模式都直接写一次
+    if (!m_channel->isWriting())
+        m_channel->enableWriting();
+    handleWrite();
+}
+
+void TcpConnection::shapeRead(size_t n)
+{
+    TrafficShaper *shapers[3];
+    int count = activeShapers(shapers, true);
+    if (count == 0)
+        return;
+
+    // 已经读进来的数据不能退回去，记成欠账，欠账还清之前暂停读
+    int64_t now = m_loop->loopNow();
+    int64_t delay = 0;
+    for (int i = 0; i < count; ++i)
+        delay = std::max(delay, shapers[i]->onRead(n, now));
+    if (delay < kMinShapingDelayUs || m_readThrottled)
+        return;
+
+    m_readThrottled = true;
+    pauseReadingInLoop();
+    std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+    m_readShapingTimer = m_loop->runAfter(delay, [weakConn]()
+                                          {
+                                              TcpConnectionPtr conn = weakConn.lock();
+                                              if (conn)
+                                                  conn->handleReadShapingTimer(); });
+}
+
+void TcpConnection::handleReadShapingTimer()
+{
+    m_loop->assertInLoopThread();
+    m_readThrottled = false;
+    resumeReadingInLoop();
+}
+
+void TcpConnection::setAutoCork(bool on, bool tcpCork)
+{
+    m_autoCork = on;
+    m_tcpCork = on && tcpCork;
+}
+
+void TcpConnection::setEdgeTriggered(bool on)
+{
+    m_channel->setEdgeTriggered(on && m_loop->supportsEdgeTriggered());
+}
+
+bool TcpConnection::isEdgeTriggered() const
+{
+    return m_channel->isEdgeTriggered();
+}
+
 void TcpConnection::connectEstablished()
 {
     m_loop->assertInLoopThread();
@@ -257,6 +1015,11 @@ void TcpConnection::connectEstablished()
 
     setState(kConnected);
 
+    if (m_loop->socketBusyPollUs() > 0)
+    {
+        m_socket->setBusyPoll(m_loop->socketBusyPollUs());
+    }
+
     // 假如正在执行这行代码时，对端关闭了连接
     if (!m_channel->enableReading())
     {
@@ -266,6 +1029,9 @@ void TcpConnection::connectEstablished()
         return;
     }
 
+    m_lastReadUs = m_lastWriteUs = m_loop->loopNow();
+    scheduleTimeout();
+
     // connectionCallback_指向void XXServer::OnConnection(const std::shared_ptr<TcpConnection>& conn)
     m_connectionCallback(shared_from_this());
 }
@@ -277,26 +1043,181 @@ void TcpConnection::connectDestroyed()
     {
         setState(kDisconnected);
         m_channel->disableAll();
+        updateFlowControl();
 
         m_connectionCallback(shared_from_this());
     }
+    if (m_timeoutTimerUs != 0)
+    {
+        m_loop->remove(m_timeoutTimer);
+        m_timeoutTimerUs = 0;
+    }
+    if (m_readThrottled)
+    {
+        m_loop->remove(m_readShapingTimer);
+        m_readThrottled = false;
+    }
+    if (m_writeThrottled)
+    {
+        m_loop->remove(m_writeShapingTimer);
+        m_writeThrottled = false;
+    }
     m_channel->remove();
 }
 
+void TcpConnection::setTimeout(ConnectionTimeout type, int64_t timeoutUs)
+{
+    m_timeoutUs[type] = timeoutUs > 0 ? timeoutUs : 0;
+    // 连接建立之前设置的在connectEstablished()里统一设置定时器
+    if (m_state == kConnected)
+    {
+        m_loop->assertInLoopThread();
+        scheduleTimeout();
+    }
+}
+
+int64_t TcpConnection::timeoutDeadline(ConnectionTimeout type) const
+{
+    int64_t timeoutUs = m_timeoutUs[type];
+    if (timeoutUs == 0)
+        return 0;
+
+    switch (type)
+    {
+    case kIdleTimeout:
+        return std::max(m_lastReadUs, m_lastWriteUs) + timeoutUs;
+    case kReadTimeout:
+        return m_lastReadUs + timeoutUs;
+    case kWriteTimeout:
+        // 没有待发送的数据时不存在写超时
+        return !m_outputQueue.empty() ? m_lastWriteUs + timeoutUs : 0;
+    default:
+        return 0;
+    }
+}
+
+void TcpConnection::scheduleTimeout()
+{
+    int64_t next = 0;
+    for (int i = 0; i < kConnectionTimeoutTypes; ++i)
+    {
+        int64_t deadline = timeoutDeadline(static_cast<ConnectionTimeout>(i));
+        if (deadline > 0 && (next == 0 || deadline < next))
+            next = deadline;
+    }
+
+    // 已有的定时器不晚于最早的截止时间，到期时再按实际收发时间往后推，
+    // 收发数据时截止时间只会往后移，所以这里绝大多数时候什么都不做
+    if (next == 0 || (m_timeoutTimerUs != 0 && m_timeoutTimerUs <= next))
+        return;
+
+    if (m_timeoutTimerUs != 0)
+        m_loop->remove(m_timeoutTimer);
+
+    // 定时器只持有weak_ptr，不会延长连接的生命周期
+    std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+    m_timeoutTimerUs = next;
+    m_timeoutTimer = m_loop->runAfter(next - m_loop->loopNow(), [weakConn]()
+                                   {
+                                       TcpConnectionPtr conn = weakConn.lock();
+                                       if (conn)
+                                           conn->handleTimeout(); });
+}
+
+void TcpConnection::handleTimeout()
+{
+    m_loop->assertInLoopThread();
+    m_timeoutTimerUs = 0;
+    if (m_state != kConnected)
+        return;
+
+    int64_t now = m_loop->loopNow();
+    bool expired[kConnectionTimeoutTypes] = {false};
+    bool anyExpired = false;
+    for (int i = 0; i < kConnectionTimeoutTypes; ++i)
+    {
+        int64_t deadline = timeoutDeadline(static_cast<ConnectionTimeout>(i));
+        if (deadline > 0 && deadline <= now)
+        {
+            expired[i] = true;
+            anyExpired = true;
+            m_loop->recordTimeout(static_cast<ConnectionTimeout>(i));
+        }
+    }
+
+    if (anyExpired && !m_timeoutCallback)
+    {
+        LOGI("connection %s timed out (idle=%d read=%d write=%d), force close",
+             m_name.c_str(), expired[kIdleTimeout], expired[kReadTimeout], expired[kWriteTimeout]);
+        forceCloseInLoop();
+        return;
+    }
+
+    TcpConnectionPtr guardThis(shared_from_this());
+    for (int i = 0; i < kConnectionTimeoutTypes && m_state == kConnected; ++i)
+    {
+        if (!expired[i])
+            continue;
+        m_timeoutCallback(guardThis, static_cast<ConnectionTimeout>(i));
+        // 回调没有关闭连接，这一类超时重新计时
+        if (i == kIdleTimeout)
+            m_lastReadUs = m_lastWriteUs = now;
+        else if (i == kReadTimeout)
+            m_lastReadUs = now;
+        else
+            m_lastWriteUs = now;
+    }
+
+    if (m_state == kConnected)
+        scheduleTimeout();
+}
+
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
     m_loop->assertInLoopThread();
+    if (m_channel->isEdgeTriggered())
+    {
+        handleReadEdgeTriggered(receiveTime);
+        return;
+    }
+
+    // 按预测的大小准备好可写空间直接读进输入缓冲区，读满了说明socket里还有数据，在预算内接着读
     int savedErrno = 0;
-    int32_t n = m_inputBuffer.readFd(m_channel->fd(), &savedErrno);
-    if (n > 0)
+    int32_t n = 0;
+    size_t total = 0;
+    bool filled = false;
+    for (int i = 0; i < kMaxReadsPerRound; ++i)
     {
+        size_t attempted = 0;
+        n = m_inputBuffer.readFd(m_channel->fd(), &savedErrno, m_recvPredictor.nextSize(), &attempted);
+        if (n <= 0)
+            break;
+
+        bool full = static_cast<size_t>(n) >= attempted;
+        filled = filled || full;
+        total += n;
+        m_loop->addBytesTransferred(n);
+        m_lastReadUs = m_loop->loopNow();
+        shapeRead(n);
         // messageCallback_指向CTcpSession::OnRead(const std::shared_ptr<TcpConnection>& conn, Buffer* pBuffer, Timestamp receiveTime)
         m_messageCallback(shared_from_this(), &m_inputBuffer, receiveTime);
+        // 消息回调里可能已经关闭了连接
+        if (!full || m_state == kDisconnected || !m_channel->isReading())
+            break;
     }
-    else if (n == 0)
+    recordReadRound(total, filled);
+
+    if (n > 0)
+        return;
+
+    if (n == 0)
     {
         handleClose();
     }
+    else if (savedErrno == EAGAIN || savedErrno == EINTR)
+    {
+        // 前面已经读过数据，或者被信号打断，等下一次可读事件
+    }
     else
     {
         errno = savedErrno;
@@ -308,18 +1229,28 @@ void TcpConnection::handleRead(Timestamp receiveTime)
 void TcpConnection::handleWrite()
 {
     m_loop->assertInLoopThread();
+    if (m_channel->isEdgeTriggered())
+    {
+        handleWriteEdgeTriggered();
+        updateFlowControl();
+        return;
+    }
+
     if (m_channel->isWriting())
     {
-        int32_t n = sockets::write(m_channel->fd(), m_outputBuffer.peek(), m_outputBuffer.readableBytes());
+        // 队列里连续的内存段合成一次writev，队头是文件区间时用sendfile
+        int savedErrno = 0;
+        ssize_t n = writeOutput(&savedErrno);
         if (n > 0)
         {
-            m_outputBuffer.retrieve(n);
-            if (m_outputBuffer.readableBytes() == 0)
+            m_loop->addBytesTransferred(n);
+            m_lastWriteUs = m_loop->loopNow();
+            if (m_outputQueue.empty())
             {
                 m_channel->disableWriting();
                 if (m_writeCompleteCallback)
                 {
-                    m_loop->queueInLoop(std::bind(m_writeCompleteCallback, shared_from_this()));
+                    m_loop->queueInLoop(std::bind(&TcpConnection::writeCompleteInLoop, shared_from_this()));
                 }
                 if (m_state == kDisconnecting)
                 {
@@ -327,8 +1258,13 @@ void TcpConnection::handleWrite()
                 }
             }
         }
+        else if (n < 0 && (savedErrno == EAGAIN || savedErrno == EINTR))
+        {
+            // 发送缓冲区又满了，等下一次可写事件
+        }
         else
         {
+            errno = savedErrno;
             LOGSYSE("TcpConnection::handleWrite");
             // if (state_ == kDisconnecting)
             // {
@@ -342,6 +1278,120 @@ void TcpConnection::handleWrite()
     {
         LOGD("Connection fd = %d  is down, no more writing", m_channel->fd());
     }
+    updateFlowControl();
+}
+
+void TcpConnection::handleReadEdgeTriggered(Timestamp receiveTime)
+{
+    // 边缘触发模式下内核缓冲区里剩下的数据不会再有通知，必须一直读到EAGAIN为止
+    if (m_state == kDisconnected || !m_channel->isReading())
+        return;
+
+    int savedErrno = 0;
+    int32_t n = 0;
+    size_t total = 0;
+    bool filled = false;
+    int i = 0;
+    for (; i < kMaxReadsPerRound; ++i)
+    {
+        size_t attempted = 0;
+        n = m_inputBuffer.readFd(m_channel->fd(), &savedErrno, m_recvPredictor.nextSize(), &attempted);
+        if (n > 0)
+        {
+            filled = filled || static_cast<size_t>(n) >= attempted;
+            total += n;
+            m_loop->addBytesTransferred(n);
+            m_lastReadUs = m_loop->loopNow();
+            shapeRead(n);
+            m_messageCallback(shared_from_this(), &m_inputBuffer, receiveTime);
+            // 消息回调里可能已经关闭了连接
+            if (m_state == kDisconnected || !m_channel->isReading())
+                break;
+        }
+        else if (n == 0 || savedErrno != EINTR)
+        {
+            break;
+        }
+    }
+    // 不管从哪条路退出，这一轮都只按读到的总量调整一次
+    recordReadRound(total, filled);
+
+    if (i == kMaxReadsPerRound)
+    {
+        // 本轮的次数用完了但是还没有读到EAGAIN，投递到任务队列里接着读
+        m_loop->queueInLoop(std::bind(&TcpConnection::handleRead, shared_from_this(), receiveTime));
+    }
+    else if (n == 0)
+    {
+        handleClose();
+    }
+    else if (n < 0 && savedErrno != EAGAIN)
+    {
+        errno = savedErrno;
+        LOGSYSE("TcpConnection::handleRead");
+        handleError();
+    }
+}
+
+void TcpConnection::recordReadRound(size_t total, bool filled)
+{
+    // 某次read读满了要的量，即使总量不到预测值也说明socket里数据比预测的多
+    if (total > 0)
+        m_recvPredictor.record(filled ? std::max(total, m_recvPredictor.nextSize()) : total);
+}
+
+void TcpConnection::handleWriteEdgeTriggered()
+{
+    // 写事件一直保持注册，socket发送缓冲区从满变成可写时就会通知，
+    // 这时输出队列可能已经是空的了，直接忽略
+    if (m_state == kDisconnected || m_outputQueue.empty())
+        return;
+
+    for (int i = 0; i < kMaxWritesPerRound && !m_outputQueue.empty(); ++i)
+    {
+        int savedErrno = 0;
+        size_t attempted = 0;
+        ssize_t n = writeOutput(&savedErrno, &attempted);
+        if (n > 0)
+        {
+            m_loop->addBytesTransferred(n);
+            m_lastWriteUs = m_loop->loopNow();
+            // 只写了一部分说明发送缓冲区已经满了，等下一次可写通知，省掉一次必然返回EAGAIN的write
+            if (static_cast<size_t>(n) < attempted)
+                return;
+        }
+        else if (n < 0 && savedErrno == EAGAIN)
+        {
+            return;
+        }
+        else if (n < 0 && savedErrno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            errno = savedErrno;
+            LOGSYSE("TcpConnection::handleWrite");
+            handleClose();
+            return;
+        }
+    }
+
+    if (!m_outputQueue.empty())
+    {
+        // 本轮的次数用完了，socket仍然可写，不会再有新的通知，投递到任务队列里接着写
+        m_loop->queueInLoop(std::bind(&TcpConnection::handleWrite, shared_from_this()));
+        return;
+    }
+
+    if (m_writeCompleteCallback)
+    {
+        m_loop->queueInLoop(std::bind(&TcpConnection::writeCompleteInLoop, shared_from_this()));
+    }
+    if (m_state == kDisconnecting)
+    {
+        shutdownInLoop();
+    }
 }
 
 void TcpConnection::handleClose()
@@ -358,6 +1408,8 @@ void TcpConnection::handleClose()
     //  we don't close fd, leave it to dtor, so we can find leaks easily.
     setState(kDisconnected);
     m_channel->disableAll();
+    // 退还全局计数，恢复因为这个连接积压而暂停的读
+    updateFlowControl();
 
     TcpConnectionPtr guardThis(shared_from_this());
     m_connectionCallback(guardThis);
@@ -368,7 +1420,16 @@ void TcpConnection::handleClose()
 
 void TcpConnection::handleError()
 {
+    // 零拷贝的完成通知放在错误队列里，同样触发错误事件，读完通知之后没有真正的错误就继续
+    if (m_zeroCopy)
+        m_outputQueue.handleZeroCopyCompletions(m_channel->fd());
+
     int err = sockets::getSocketError(m_channel->fd());
+    if (err == 0 && m_zeroCopy)
+    {
+        watchZeroCopyCompletions();
+        return;
+    }
     LOGE("TcpConnection::%s handleError [%d] - SO_ERROR = %s", m_name.c_str(), err, strerror(err));
 
     // 调用handleClose()关闭连接，回收Channel和fd
@@ -7,11 +7,18 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <vector>
 
 #include "Callbacks.h"
 #include "ByteBuffer.h"
+#include "RecvSizePredictor.h"
+#include "OutputQueue.h"
+#include "TrafficShaper.h"
+#include "MpscQueue.h"
 #include "InetAddress.h"
+#include "TimerId.h"
 
 // struct tcp_info is in <netinet/tcp.h>
 struct tcp_info;
@@ -38,14 +45,88 @@ namespace net
         const InetAddress &peerAddress() const { return m_peerAddr; }
         bool connected() const { return m_state == kConnected; }
 
+        // 在其他线程调用时，数据放进这个连接的发送队列，连续多次send只投递一个任务，到loop线程里合成一次writev
         void send(const void *message, int len);
         void send(const string &message);
+        // 下面几个接管数据的所有权，不拷贝；在其他线程调用时也是移动进发送队列
+        void send(string &&message);
+        void send(ByteBuffer &&buf);
         void send(ByteBuffer *message); // this one will swap data
+        // 共享buf的内存块发送，不拷贝数据；在其他线程调用时也只是复制一个视图
+        void send(const CompositeByteBuffer &buf);
+        void send(CompositeByteBuffer &&buf);
+        // 发送文件fd里从offset开始的len字节，用sendfile直接从内核发到socket，数据不经过用户态
+        // 和其他send按调用的先后顺序排队，计入高水位，发完后同样调用写完成回调
+        // 内部dup了一份fd，调用之后fd可以马上关闭；文件在发完之前被截短时关闭连接
+        void sendFile(int fd, int64_t offset, size_t len);
+        // 立即把输出队列里攒下的数据写出去，开了自动合并写之后，对延迟敏感的消息send之后调用
+        void flush();
         void shutdown();
         void forceClose();
 
         void setTcpNoDelay(bool on);
 
+        // 每次read准备的空间按这个连接最近的读取量自适应调整，范围是[minimum, maximum]，从initial开始
+        // 需要在loop线程里或者connectEstablished()之前调用
+        void setReceiveSizeRange(size_t minimum, size_t initial, size_t maximum);
+
+        // 一次要写的数据不少于threshold字节时用MSG_ZEROCOPY发送，数据不再拷进内核，适合几MB的大响应；0表示关闭(默认)
+        // 内存要等内核通知发送完成之后才释放，通知从socket的错误队列里读，每次写之前和Channel的错误事件时各读一次
+        // 内核报告数据被拷贝了(比如发往回环地址)时按退避次数临时改用普通发送，阈值保持不变
+        // socket不支持SO_ZEROCOPY时返回false，保持普通发送；需要在loop线程里或者connectEstablished()之前调用
+        bool setZeroCopyThreshold(size_t threshold);
+
+        // 流量控制：输出队列达到highMark时暂停读，降到lowMark以下时恢复，0表示关闭(默认)
+        // 暂停的是用linkUpstream()登记的上游连接，没有登记时暂停自己(echo一类的服务)
+        // 需要在loop线程里或者connectEstablished()之前调用
+        void setFlowControl(size_t highMark, size_t lowMark);
+        // upstream读到的数据会发到这个连接，这个连接积压时暂停upstream的读，upstream可以在别的loop上
+        // 在这个连接的loop线程里调用
+        void linkUpstream(const TcpConnectionPtr &upstream);
+
+        // 暂停/恢复读，可以嵌套，暂停几次就要恢复几次才会重新读，任意线程都可以调用
+        void pauseReading();
+        void resumeReading();
+        // 暂停读的次数和累计时长(微秒，包括正在暂停的这一段)，流量整形的暂停也算在内，在loop线程里调用
+        int64_t readPauseCount() const { return m_readPauseCount; }
+        int64_t readPausedUs() const;
+
+        // 所有连接输出队列的总字节数达到highBytes时，有积压的连接暂停各自的读源，降到lowBytes以下时恢复，0表示不限制(默认)
+        // 只统计开了流量控制或者设置了这个上限之后写过数据的连接
+        static void setGlobalOutputLimit(size_t highBytes, size_t lowBytes);
+        static int64_t globalOutputBytes();
+        // 所有连接因为流量控制暂停读的累计时长，微秒
+        static int64_t globalReadPausedUs();
+
+        // 流量整形：读写速率上限，字节/秒，0表示不限(默认)，任意线程都可以调用
+        // 读得比速率快时暂停读，欠账还清时由定时器恢复；写每次只写令牌桶里现有的量，用完之后暂停写，
+        // 攒够一个burst(10ms的量)再接着写，数据均匀地放出去，不会一阵一阵地发
+        void setTrafficShaping(int64_t readBytesPerSecond, int64_t writeBytesPerSecond);
+        const TrafficShaper &trafficShaper() const { return m_shaper; }
+        // 和其他连接共用的整形器，比如TcpServer的，和自己的限速、全局限速同时生效
+        // 需要在loop线程里或者connectEstablished()之前调用
+        void setSharedTrafficShaper(const std::shared_ptr<TrafficShaper> &shaper);
+        // 所有连接共用的限速，任意线程都可以调用
+        static void setGlobalTrafficShaping(int64_t readBytesPerSecond, int64_t writeBytesPerSecond);
+        static const TrafficShaper &globalTrafficShaper();
+
+        // 自动合并写(auto-cork)：loop线程里的send只放进输出队列，本轮事件循环结束时一次写出，
+        // 一次handleRead里回复多条小消息时只有一次writev；tcpCork为true时写之前设置TCP_CORK，写完取消，
+        // 内存数据和sendFile的文件内容凑成完整的报文再发；其他线程里的send本来就会合并，不受影响
+        // 需要在loop线程里或者connectEstablished()之前调用
+        void setAutoCork(bool on, bool tcpCork = false);
+        bool autoCork() const { return m_autoCork; }
+
+        // 合并写的统计：推迟到本轮结束的send次数，和实际写出的次数，两者之差就是省下的写系统调用
+        int64_t corkedSends() const { return m_corkedSends; }
+        int64_t corkFlushes() const { return m_corkFlushes; }
+        int64_t writeCallsSaved() const { return m_corkedSends - m_corkFlushes; }
+
+        // 边缘触发模式：读写都一直做到EAGAIN为止，写事件注册后不再反复开关
+        // 需要在connectEstablished()之前设置，Poller不支持边缘触发时退回水平触发
+        void setEdgeTriggered(bool on);
+        bool isEdgeTriggered() const;
+
         void setConnectionCallback(const ConnectionCallback &cb)
         {
             m_connectionCallback = cb;
@@ -68,14 +149,30 @@ namespace net
             m_highWaterMark = highWaterMark;
         }
 
+        // 空闲、读、写超时，单位微秒，0表示不检查(默认)
+        // 超时后调用超时回调，没有设置回调时直接关闭连接，超时次数记录在EventLoop::timeoutCount()里
+        // 收发数据时只记录时间，不操作定时器；每个连接只有一个定时器，到期时按实际的收发时间判断，
+        // 没有超时就按新的截止时间重新设置
+        // 在connectEstablished()之前设置，或者在连接所属的loop线程里设置
+        void setIdleTimeout(int64_t timeoutUs) { setTimeout(kIdleTimeout, timeoutUs); }
+        void setReadTimeout(int64_t timeoutUs) { setTimeout(kReadTimeout, timeoutUs); }
+        void setWriteTimeout(int64_t timeoutUs) { setTimeout(kWriteTimeout, timeoutUs); }
+
+        // 回调里没有关闭连接时，这一类超时从现在开始重新计时
+        void setTimeoutCallback(const TimeoutCallback &cb)
+        {
+            m_timeoutCallback = cb;
+        }
+
         ByteBuffer *inputBuffer()
         {
             return &m_inputBuffer;
         }
 
-        ByteBuffer *outputBuffer()
+        // 还没有发出去的数据
+        const OutputQueue &outputQueue() const
         {
-            return &m_outputBuffer;
+            return m_outputQueue;
         }
 
         // Internal use only.
@@ -97,14 +194,80 @@ namespace net
         };
         void handleRead(Timestamp receiveTime);
         void handleWrite();
+        void handleReadEdgeTriggered(Timestamp receiveTime);
+        // 一次handleRead结束时按读到的总量调整m_recvPredictor，filled表示有一次read读满了要的量
+        void recordReadRound(size_t total, bool filled);
+        void handleWriteEdgeTriggered();
         void handleClose();
         void handleError();
         // void sendInLoop(string&& message);
         void sendInLoop(const string &message);
         void sendInLoop(const void *message, size_t len);
+        void sendBufferInLoop(const CompositeByteBuffer &buf);
+        void sendFileInLoop(int fd, int64_t offset, size_t len);
+
+        // 其他线程交给loop线程发送的数据，只有m_kind对应的成员有效
+        struct PendingSend : public MpscNode
+        {
+            enum Kind
+            {
+                kString,
+                kByteBuffer,
+                kBuffer,
+                kFile
+            };
+            Kind m_kind;
+            string m_string;
+            ByteBuffer m_byteBuffer;
+            std::unique_ptr<CompositeByteBuffer> m_buffer; // 只在kBuffer时创建，其他节点不占这部分空间
+            int m_fd;
+            int64_t m_fileOffset;
+            size_t m_length;
+
+            explicit PendingSend(Kind kind) : m_kind(kind), m_fd(-1), m_fileOffset(0), m_length(0) {}
+        };
+        // 放进发送队列，队列原来没有等待处理的任务时投递一个
+        void queueSend(PendingSend *pending);
+        // 在loop线程里把发送队列里的数据都放进输出队列，再写一次
+        void drainPendingSends();
+        // 新数据已经放进了输出队列，队列原来是空的时直接写一次，写不完的等可写事件
+        // 开了自动合并写时不写，推迟到本轮事件循环结束
+        void writeQueued(size_t oldLen);
+        // 把输出队列写到socket发送缓冲区满为止，写不完的等可写事件
+        void flushInLoop();
+        // 所有写都走这里：有写限速时最多写令牌桶里现有的量，令牌用完了还有数据时暂停写，
+        // 暂停期间返回-1，savedErrno是EWOULDBLOCK，和发送缓冲区满一样处理
+        ssize_t writeOutput(int *savedErrno, size_t *attempted = NULL);
+        // 自己的、共用的和全局的整形器里限制读(reads为true)或者写的那些，返回个数
+        int activeShapers(TrafficShaper *shapers[3], bool reads);
+        bool shapingWrites();
+        // 读到了n字节，读得太快时暂停读，定时器到期恢复
+        void shapeRead(size_t n);
+        void throttleWriting(TrafficShaper *const *shapers, int count);
+        void handleReadShapingTimer();
+        void handleWriteShapingTimer();
+        void pauseReadingInLoop();
+        void resumeReadingInLoop();
+        // 输出队列的字节数变了：更新全局计数，越过高水位暂停读源，回到低水位恢复
+        void updateFlowControl();
+        void pauseSources();
+        void resumeSources();
+        // 新数据已经放进了输出队列，oldLen是放进去之前队列里的字节数：检查高水位，开始计写超时，注册写事件
+        void outputQueued(size_t oldLen);
+        // 还有零拷贝发送在等完成通知时让fd留在Poller里收错误事件，暂停读、没有写的时候也不例外，都完成了再取消
+        void watchZeroCopyCompletions();
+        // 析构时还有零拷贝发送没收到完成通知，交给loop的ZeroCopyReaper
+        void handOverZeroCopySends();
+        void writeCompleteInLoop();
         void shutdownInLoop();
         // void shutdownAndForceCloseInLoop(double seconds);
         void forceCloseInLoop();
+        void setTimeout(ConnectionTimeout type, int64_t timeoutUs);
+        // type类超时的截止时间，不需要检查时返回0
+        int64_t timeoutDeadline(ConnectionTimeout type) const;
+        // 按最早的截止时间设置定时器，已有的定时器不晚于这个时间时什么都不做
+        void scheduleTimeout();
+        void handleTimeout();
         void setState(StateE s) { m_state = s; }
         const char *stateToString() const;
 
@@ -123,7 +286,41 @@ namespace net
         CloseCallback m_closeCallback;
         size_t m_highWaterMark;
         ByteBuffer m_inputBuffer;
-        ByteBuffer m_outputBuffer;
+        RecvSizePredictor m_recvPredictor;
+        OutputQueue m_outputQueue;
+        MpscQueue<PendingSend> m_pendingSends;
+        std::atomic<bool> m_drainQueued; // 已经投递了drainPendingSends()，还没有开始执行
+        bool m_zeroCopy; // socket打开了SO_ZEROCOPY，错误事件可能只是零拷贝的完成通知
+        bool m_autoCork;
+        bool m_tcpCork;
+        bool m_flushQueued;        // 已经加入了本轮结束时的写
+        int64_t m_corkedSends;
+        int64_t m_corkFlushes;
+
+        size_t m_flowHighMark;
+        size_t m_flowLowMark;
+        size_t m_accountedBytes;   // 已经计入全局输出字节数的部分
+        std::vector<std::weak_ptr<TcpConnection>> m_upstreams;
+        std::vector<std::weak_ptr<TcpConnection>> m_pausedSources; // 因为这个连接积压而暂停了读的连接
+        bool m_pausingSources;
+        int m_readPauses;          // 嵌套的暂停次数
+        int64_t m_readPauseStartUs;
+        int64_t m_readPausedUs;
+        int64_t m_readPauseCount;
+
+        TrafficShaper m_shaper;
+        std::shared_ptr<TrafficShaper> m_sharedShaper;
+        bool m_readThrottled;      // 因为读限速暂停了读，m_readShapingTimer到期时恢复
+        bool m_writeThrottled;     // 因为写限速暂停了写，m_writeShapingTimer到期时接着写
+        TimerId m_readShapingTimer;
+        TimerId m_writeShapingTimer;
+
+        TimeoutCallback m_timeoutCallback;
+        int64_t m_timeoutUs[kConnectionTimeoutTypes];
+        int64_t m_lastReadUs;      // 最后一次收到数据的时间，EventLoop::loopNow()
+        int64_t m_lastWriteUs;     // 最后一次发出数据的时间，输出缓冲区从空变成非空时也会更新
+        TimerId m_timeoutTimer;
+        int64_t m_timeoutTimerUs;  // 超时定时器的到期时间，0表示没有设置
     };
 
     typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
@@ -13,6 +13,7 @@
 #include "../base/Platform.h"
 #include "../base/AsyncLog.h"
 #include "../base/Singleton.h"
+#include "../base/CountDownLatch.h"
 #include "Acceptor.h"
 #include "EventLoop.h"
 #include "EventLoopThreadPool.h"
@@ -20,21 +21,44 @@
 
 using namespace net;
 
+const int TcpServer::kOneLoopPerCpu;
+
 TcpServer::TcpServer(EventLoop *loop,
                      const InetAddress &listenAddr,
                      const std::string &nameArg,
                      Option option)
     : m_loop(loop),
+      m_listenAddr(listenAddr),
       m_hostport(listenAddr.toIpPort()),
       m_name(nameArg),
-      m_acceptor(new Acceptor(loop, listenAddr, option == kReusePort)),
+      m_option(option),
       // threadPool_(new EventLoopThreadPool(loop, name_)),
       m_connectionCallback(defaultConnectionCallback),
       m_messageCallback(defaultMessageCallback),
+      m_zeroCopyThreshold(0),
+      m_autoCork(false),
+      m_tcpCork(false),
+      m_flowHighMark(0),
+      m_flowLowMark(0),
+      m_connReadBytesPerSecond(0),
+      m_connWriteBytesPerSecond(0),
+      m_trafficShaper(std::make_shared<TrafficShaper>()),
       m_started(0),
-      m_nextConnId(1)
+      m_nextConnId(1),
+      m_edgeTriggered(false),
+      m_busyPollUs(0),
+      m_socketBusyPollUs(0),
+      m_dispatchPolicy(LoopDispatcher::kRoundRobin)
 {
-    m_acceptor->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
+    for (int i = 0; i < kConnectionTimeoutTypes; ++i)
+        m_timeoutUs[i] = 0;
+    setReceiveSizeRange(RecvSizePredictor::kDefaultMinimum, RecvSizePredictor::kDefaultInitial, RecvSizePredictor::kDefaultMaximum);
+
+    if (m_option != kReusePortPerLoop)
+    {
+        m_acceptor.reset(new Acceptor(loop, listenAddr, option == kReusePort));
+        m_acceptor->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
+    }
 }
 
 TcpServer::~TcpServer()
@@ -45,15 +69,40 @@ TcpServer::~TcpServer()
     stop();
 }
 
-void TcpServer::start(int workerThreadCount /* = 4*/)
+void TcpServer::start(int workerThreadCount /* = kOneLoopPerCpu*/)
 {
     if (m_started == 0)
     {
         m_eventLoopThreadPool.reset(new EventLoopThreadPool());
         m_eventLoopThreadPool->init(m_loop, workerThreadCount);
-        m_eventLoopThreadPool->start();
+        m_eventLoopThreadPool->setBusyPoll(m_busyPollUs, m_socketBusyPollUs);
+        m_eventLoopThreadPool->setCpuAffinity(m_cpus);
+        m_eventLoopThreadPool->setDispatchPolicy(m_dispatchPolicy);
+        m_eventLoopThreadPool->start(m_threadInitCallback);
 
-        m_loop->runInLoop(std::bind(&Acceptor::listen, m_acceptor.get()));
+        if (m_option == kReusePortPerLoop)
+        {
+            // 每个Acceptor都在自己的IO线程里创建和listen，Channel只能在所属线程里注册
+            // 等所有线程都listen之后再返回，保证start()返回后就可以连接
+            std::vector<EventLoop *> ioLoops = m_eventLoopThreadPool->getAllLoops();
+            CountDownLatch latch(static_cast<int>(ioLoops.size()));
+            for (EventLoop *ioLoop : ioLoops)
+            {
+                LoopAcceptor *loopAcceptor = new LoopAcceptor;
+                loopAcceptor->m_loop = ioLoop;
+                m_loopAcceptors.emplace_back(loopAcceptor);
+                ioLoop->runInLoop([this, loopAcceptor, &latch]()
+                                  {
+                    startLoopAcceptor(loopAcceptor);
+                    latch.countDown(); });
+            }
+            latch.wait();
+        }
+        else
+        {
+            m_acceptor->setEdgeTriggered(m_edgeTriggered);
+            m_loop->runInLoop(std::bind(&Acceptor::listen, m_acceptor.get()));
+        }
         m_started = 1;
     }
 }
@@ -71,6 +120,22 @@ void TcpServer::stop()
         conn.reset();
     }
 
+    // 等所有IO线程关闭各自的监听socket、销毁各自的连接之后再停线程
+    if (!m_loopAcceptors.empty())
+    {
+        CountDownLatch latch(static_cast<int>(m_loopAcceptors.size()));
+        for (auto &loopAcceptor : m_loopAcceptors)
+        {
+            LoopAcceptor *p = loopAcceptor.get();
+            p->m_loop->runInLoop([this, p, &latch]()
+                                 {
+                stopLoopAcceptor(p);
+                latch.countDown(); });
+        }
+        latch.wait();
+        m_loopAcceptors.clear();
+    }
+
     m_eventLoopThreadPool->stop();
 
     m_started = 0;
@@ -80,10 +145,7 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
     m_loop->assertInLoopThread();
     EventLoop *ioLoop = m_eventLoopThreadPool->getNextLoop();
-    char buf[32];
-    snprintf(buf, sizeof buf, ":%s#%d", m_hostport.c_str(), m_nextConnId);
-    ++m_nextConnId;
-    string connName = m_name + buf;
+    string connName = nextConnectionName();
 
     LOGD("TcpServer::newConnection [%s] - new connection [%s] from %s", m_name.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
 
@@ -92,14 +154,104 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     // FIXME use make_shared if necessary
     TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
     m_connections[connName] = conn;
-    conn->setConnectionCallback(m_connectionCallback);
-    conn->setMessageCallback(m_messageCallback);
-    conn->setWriteCompleteCallback(m_writeCompleteCallback);
+    initConnection(conn);
     conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1)); // FIXME: unsafe
     // 该线程分离完io事件后，立即调用TcpConnection::connectEstablished
     ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
 }
 
+void TcpServer::initConnection(const TcpConnectionPtr &conn)
+{
+    conn->setConnectionCallback(m_connectionCallback);
+    conn->setMessageCallback(m_messageCallback);
+    conn->setWriteCompleteCallback(m_writeCompleteCallback);
+    conn->setEdgeTriggered(m_edgeTriggered);
+    conn->setIdleTimeout(m_timeoutUs[kIdleTimeout]);
+    conn->setReadTimeout(m_timeoutUs[kReadTimeout]);
+    conn->setWriteTimeout(m_timeoutUs[kWriteTimeout]);
+    conn->setReceiveSizeRange(m_recvSizeRange[0], m_recvSizeRange[1], m_recvSizeRange[2]);
+    if (m_zeroCopyThreshold > 0)
+        conn->setZeroCopyThreshold(m_zeroCopyThreshold);
+    conn->setAutoCork(m_autoCork, m_tcpCork);
+    if (m_flowHighMark > 0)
+        conn->setFlowControl(m_flowHighMark, m_flowLowMark);
+    if (m_connReadBytesPerSecond > 0 || m_connWriteBytesPerSecond > 0)
+        conn->setTrafficShaping(m_connReadBytesPerSecond, m_connWriteBytesPerSecond);
+    conn->setSharedTrafficShaper(m_trafficShaper);
+    if (m_timeoutCallback)
+        conn->setTimeoutCallback(m_timeoutCallback);
+}
+
+int64_t TcpServer::timeoutCount(ConnectionTimeout type) const
+{
+    if (!m_eventLoopThreadPool)
+        return 0;
+
+    int64_t count = 0;
+    for (EventLoop *loop : m_eventLoopThreadPool->getAllLoops())
+        count += loop->timeoutCount(type);
+    return count;
+}
+
+string TcpServer::nextConnectionName()
+{
+    char buf[32];
+    snprintf(buf, sizeof buf, ":%s#%d", m_hostport.c_str(), m_nextConnId.fetch_add(1));
+    return m_name + buf;
+}
+
+void TcpServer::startLoopAcceptor(LoopAcceptor *loopAcceptor)
+{
+    EventLoop *ioLoop = loopAcceptor->m_loop;
+    ioLoop->assertInLoopThread();
+    loopAcceptor->m_acceptor.reset(new Acceptor(ioLoop, m_listenAddr, true));
+    loopAcceptor->m_acceptor->setNewConnectionCallback(
+        std::bind(&TcpServer::newLoopConnection, this, loopAcceptor, std::placeholders::_1, std::placeholders::_2));
+    loopAcceptor->m_acceptor->setEdgeTriggered(m_edgeTriggered);
+    loopAcceptor->m_acceptor->listen();
+}
+
+void TcpServer::stopLoopAcceptor(LoopAcceptor *loopAcceptor)
+{
+    loopAcceptor->m_loop->assertInLoopThread();
+    loopAcceptor->m_acceptor.reset();
+
+    ConnectionMap connections;
+    connections.swap(loopAcceptor->m_connections);
+    for (auto &iter : connections)
+    {
+        iter.second->connectDestroyed();
+    }
+}
+
+void TcpServer::newLoopConnection(LoopAcceptor *loopAcceptor, int sockfd, const InetAddress &peerAddr)
+{
+    EventLoop *ioLoop = loopAcceptor->m_loop;
+    ioLoop->assertInLoopThread();
+    string connName = nextConnectionName();
+
+    LOGD("TcpServer::newLoopConnection [%s] - new connection [%s] from %s", m_name.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
+
+    InetAddress localAddr(sockets::getLocalAddr(sockfd));
+    TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
+    loopAcceptor->m_connections[connName] = conn;
+    initConnection(conn);
+    conn->setCloseCallback(std::bind(&TcpServer::removeLoopConnection, this, loopAcceptor, std::placeholders::_1));
+    // 已经在连接所属的线程里了，不需要再投递
+    conn->connectEstablished();
+}
+
+void TcpServer::removeLoopConnection(LoopAcceptor *loopAcceptor, const TcpConnectionPtr &conn)
+{
+    loopAcceptor->m_loop->assertInLoopThread();
+    LOGD("TcpServer::removeLoopConnection [%s] - connection %s", m_name.c_str(), conn->name().c_str());
+    if (loopAcceptor->m_connections.erase(conn->name()) != 1)
+        return;
+
+    // handleClose()还在调用栈上，延后到本轮任务里再销毁
+    loopAcceptor->m_loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
 void TcpServer::removeConnection(const TcpConnectionPtr &conn)
 {
     // FIXME: unsafe
@@ -10,8 +10,10 @@
 #include <atomic>
 #include <map>
 #include <memory>
+#include <vector>
 
 #include "TcpConnection.h"
+#include "LoopDispatcher.h"
 
 namespace net
 {
@@ -27,7 +29,12 @@ namespace net
         {
             kNoReusePort,
             kReusePort,
+            // 每个IO线程各自创建一个SO_REUSEPORT的监听socket和Acceptor，由内核把新连接分散到各个socket上，
+            // 连接在哪个线程被accept就在哪个线程处理，连接表也按线程分开，整个过程不需要跨线程
+            kReusePortPerLoop,
         };
+        // 传给start()，按可用的CPU数(设置了绑定的CPU列表时是列表的长度)创建IO线程
+        static const int kOneLoopPerCpu = -1;
 
         TcpServer(EventLoop *loop,
                   const InetAddress &listenAddr,
@@ -43,7 +50,26 @@ namespace net
             m_threadInitCallback = cb;
         }
 
-        void start(int workerThreadCount = 4);
+        // 监听socket和所有新连接都使用边缘触发模式，需要在start()之前设置
+        // 当前Poller不支持边缘触发时(poll/select)自动退回水平触发
+        void setEdgeTriggered(bool on) { m_edgeTriggered = on; }
+
+        // IO线程池使用忙轮询模式，见EventLoopThreadPool::setBusyPoll()，需要在start()之前设置
+        void setBusyPoll(int64_t spinUs, int socketBusyPollUs = 0)
+        {
+            m_busyPollUs = spinUs;
+            m_socketBusyPollUs = socketBusyPollUs;
+        }
+
+        // IO线程绑定的CPU列表，见EventLoopThreadPool::setCpuAffinity()，需要在start()之前设置
+        void setCpuAffinity(const std::vector<int> &cpus) { m_cpus = cpus; }
+
+        // 新连接分配给IO线程的策略，见EventLoopThreadPool::setDispatchPolicy()，需要在start()之前设置
+        // kReusePortPerLoop模式下新连接由内核分配，这个设置不起作用
+        void setDispatchPolicy(LoopDispatcher::Policy policy) { m_dispatchPolicy = policy; }
+
+        // 默认kOneLoopPerCpu，每个CPU一个IO线程，见kOneLoopPerCpu；0表示不创建IO线程，所有连接都在m_loop里处理
+        void start(int workerThreadCount = kOneLoopPerCpu);
 
         void stop();
 
@@ -68,6 +94,70 @@ namespace net
             m_writeCompleteCallback = cb;
         }
 
+        // 新连接的空闲、读、写超时，单位微秒，0表示不检查，见TcpConnection::setIdleTimeout()
+        /// Not thread safe.
+        void setIdleTimeout(int64_t timeoutUs) { m_timeoutUs[kIdleTimeout] = timeoutUs; }
+        void setReadTimeout(int64_t timeoutUs) { m_timeoutUs[kReadTimeout] = timeoutUs; }
+        void setWriteTimeout(int64_t timeoutUs) { m_timeoutUs[kWriteTimeout] = timeoutUs; }
+
+        /// Not thread safe.
+        void setTimeoutCallback(const TimeoutCallback &cb)
+        {
+            m_timeoutCallback = cb;
+        }
+
+        // 新连接每次read准备的空间的自适应范围，见TcpConnection::setReceiveSizeRange()
+        /// Not thread safe.
+        void setReceiveSizeRange(size_t minimum, size_t initial, size_t maximum)
+        {
+            m_recvSizeRange[0] = minimum;
+            m_recvSizeRange[1] = initial;
+            m_recvSizeRange[2] = maximum;
+        }
+
+        // 新连接一次要写的数据不少于threshold字节时用MSG_ZEROCOPY发送，见TcpConnection::setZeroCopyThreshold()
+        /// Not thread safe.
+        void setZeroCopyThreshold(size_t threshold)
+        {
+            m_zeroCopyThreshold = threshold;
+        }
+
+        // 新连接的自动合并写，见TcpConnection::setAutoCork()
+        /// Not thread safe.
+        void setAutoCork(bool on, bool tcpCork = false)
+        {
+            m_autoCork = on;
+            m_tcpCork = tcpCork;
+        }
+
+        // 新连接的输出高低水位，见TcpConnection::setFlowControl()
+        /// Not thread safe.
+        void setFlowControl(size_t highMark, size_t lowMark)
+        {
+            m_flowHighMark = highMark;
+            m_flowLowMark = lowMark;
+        }
+
+        // 每个新连接各自的读写速率上限，字节/秒，见TcpConnection::setTrafficShaping()
+        /// Not thread safe.
+        void setConnectionTrafficShaping(int64_t readBytesPerSecond, int64_t writeBytesPerSecond)
+        {
+            m_connReadBytesPerSecond = readBytesPerSecond;
+            m_connWriteBytesPerSecond = writeBytesPerSecond;
+        }
+
+        // 这个TcpServer所有连接加起来的读写速率上限，字节/秒，0表示不限(默认)
+        // 任意线程都可以调用，已有的连接下一次读写时生效
+        void setTrafficShaping(int64_t readBytesPerSecond, int64_t writeBytesPerSecond)
+        {
+            m_trafficShaper->setRates(readBytesPerSecond, writeBytesPerSecond);
+        }
+        // 所有连接共用的整形器，可以取统计
+        const TrafficShaper &trafficShaper() const { return *m_trafficShaper; }
+
+        // 所有IO线程上type类超时的总次数，在主loop线程里调用
+        int64_t timeoutCount(ConnectionTimeout type) const;
+
         void removeConnection(const TcpConnectionPtr &conn);
 
     private:
@@ -80,18 +170,53 @@ namespace net
 
         typedef std::map<string, TcpConnectionPtr> ConnectionMap;
 
+        // kReusePortPerLoop模式下每个IO线程自己的Acceptor和连接表，只在所属线程里访问
+        struct LoopAcceptor
+        {
+            EventLoop *m_loop;
+            std::unique_ptr<Acceptor> m_acceptor;
+            ConnectionMap m_connections;
+        };
+
+        void startLoopAcceptor(LoopAcceptor *loopAcceptor);
+        void stopLoopAcceptor(LoopAcceptor *loopAcceptor);
+        void newLoopConnection(LoopAcceptor *loopAcceptor, int sockfd, const InetAddress &peerAddr);
+        // 新连接的公共设置，newConnection()和newLoopConnection()共用
+        void initConnection(const TcpConnectionPtr &conn);
+        void removeLoopConnection(LoopAcceptor *loopAcceptor, const TcpConnectionPtr &conn);
+        string nextConnectionName();
+
     private:
         EventLoop *m_loop;
+        const InetAddress m_listenAddr;
         const string m_hostport;
         const string m_name;
-        std::unique_ptr<Acceptor> m_acceptor;
+        const Option m_option;
+        std::unique_ptr<Acceptor> m_acceptor; // kReusePortPerLoop模式下为空
+        std::vector<std::unique_ptr<LoopAcceptor>> m_loopAcceptors;
         std::unique_ptr<EventLoopThreadPool> m_eventLoopThreadPool;
         ConnectionCallback m_connectionCallback;
         MessageCallback m_messageCallback;
         WriteCompleteCallback m_writeCompleteCallback;
+        TimeoutCallback m_timeoutCallback;
+        int64_t m_timeoutUs[kConnectionTimeoutTypes];
+        size_t m_recvSizeRange[3]; // 最小、初始、最大
+        size_t m_zeroCopyThreshold;
+        bool m_autoCork;
+        bool m_tcpCork;
+        size_t m_flowHighMark;
+        size_t m_flowLowMark;
+        int64_t m_connReadBytesPerSecond;
+        int64_t m_connWriteBytesPerSecond;
+        std::shared_ptr<TrafficShaper> m_trafficShaper;
         ThreadInitCallback m_threadInitCallback;
         std::atomic<int> m_started;
-        int m_nextConnId;
+        std::atomic<int> m_nextConnId;
+        bool m_edgeTriggered;
+        int64_t m_busyPollUs;
+        int m_socketBusyPollUs;
+        std::vector<int> m_cpus;
+        LoopDispatcher::Policy m_dispatchPolicy;
         ConnectionMap m_connections;
     };
 
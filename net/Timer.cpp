@@ -6,39 +6,50 @@ using namespace net;
 
 std::atomic<int64_t> Timer::s_numCreated;
 
-Timer::Timer(const TimerCallback &cb, Timestamp when, int64_t interval, int64_t repeatCount /* = -1*/)
-    : m_callback(cb),
-      m_expiration(when),
-      m_interval(interval),
-      m_repeatCount(repeatCount),
-      m_sequence(++s_numCreated),
-      m_canceled(false)
+Timer::Timer()
+    : m_interval(0),
+      m_repeatCount(0),
+      m_sequence(0),
+      m_canceled(false),
+      m_state(kFree),
+      m_pooled(false),
+      m_level(0),
+      m_slot(0),
+      m_prev(NULL),
+      m_next(NULL)
 {
 }
 
-Timer::Timer(TimerCallback &&cb, Timestamp when, int64_t interval)
-    : m_callback(std::move(cb)),
-      m_expiration(when),
-      m_interval(interval),
-      m_repeatCount(-1),
-      m_sequence(++s_numCreated),
-      m_canceled(false)
+void Timer::init(TimerCallback &&cb, Timestamp when, int64_t interval, int64_t repeatCount /* = -1*/)
 {
+    m_callback = std::move(cb);
+    m_expiration = when;
+    m_interval = interval;
+    m_repeatCount = repeatCount;
+    m_sequence = ++s_numCreated;
+    m_canceled = false;
 }
 
 void Timer::run()
 {
-    if (m_canceled)
-        return;
-    m_callback();
+    // 处于取消状态的定时器只是跳过本次回调，仍然要推进到期时间，否则会被反复触发
+    if (!m_canceled)
+        m_callback();
     if (m_repeatCount != -1)
     {
         --m_repeatCount;
-        if (m_repeatCount == 0)
-        {
-            // repeatCount_ = 0;
-            return;
-        }
     }
-    m_expiration += m_interval;
+}
+
+void Timer::restart(Timestamp now)
+{
+    int64_t interval = m_interval > 0 ? m_interval : 1;
+    int64_t next = m_expiration.microSecondsSinceEpoch() + interval;
+    int64_t nowUs = now.microSecondsSinceEpoch();
+    if (next <= nowUs)
+    {
+        // 保持在原来的周期网格上，不会因为一次延迟让之后的每次触发都往后漂移
+        next += ((nowUs - next) / interval + 1) * interval;
+    }
+    m_expiration = Timestamp(next);
 }
@@ -17,10 +17,14 @@ namespace net
     class Timer
     {
     public:
-        Timer(const TimerCallback &cb, Timestamp when, int64_t interval, int64_t repeatCount = -1);
-        Timer(TimerCallback &&cb, Timestamp when, int64_t interval);
+        Timer();
+
+        // 定时器节点由TimingWheel的节点池复用，每次启用都会分配一个新的序号
+        void init(TimerCallback &&cb, Timestamp when, int64_t interval, int64_t repeatCount = -1);
 
         void run();
+        // 重复的定时器推进到now之后的下一个周期，loop被阻塞错过的周期直接跳过，不会连续补触发
+        void restart(Timestamp now);
 
         bool isCanceled() const
         {
@@ -42,14 +46,33 @@ namespace net
         Timer(const Timer &rhs) = delete;
         Timer &operator=(const Timer &rhs) = delete;
 
+        friend class TimingWheel;
+        friend class TimerQueue;
+
+        enum State
+        {
+            kFree,    // 在节点池里
+            kPending, // 在时间轮里等待到期
+            kExpired, // 已经从时间轮里取出，正在执行回调
+            kRemoved, // 执行回调期间被删除，执行完直接回收
+        };
+
     private:
-        const TimerCallback m_callback;
+        TimerCallback m_callback;
         Timestamp m_expiration;
-        const int64_t m_interval;
+        int64_t m_interval;
         int64_t m_repeatCount; // 重复次数，-1 表示一直重复下去
-        const int64_t m_sequence;
+        int64_t m_sequence;
         bool m_canceled; // 是否处于取消状态
 
+        // 以下由TimingWheel维护
+        State m_state;
+        bool m_pooled; // 是否属于节点池的内存块，其他线程添加的定时器是单独new出来的
+        int m_level;
+        int m_slot;
+        Timer *m_prev;
+        Timer *m_next; // 时间轮槽位的双向链表，空闲时用作节点池的单向链表
+
         static std::atomic<int64_t> s_numCreated; // 静态变量，统计创建了多少个定时器，线程安全，用于标记定时器的序号
     };
 }
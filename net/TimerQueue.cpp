@@ -8,41 +8,97 @@
 #include "TimerQueue.h"
 
 #include <functional>
+#include <algorithm>
+#include <string.h>
 
 #include "../base/Platform.h"
 #include "../base/AsyncLog.h"
+#include "../base/Clock.h"
 #include "EventLoop.h"
 #include "Timer.h"
 #include "TimerId.h"
 
+#ifndef _WIN32
+#include <sys/timerfd.h>
+#endif
+
 using namespace net;
 
-TimerQueue::TimerQueue(EventLoop *loop)
-    : m_loop(loop),
-      m_timers()
+#ifndef _WIN32
+namespace
 {
-}
+    int createTimerfd()
+    {
+        int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timerfd < 0)
+        {
+            LOG_FATAL("Failed in timerfd_create");
+        }
+        return timerfd;
+    }
 
-TimerQueue::~TimerQueue()
-{
-    for (TimerList::iterator it = m_timers.begin(); it != m_timers.end(); ++it)
+    // 定时器的时间就是CLOCK_MONOTONIC，直接设置成timerfd的绝对时间，不需要再读一次时钟算差值
+    // timerfd的精度是纳秒，这里不做毫秒取整，保证亚毫秒级的定时精度；已经过去的时间会立即触发
+    struct timespec toTimespec(Timestamp when)
     {
-        delete it->second;
+        int64_t microseconds = when.microSecondsSinceEpoch();
+        // 0会解除timerfd，所以至少设置1微秒
+        if (microseconds < 1)
+            microseconds = 1;
+
+        struct timespec ts;
+        ts.tv_sec = static_cast<time_t>(microseconds / MicroSecondsPerSecond);
+        ts.tv_nsec = static_cast<long>((microseconds % MicroSecondsPerSecond) * 1000);
+        return ts;
+    }
+
+    void readTimerfd(int timerfd)
+    {
+        uint64_t howmany;
+        ssize_t n = ::read(timerfd, &howmany, sizeof howmany);
+        if (n != sizeof howmany)
+        {
+            LOG_ERROR("TimerQueue::handleRead() reads %d bytes instead of 8", (int)n);
+        }
     }
 }
+#endif
 
-TimerId TimerQueue::addTimer(const TimerCallback &cb, Timestamp when, int64_t interval, int64_t repeatCount)
+TimerQueue::TimerQueue(EventLoop *loop)
+    : m_loop(loop),
+      m_wheel(Timestamp(Clock::monotonicUs()))
+#ifndef _WIN32
+      ,
+      m_timerfd(createTimerfd()),
+      m_timerfdChannel(new Channel(loop, m_timerfd))
+#endif
 {
-    Timer *timer = new Timer(cb, when, interval);
-    m_loop->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, timer));
-    return TimerId(timer, timer->sequence());
+#ifndef _WIN32
+    m_timerfdChannel->setReadCallback(std::bind(&TimerQueue::handleRead, this));
+    // we are always reading the timerfd, we disarm it with timerfd_settime.
+    m_timerfdChannel->enableReading();
+#endif
+}
+
+TimerQueue::~TimerQueue()
+{
+#ifndef _WIN32
+    m_timerfdChannel->disableAll();
+    m_timerfdChannel->remove();
+    ::close(m_timerfd);
+#endif
+    // 定时器节点由m_wheel释放
 }
 
 TimerId TimerQueue::addTimer(TimerCallback &&cb, Timestamp when, int64_t interval, int64_t repeatCount)
 {
-    Timer *timer = new Timer(std::move(cb), when, interval, repeatCount);
+    // 节点池只能在loop线程里访问，其他线程添加的定时器单独分配，回收时并入节点池
+    Timer *timer = m_loop->isInLoopThread() ? m_wheel.newTimer() : new Timer();
+    timer->init(std::move(cb), when, interval, repeatCount);
+    // 投递之后定时器可能马上在loop线程里到期并被回收，所以先取出序号
+    TimerId timerId(timer, timer->sequence());
     m_loop->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, timer));
-    return TimerId(timer, timer->sequence());
+    return timerId;
 }
 
 void TimerQueue::removeTimer(TimerId timerId)
@@ -59,47 +115,104 @@ void TimerQueue::doTimer()
 {
     m_loop->assertInLoopThread();
 
-    Timestamp now(Timestamp::now());
+    int64_t start = m_loop->statsEnabled() ? LoopStats::nowNs() : 0;
+    Timestamp now(m_loop->loopNow());
+    m_expired.clear();
+    m_wheel.expire(now, m_expired);
 
-    for (auto iter = m_timers.begin(); iter != m_timers.end();)
+    // 同一个槽位里的定时器没有顺序，按到期时间和添加顺序执行
+    std::sort(m_expired.begin(), m_expired.end(), [](const Timer *l, const Timer *r)
+              { return l->expiration() < r->expiration() ||
+                       (l->expiration() == r->expiration() && l->sequence() < r->sequence()); });
+
+    // 定时器回调里可能会增删定时器，被前面的回调删除的定时器不再执行
+    for (Timer *timer : m_expired)
     {
-        if (iter->second->expiration() <= now)
+        if (timer->m_state == Timer::kExpired)
+            timer->run();
+    }
+
+    reset(now);
+
+    if (start != 0)
+        m_loop->recordTimerStats(LoopStats::nowNs() - start);
+}
+
+Timestamp TimerQueue::earliestExpiration() const
+{
+    return m_wheel.earliestExpiration();
+}
+
+void TimerQueue::reset(Timestamp now)
+{
+    for (Timer *timer : m_expired)
+    {
+        if (timer->m_state == Timer::kExpired && timer->getRepeatCount() != 0)
         {
-            iter->second->run();
-            if (iter->second->getRepeatCount() == 0)
-            {
-                iter = m_timers.erase(iter);
-            }
-            else
-            {
-                ++iter;
-            }
+            timer->restart(now);
+            m_wheel.add(timer);
         }
         else
         {
-            break;
+            m_wheel.freeTimer(timer);
         }
     }
+    m_expired.clear();
+
+#ifndef _WIN32
+    // timerfd是一次性的，触发之后就解除了
+    m_armedExpiration = Timestamp::invalid();
+    Timestamp earliest = m_wheel.earliestExpiration();
+    if (earliest.valid())
+    {
+        resetTimerfd(earliest);
+    }
+#endif
 }
 
 void TimerQueue::addTimerInLoop(Timer *timer)
 {
     m_loop->assertInLoopThread();
-    insert(timer);
+    m_wheel.add(timer);
+
+#ifndef _WIN32
+    if (!m_armedExpiration.valid() || timer->expiration() < m_armedExpiration)
+    {
+        resetTimerfd(timer->expiration());
+    }
+#endif
+}
+
+Timer *TimerQueue::findTimer(TimerId timerId) const
+{
+    // 节点在时间轮析构之前不会释放，TimerId失效之后指针仍然可以访问，
+    // 节点被回收或者复用之后状态或者序号就对不上了
+    Timer *timer = timerId.m_timer;
+    if (timer == NULL || timer->sequence() != timerId.m_sequence)
+        return NULL;
+    if (timer->m_state != Timer::kPending && timer->m_state != Timer::kExpired)
+        return NULL;
+    return timer;
 }
 
 void TimerQueue::removeTimerInLoop(TimerId timerId)
 {
     m_loop->assertInLoopThread();
 
-    Timer *timer = timerId.m_timer;
-    for (auto iter = m_timers.begin(); iter != m_timers.end(); ++iter)
+    Timer *timer = findTimer(timerId);
+    if (timer == NULL)
+        return;
+
+    if (timer->m_state == Timer::kPending)
     {
-        if (iter->second == timer)
-        {
-            m_timers.erase(iter);
-            break;
-        }
+        // 不重新设置timerfd，提前触发一次也没有关系
+        m_wheel.remove(timer);
+        m_wheel.freeTimer(timer);
+    }
+    else
+    {
+        // 正在执行的到期定时器，等reset()时再回收
+        timer->m_state = Timer::kRemoved;
     }
 }
 
@@ -107,21 +220,30 @@ void TimerQueue::cancelTimerInLoop(TimerId timerId, bool off)
 {
     m_loop->assertInLoopThread();
 
-    Timer *timer = timerId.m_timer;
-    for (auto iter = m_timers.begin(); iter != m_timers.end(); ++iter)
+    Timer *timer = findTimer(timerId);
+    if (timer != NULL)
     {
-        if (iter->second == timer)
-        {
-            iter->second->cancel(off);
-            break;
-        }
+        timer->cancel(off);
     }
 }
 
-void TimerQueue::insert(Timer *timer)
+#ifndef _WIN32
+void TimerQueue::handleRead()
 {
     m_loop->assertInLoopThread();
-    bool earliestChanged = false;
-    Timestamp when = timer->expiration();
-    m_timers.insert(Entry(when, timer));
+    readTimerfd(m_timerfd);
+    doTimer();
+}
+
+void TimerQueue::resetTimerfd(Timestamp expiration)
+{
+    m_armedExpiration = expiration;
+    struct itimerspec newValue;
+    memset(&newValue, 0, sizeof newValue);
+    newValue.it_value = toTimespec(expiration);
+    if (::timerfd_settime(m_timerfd, TFD_TIMER_ABSTIME, &newValue, NULL) < 0)
+    {
+        LOG_SYSERROR("timerfd_settime()");
+    }
 }
+#endif
@@ -3,16 +3,20 @@
  *  Author:     xiebaoma
  *  Date:       2025-06-25
  *  Description:消息队列
+ *              定时器存放在分层时间轮里，增删都是O(1)，TimerId里保存定时器节点的指针和序号，
+ *              删除和取消时直接定位到节点，不需要查找
+ *              定时器的到期时间都是单调时钟(Clock::monotonicUs())，不受系统时间调整的影响
  */
 
 #pragma once
 
-#include <set>
 #include <vector>
+#include <memory>
 
 #include "../base/Timestamp.h"
 #include "../net/Callbacks.h"
 #include "../net/Channel.h"
+#include "../net/TimingWheel.h"
 
 namespace net
 {
@@ -26,9 +30,7 @@ namespace net
         TimerQueue(EventLoop *loop);
         ~TimerQueue();
 
-        // interval单位是微妙
-        TimerId addTimer(const TimerCallback &cb, Timestamp when, int64_t interval, int64_t repeatCount);
-
+        // interval单位是微妙，任意线程都可以调用
         TimerId addTimer(TimerCallback &&cb, Timestamp when, int64_t interval, int64_t repeatCount);
 
         void removeTimer(TimerId timerId);
@@ -38,24 +40,37 @@ namespace net
         // called when timerfd alarms
         void doTimer();
 
+        // 最早到期的定时器时间，没有定时器时返回Timestamp::invalid()，只能在loop线程调用
+        // 256毫秒以外的定时器返回的是它降到时间轮第0层的时间，比实际到期时间早
+        Timestamp earliestExpiration() const;
+
     private:
         TimerQueue(const TimerQueue &rhs) = delete;
         TimerQueue &operator=(const TimerQueue &rhs) = delete;
 
-        typedef std::pair<Timestamp, Timer *> Entry;
-        typedef std::set<Entry> TimerList;
-        typedef std::pair<Timer *, int64_t> ActiveTimer;
-        typedef std::set<ActiveTimer> ActiveTimerSet;
-
         void addTimerInLoop(Timer *timer);
         void removeTimerInLoop(TimerId timerId);
         void cancelTimerInLoop(TimerId timerId, bool off);
+        // timerId对应的定时器还在时间轮里或者正在执行，返回定时器节点，否则返回NULL
+        Timer *findTimer(TimerId timerId) const;
+        // 重复的定时器重新放回时间轮，其余的放回节点池
+        void reset(Timestamp now);
 
-        void insert(Timer *timer);
+#ifndef _WIN32
+        void handleRead();
+        void resetTimerfd(Timestamp expiration);
+#endif
 
     private:
         EventLoop *m_loop;
-        TimerList m_timers;
+        TimingWheel m_wheel;
+        std::vector<Timer *> m_expired; // 本次到期的定时器，复用避免每次分配内存
+
+#ifndef _WIN32
+        const int m_timerfd;
+        std::unique_ptr<Channel> m_timerfdChannel;
+        Timestamp m_armedExpiration; // timerfd当前设置的到期时间，无效表示没有设置
+#endif
     };
 
 }
@@ -0,0 +1,308 @@
+/*
+ *  Filename:   TimingWheel.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:分层时间轮
+ */
+
+#include "TimingWheel.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include "Timer.h"
+
+using namespace net;
+
+namespace
+{
+    int lowestBit(uint64_t value)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(value);
+#else
+        int bit = 0;
+        while ((value & 1) == 0)
+        {
+            value >>= 1;
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    // 位图里从bit开始(包括bit)的第一个置位，找不到返回-1
+    int findFirstSet(const uint64_t *words, int wordCount, int bit)
+    {
+        int word = bit / 64;
+        uint64_t mask = ~0ULL << (bit % 64);
+        for (; word < wordCount; ++word, mask = ~0ULL)
+        {
+            uint64_t bits = words[word] & mask;
+            if (bits != 0)
+                return word * 64 + lowestBit(bits);
+        }
+        return -1;
+    }
+}
+
+TimingWheel::TimingWheel(Timestamp now)
+    : m_currentTick(tickOf(now)),
+      m_size(0),
+      m_freeTimers(NULL)
+{
+    memset(m_slots, 0, sizeof m_slots);
+    memset(m_occupied, 0, sizeof m_occupied);
+}
+
+TimingWheel::~TimingWheel()
+{
+    // 节点池里的节点随内存块一起释放，单独new出来的节点要逐个释放
+    for (int level = 0; level < kLevels; ++level)
+    {
+        for (int slot = 0; slot < kSlots; ++slot)
+        {
+            Timer *timer = m_slots[level][slot];
+            while (timer != NULL)
+            {
+                Timer *next = timer->m_next;
+                if (!timer->m_pooled)
+                    delete timer;
+                timer = next;
+            }
+        }
+    }
+
+    while (m_freeTimers != NULL)
+    {
+        Timer *next = m_freeTimers->m_next;
+        if (!m_freeTimers->m_pooled)
+            delete m_freeTimers;
+        m_freeTimers = next;
+    }
+}
+
+Timer *TimingWheel::newTimer()
+{
+    if (m_freeTimers == NULL)
+    {
+        std::unique_ptr<Timer[]> chunk(new Timer[kPoolChunkSize]);
+        for (int i = kPoolChunkSize - 1; i >= 0; --i)
+        {
+            chunk[i].m_pooled = true;
+            chunk[i].m_next = m_freeTimers;
+            m_freeTimers = &chunk[i];
+        }
+        m_chunks.push_back(std::move(chunk));
+    }
+
+    Timer *timer = m_freeTimers;
+    m_freeTimers = timer->m_next;
+    timer->m_next = NULL;
+    return timer;
+}
+
+void TimingWheel::freeTimer(Timer *timer)
+{
+    // 先析构回调捕获的数据，不要等到节点被复用的时候
+    timer->m_callback = nullptr;
+    timer->m_state = Timer::kFree;
+    timer->m_prev = NULL;
+    timer->m_next = m_freeTimers;
+    m_freeTimers = timer;
+}
+
+void TimingWheel::add(Timer *timer)
+{
+    int64_t tick = tickOf(timer->expiration());
+    if (tick < m_currentTick)
+        tick = m_currentTick;
+
+    int64_t delta = tick - m_currentTick;
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (1LL << (kSlotBits * (level + 1))))
+        ++level;
+
+    int slot;
+    if (delta >= (1LL << (kSlotBits * kLevels)))
+    {
+        // 超出时间轮的范围，放在最高层最后转到的槽位，转到时重新放置
+        slot = static_cast<int>(((m_currentTick >> (kSlotBits * (kLevels - 1))) + kSlotMask) & kSlotMask);
+    }
+    else
+    {
+        slot = static_cast<int>((tick >> (kSlotBits * level)) & kSlotMask);
+    }
+
+    timer->m_state = Timer::kPending;
+    link(timer, level, slot);
+    ++m_size;
+}
+
+void TimingWheel::remove(Timer *timer)
+{
+    unlink(timer);
+    --m_size;
+}
+
+void TimingWheel::link(Timer *timer, int level, int slot)
+{
+    Timer *&head = m_slots[level][slot];
+    timer->m_level = level;
+    timer->m_slot = slot;
+    timer->m_prev = NULL;
+    timer->m_next = head;
+    if (head != NULL)
+        head->m_prev = timer;
+    head = timer;
+    m_occupied[level][slot / 64] |= 1ULL << (slot % 64);
+}
+
+void TimingWheel::unlink(Timer *timer)
+{
+    int level = timer->m_level;
+    int slot = timer->m_slot;
+    if (timer->m_prev != NULL)
+        timer->m_prev->m_next = timer->m_next;
+    else
+        m_slots[level][slot] = timer->m_next;
+    if (timer->m_next != NULL)
+        timer->m_next->m_prev = timer->m_prev;
+    timer->m_prev = NULL;
+    timer->m_next = NULL;
+
+    if (m_slots[level][slot] == NULL)
+        m_occupied[level][slot / 64] &= ~(1ULL << (slot % 64));
+}
+
+void TimingWheel::cascade(int level)
+{
+    int slot = static_cast<int>((m_currentTick >> (kSlotBits * level)) & kSlotMask);
+    Timer *timer = m_slots[level][slot];
+    m_slots[level][slot] = NULL;
+    m_occupied[level][slot / 64] &= ~(1ULL << (slot % 64));
+
+    while (timer != NULL)
+    {
+        Timer *next = timer->m_next;
+        --m_size;
+        add(timer);
+        timer = next;
+    }
+}
+
+void TimingWheel::expireSlot(int slot, int64_t nowUs, std::vector<Timer *> &expired)
+{
+    Timer *timer = m_slots[0][slot];
+    while (timer != NULL)
+    {
+        Timer *next = timer->m_next;
+        if (timer->expiration().microSecondsSinceEpoch() <= nowUs)
+        {
+            unlink(timer);
+            --m_size;
+            timer->m_state = Timer::kExpired;
+            expired.push_back(timer);
+        }
+        timer = next;
+    }
+}
+
+int TimingWheel::nextOccupied(int level, int start) const
+{
+    int slot = findFirstSet(m_occupied[level], kBitmapWords, start);
+    if (slot < 0 && start > 0)
+        slot = findFirstSet(m_occupied[level], kBitmapWords, 0);
+    return slot;
+}
+
+int64_t TimingWheel::nextCascadeTick(int level) const
+{
+    int shift = kSlotBits * level;
+    int current = static_cast<int>((m_currentTick >> shift) & kSlotMask);
+    int slot = nextOccupied(level, (current + 1) & kSlotMask);
+    if (slot < 0)
+        return -1;
+
+    // 当前位置的槽位在刚转过时已经降层，里面剩下的是下一圈的定时器
+    int distance = (slot - current) & kSlotMask;
+    if (distance == 0)
+        distance = kSlots;
+    return ((m_currentTick >> shift) + distance) << shift;
+}
+
+void TimingWheel::advanceTo(int64_t tick, std::vector<Timer *> &expired)
+{
+    while (m_currentTick < tick)
+    {
+        int slot = static_cast<int>(m_currentTick & kSlotMask);
+        if (m_slots[0][slot] != NULL)
+            expireSlot(slot, INT64_MAX, expired);
+
+        if (m_size == 0)
+        {
+            m_currentTick = tick;
+            return;
+        }
+
+        // 直接跳到下一个非空槽位或者下一次有定时器降层的位置，空槽位和空的降层都不用处理
+        int64_t next = tick;
+        int occupied = nextOccupied(0, (slot + 1) & kSlotMask);
+        if (occupied >= 0)
+        {
+            int distance = (occupied - slot) & kSlotMask;
+            if (distance == 0)
+                distance = kSlots;
+            next = std::min(next, m_currentTick + distance);
+        }
+        for (int level = 1; level < kLevels; ++level)
+        {
+            int64_t cascadeTick = nextCascadeTick(level);
+            if (cascadeTick >= 0)
+                next = std::min(next, cascadeTick);
+        }
+        m_currentTick = next;
+
+        // 从高层往低层降，高层降下来的定时器可能正好落在低层当前要降的槽位里
+        int top = 0;
+        while (top + 1 < kLevels && (m_currentTick & ((1LL << (kSlotBits * (top + 1))) - 1)) == 0)
+            ++top;
+        for (int level = top; level >= 1; --level)
+            cascade(level);
+    }
+}
+
+void TimingWheel::expire(Timestamp now, std::vector<Timer *> &expired)
+{
+    int64_t tick = tickOf(now);
+    if (tick > m_currentTick)
+        advanceTo(tick, expired);
+
+    // 当前tick的槽位里可能还有这一毫秒内稍后才到期的定时器，留到下次
+    int slot = static_cast<int>(m_currentTick & kSlotMask);
+    if (m_slots[0][slot] != NULL)
+        expireSlot(slot, now.microSecondsSinceEpoch(), expired);
+}
+
+Timestamp TimingWheel::earliestExpiration() const
+{
+    if (m_size == 0)
+        return Timestamp::invalid();
+
+    int64_t earliest = INT64_MAX;
+    int slot = nextOccupied(0, static_cast<int>(m_currentTick & kSlotMask));
+    if (slot >= 0)
+    {
+        for (Timer *timer = m_slots[0][slot]; timer != NULL; timer = timer->m_next)
+            earliest = std::min(earliest, timer->expiration().microSecondsSinceEpoch());
+    }
+
+    // 高层的定时器降层之前不知道精确的到期时间，用降层的时间代替，降层之后再精确计算
+    for (int level = 1; level < kLevels; ++level)
+    {
+        int64_t cascadeTick = nextCascadeTick(level);
+        if (cascadeTick >= 0)
+            earliest = std::min(earliest, cascadeTick * kTickUs);
+    }
+    return Timestamp(earliest);
+}
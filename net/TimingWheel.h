@@ -0,0 +1,88 @@
+/*
+ *  Filename:   TimingWheel.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:分层时间轮，4层、每层256个槽位，第0层每个槽位1毫秒，依次覆盖256毫秒、65秒、4.6小时和49天，
+ *              更远的定时器先放在最高层，转到时再重新放置
+ *              定时器节点带双向链表指针，插入和删除都是O(1)，高层槽位转到时把定时器降到下一层；
+ *              同一个槽位内不排序，取最早到期时间时扫描第一个非空槽位，得到精确的到期时间，
+ *              所以定时精度不受1毫秒槽位宽度的影响
+ *              定时器节点从节点池里分配，按块申请、用完放回，直到时间轮析构才释放，
+ *              已经失效的TimerId里的指针仍然指向有效内存，可以直接用序号判断是否失效
+ *              只能在loop线程里使用
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include "../base/Timestamp.h"
+
+namespace net
+{
+    class Timer;
+
+    class TimingWheel
+    {
+    public:
+        explicit TimingWheel(Timestamp now);
+        ~TimingWheel();
+
+        TimingWheel(const TimingWheel &rhs) = delete;
+        TimingWheel &operator=(const TimingWheel &rhs) = delete;
+
+        // 从节点池里取一个空闲节点
+        Timer *newTimer();
+        // 放回节点池，单独new出来的节点也由节点池接管
+        void freeTimer(Timer *timer);
+
+        // 按timer->expiration()放入时间轮，已经过期的放在当前槽位，下一次expire()时取出
+        void add(Timer *timer);
+        // timer必须在时间轮里
+        void remove(Timer *timer);
+
+        // 取出所有到期时间不晚于now的定时器，追加到expired后面
+        void expire(Timestamp now, std::vector<Timer *> &expired);
+
+        // 最早到期的时间，时间轮为空时返回Timestamp::invalid()
+        Timestamp earliestExpiration() const;
+
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+
+    private:
+        static const int kLevels = 4;
+        static const int kSlotBits = 8;
+        static const int kSlots = 1 << kSlotBits;
+        static const int kSlotMask = kSlots - 1;
+        static const int kBitmapWords = kSlots / 64;
+        static const int64_t kTickUs = 1000;
+        static const int kPoolChunkSize = 256;
+
+        static int64_t tickOf(Timestamp when) { return when.microSecondsSinceEpoch() / kTickUs; }
+
+        void link(Timer *timer, int level, int slot);
+        void unlink(Timer *timer);
+        // 第level层槽位转到当前位置，把里面的定时器重新放置到低层
+        void cascade(int level);
+        // 当前tick往前走到tick，经过的槽位里的定时器全部到期
+        void advanceTo(int64_t tick, std::vector<Timer *> &expired);
+        // 把slot里到期时间不晚于now的定时器取出来
+        void expireSlot(int slot, int64_t nowUs, std::vector<Timer *> &expired);
+        // 从start开始(包括start)环形查找第一个非空槽位，找不到返回-1
+        int nextOccupied(int level, int start) const;
+        // 第level层从当前位置之后第一个非空槽位转到(降层)时的tick，找不到返回-1
+        int64_t nextCascadeTick(int level) const;
+
+    private:
+        Timer *m_slots[kLevels][kSlots];
+        uint64_t m_occupied[kLevels][kBitmapWords]; // 非空槽位的位图，用来跳过空槽位
+        int64_t m_currentTick;                      // 还没有处理完的第一个tick
+        size_t m_size;
+
+        Timer *m_freeTimers;
+        std::vector<std::unique_ptr<Timer[]>> m_chunks;
+    };
+}
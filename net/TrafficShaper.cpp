@@ -0,0 +1,124 @@
+/*
+ *  Filename:   TrafficShaper.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:令牌桶和流量整形
+ */
+
+#include "TrafficShaper.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace net;
+
+TokenBucket::TokenBucket()
+    : m_rate(0),
+      m_capacity(0),
+      m_tokens(0),
+      m_lastUs(0)
+{
+}
+
+void TokenBucket::setRate(int64_t bytesPerSecond, int64_t burstUs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int64_t rate = bytesPerSecond > 0 ? bytesPerSecond : 0;
+    m_capacity = std::max(1.0, static_cast<double>(rate) * std::max<int64_t>(burstUs, 1) / 1e6);
+    // 新的速率从满桶开始，第一次使用时才开始计时
+    m_tokens = m_capacity;
+    m_lastUs = 0;
+    m_rate.store(rate, std::memory_order_relaxed);
+}
+
+void TokenBucket::refill(int64_t nowUs)
+{
+    // 共用的桶在几个loop线程里使用，各自的loopNow()有先后，时间倒退时不补令牌
+    if (m_lastUs == 0 || nowUs > m_lastUs)
+    {
+        if (m_lastUs != 0)
+        {
+            double added = static_cast<double>(nowUs - m_lastUs) * m_rate.load(std::memory_order_relaxed) / 1e6;
+            m_tokens = std::min(m_capacity, m_tokens + added);
+        }
+        m_lastUs = nowUs;
+    }
+}
+
+size_t TokenBucket::available(size_t maxBytes, int64_t nowUs)
+{
+    if (rate() == 0)
+        return maxBytes;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    refill(nowUs);
+    if (m_tokens < 1)
+        return 0;
+    return std::min(maxBytes, static_cast<size_t>(m_tokens));
+}
+
+int64_t TokenBucket::consume(size_t bytes, int64_t nowUs)
+{
+    int64_t rate = this->rate();
+    if (rate == 0)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    refill(nowUs);
+    m_tokens -= static_cast<double>(bytes);
+    if (m_tokens >= 0)
+        return 0;
+    return static_cast<int64_t>(ceil(-m_tokens * 1e6 / rate));
+}
+
+int64_t TokenBucket::delayUs(size_t bytes, int64_t nowUs)
+{
+    int64_t rate = this->rate();
+    if (rate == 0)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    refill(nowUs);
+    double needed = std::min(static_cast<double>(bytes), m_capacity);
+    if (m_tokens >= needed)
+        return 0;
+    return static_cast<int64_t>(ceil((needed - m_tokens) * 1e6 / rate));
+}
+
+TrafficShaper::TrafficShaper(int64_t readBytesPerSecond, int64_t writeBytesPerSecond)
+    : m_bytesRead(0),
+      m_bytesWritten(0),
+      m_readThrottles(0),
+      m_writeThrottles(0)
+{
+    setRates(readBytesPerSecond, writeBytesPerSecond);
+}
+
+void TrafficShaper::setRates(int64_t readBytesPerSecond, int64_t writeBytesPerSecond, int64_t burstUs)
+{
+    m_read.setRate(readBytesPerSecond, burstUs);
+    m_write.setRate(writeBytesPerSecond, burstUs);
+}
+
+int64_t TrafficShaper::onRead(size_t bytes, int64_t nowUs)
+{
+    m_bytesRead.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    int64_t delay = m_read.consume(bytes, nowUs);
+    if (delay > 0)
+        m_readThrottles.fetch_add(1, std::memory_order_relaxed);
+    return delay;
+}
+
+void TrafficShaper::onWrite(size_t bytes, int64_t nowUs)
+{
+    m_bytesWritten.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    m_write.consume(bytes, nowUs);
+}
+
+int64_t TrafficShaper::writeDelayUs(size_t bytes, int64_t nowUs)
+{
+    int64_t delay = m_write.delayUs(bytes, nowUs);
+    if (delay > 0)
+        m_writeThrottles.fetch_add(1, std::memory_order_relaxed);
+    return delay;
+}
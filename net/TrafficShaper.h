@@ -0,0 +1,94 @@
+/*
+ *  Filename:   TrafficShaper.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:流量整形，仿照Netty的GlobalTrafficShapingHandler，读写各用一个令牌桶限制速率
+ *              令牌按速率匀速产生，最多攒一个burst(默认10ms的量)，所以限速之后数据是每隔几毫秒放出一小块，
+ *              不会攒上一秒再一次发出去；读不能少读，读多了记成欠账，还清之前暂停读
+ *              TcpConnection自己有一个，TcpServer的所有连接共用一个，全局还有一个，三者同时生效
+ *              线程安全，共用的整形器在多个loop线程里同时使用
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+namespace net
+{
+    class TokenBucket
+    {
+    public:
+        static const int64_t kDefaultBurstUs = 10 * 1000;
+
+        TokenBucket();
+
+        // bytesPerSecond为0表示不限速，桶里最多攒burstUs微秒产生的令牌，至少一个字节
+        void setRate(int64_t bytesPerSecond, int64_t burstUs = kDefaultBurstUs);
+        int64_t rate() const
+        {
+            return m_rate.load(std::memory_order_relaxed);
+        }
+
+        // 现在可以取的字节数，最多maxBytes，有欠账时是0；不限速时返回maxBytes
+        size_t available(size_t maxBytes, int64_t nowUs);
+        // 取走bytes字节，令牌不够时记成欠账，返回欠账还清还要等多久(微秒)
+        int64_t consume(size_t bytes, int64_t nowUs);
+        // 攒够bytes字节还要等多久(微秒)，bytes超过一个burst时按一个burst算
+        int64_t delayUs(size_t bytes, int64_t nowUs);
+
+    private:
+        // 持有m_mutex时调用
+        void refill(int64_t nowUs);
+
+        std::mutex m_mutex;
+        std::atomic<int64_t> m_rate; // 不限速的桶不用加锁
+        double m_capacity;
+        double m_tokens;             // 负数是欠账
+        int64_t m_lastUs;
+    };
+
+    class TrafficShaper
+    {
+    public:
+        TrafficShaper(int64_t readBytesPerSecond = 0, int64_t writeBytesPerSecond = 0);
+        TrafficShaper(const TrafficShaper &rhs) = delete;
+        TrafficShaper &operator=(const TrafficShaper &rhs) = delete;
+
+        // 0表示不限速，随时可以调整，下一次读写时生效
+        void setRates(int64_t readBytesPerSecond, int64_t writeBytesPerSecond,
+                      int64_t burstUs = TokenBucket::kDefaultBurstUs);
+        bool shapingReads() const { return m_read.rate() > 0; }
+        bool shapingWrites() const { return m_write.rate() > 0; }
+        int64_t readRate() const { return m_read.rate(); }
+        int64_t writeRate() const { return m_write.rate(); }
+
+        // 读到了bytes字节，返回要暂停读多久(微秒)，0表示可以接着读
+        int64_t onRead(size_t bytes, int64_t nowUs);
+        // 现在最多可以写多少字节，不超过maxBytes
+        size_t writeQuota(size_t maxBytes, int64_t nowUs)
+        {
+            return m_write.available(maxBytes, nowUs);
+        }
+        // 写出了bytes字节
+        void onWrite(size_t bytes, int64_t nowUs);
+        // 攒够写bytes字节的令牌还要等多久(微秒)，记一次写限速
+        int64_t writeDelayUs(size_t bytes, int64_t nowUs);
+
+        // 统计：限速期间经过这个整形器读写的字节数，和因为限速暂停读、暂停写的次数
+        int64_t bytesRead() const { return m_bytesRead.load(std::memory_order_relaxed); }
+        int64_t bytesWritten() const { return m_bytesWritten.load(std::memory_order_relaxed); }
+        int64_t readThrottles() const { return m_readThrottles.load(std::memory_order_relaxed); }
+        int64_t writeThrottles() const { return m_writeThrottles.load(std::memory_order_relaxed); }
+
+    private:
+        TokenBucket m_read;
+        TokenBucket m_write;
+        std::atomic<int64_t> m_bytesRead;
+        std::atomic<int64_t> m_bytesWritten;
+        std::atomic<int64_t> m_readThrottles;
+        std::atomic<int64_t> m_writeThrottles;
+    };
+}
@@ -0,0 +1,168 @@
+/*
+ *  Filename:   ZeroCopyReaper.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:接管已经析构的连接还在等零拷贝完成通知的内存
+ */
+
+#include "ZeroCopyReaper.h"
+
+#include "../base/AsyncLog.h"
+#include "../base/Platform.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Sockets.h"
+
+using namespace net;
+
+const int64_t ZeroCopyReaper::kTimeoutUs;
+const int64_t ZeroCopyReaper::kHangupPollUs;
+
+ZeroCopyReaper::ZeroCopyReaper(EventLoop *loop)
+    : m_loop(loop),
+      m_nextId(0)
+{
+}
+
+ZeroCopyReaper::~ZeroCopyReaper()
+{
+    // loop析构时还没收齐通知的连接只能中止
+    while (!m_orphans.empty())
+        release(m_orphans.begin()->first, true);
+}
+
+void ZeroCopyReaper::adopt(int sockfd, std::unique_ptr<OutputQueue> pins)
+{
+    m_loop->assertInLoopThread();
+
+    int64_t id = ++m_nextId;
+    std::unique_ptr<Orphan> orphan(new Orphan);
+    orphan->m_fd = sockfd;
+    orphan->m_pins = std::move(pins);
+    orphan->m_hangup = false;
+    if (reap(orphan.get()))
+    {
+        sockets::close(sockfd);
+        return;
+    }
+
+    LOGD("ZeroCopyReaper adopt fd=%d pending=%d bytes=%d", sockfd,
+         static_cast<int>(orphan->m_pins->zeroCopyPending()), static_cast<int>(orphan->m_pins->zeroCopyPinnedBytes()));
+    // 完成通知放在错误队列里，只关心错误事件；对端关闭之后内核不管关心什么都会报告HUP
+    orphan->m_channel.reset(new Channel(m_loop, sockfd));
+    orphan->m_channel->setErrorCallback([this, id]()
+                                        { handleError(id); });
+    orphan->m_channel->setCloseCallback([this, id]()
+                                        { handleHangup(id); });
+    orphan->m_timeout = m_loop->runAfter(kTimeoutUs, [this, id]()
+                                         { handleTimeout(id); });
+    Channel *channel = orphan->m_channel.get();
+    m_orphans[id] = std::move(orphan);
+    channel->enableErrors();
+}
+
+size_t ZeroCopyReaper::pinnedBytes() const
+{
+    size_t bytes = 0;
+    for (const OrphanMap::value_type &entry : m_orphans)
+        bytes += entry.second->m_pins->zeroCopyPinnedBytes();
+    return bytes;
+}
+
+bool ZeroCopyReaper::reap(Orphan *orphan)
+{
+    orphan->m_pins->handleZeroCopyCompletions(orphan->m_fd);
+    return orphan->m_pins->zeroCopyPending() == 0;
+}
+
+void ZeroCopyReaper::handleError(int64_t id)
+{
+    OrphanMap::iterator it = m_orphans.find(id);
+    if (it == m_orphans.end() || it->second->m_hangup)
+        return;
+
+    Orphan *orphan = it->second.get();
+    bool done = reap(orphan);
+    int err = sockets::getSocketError(orphan->m_fd);
+    if (err != 0)
+    {
+        // 连接出错(一般是对端RST)，内核已经丢掉了发送队列，剩下的通知很快就到，继续等
+        LOGD("ZeroCopyReaper fd=%d SO_ERROR = %d", orphan->m_fd, err);
+    }
+    // Channel正在回调，不能在这里析构
+    if (done)
+        m_loop->queueInLoop([this, id]()
+                            { release(id, false); });
+}
+
+void ZeroCopyReaper::handleHangup(int64_t id)
+{
+    OrphanMap::iterator it = m_orphans.find(id);
+    if (it == m_orphans.end() || it->second->m_hangup)
+        return;
+
+    Orphan *orphan = it->second.get();
+    if (reap(orphan))
+    {
+        m_loop->queueInLoop([this, id]()
+                            { release(id, false); });
+        return;
+    }
+    orphan->m_hangup = true;
+    orphan->m_channel->disableAll();
+    m_loop->runAfter(kHangupPollUs, [this, id]()
+                     { pollHangup(id); });
+}
+
+void ZeroCopyReaper::pollHangup(int64_t id)
+{
+    OrphanMap::iterator it = m_orphans.find(id);
+    if (it == m_orphans.end())
+        return;
+
+    if (reap(it->second.get()))
+        release(id, false);
+    else
+        m_loop->runAfter(kHangupPollUs, [this, id]()
+                         { pollHangup(id); });
+}
+
+void ZeroCopyReaper::handleTimeout(int64_t id)
+{
+    OrphanMap::iterator it = m_orphans.find(id);
+    if (it == m_orphans.end())
+        return;
+
+    Orphan *orphan = it->second.get();
+    if (reap(orphan))
+    {
+        release(id, false);
+        return;
+    }
+    LOGW("ZeroCopyReaper fd=%d no zerocopy completion for %d bytes after %d seconds, abort",
+         orphan->m_fd, static_cast<int>(orphan->m_pins->zeroCopyPinnedBytes()), static_cast<int>(kTimeoutUs / 1000000));
+    release(id, true);
+}
+
+void ZeroCopyReaper::release(int64_t id, bool abort)
+{
+    OrphanMap::iterator it = m_orphans.find(id);
+    if (it == m_orphans.end())
+        return;
+
+    std::unique_ptr<Orphan> orphan = std::move(it->second);
+    m_orphans.erase(it);
+    m_loop->remove(orphan->m_timeout);
+    orphan->m_channel->disableAll();
+    orphan->m_channel->remove();
+    if (abort)
+    {
+        // SO_LINGER为0时close()发RST并立即丢掉发送队列，内核不再引用这些内存页
+        struct linger opt;
+        opt.l_onoff = 1;
+        opt.l_linger = 0;
+        ::setsockopt(orphan->m_fd, SOL_SOCKET, SO_LINGER, reinterpret_cast<const char *>(&opt), sizeof opt);
+    }
+    sockets::close(orphan->m_fd);
+    // orphan析构时m_pins里的内存还给BufferPool
+}
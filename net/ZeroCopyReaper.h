@@ -0,0 +1,71 @@
+/*
+ *  Filename:   ZeroCopyReaper.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:接管已经析构的连接还在等零拷贝完成通知的内存，每个loop一个，见EventLoop::zeroCopyReaper()
+ *              连接析构时把socket dup一份连同这些内存交过来，TcpConnection照常关闭自己的fd；
+ *              这里继续监听dup出来的fd的错误队列，收到通知才把对应的内存块还给BufferPool，全部收到后关闭fd，
+ *              对端这时才收到FIN；对端两个方向都关闭之后(HUP)改成定时检查，避免水平触发一直报告HUP
+ *              超过kTimeoutUs还没有收齐通知就发RST中止连接，内核丢掉发送队列之后再释放
+ *              只在所属的loop线程里使用
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+
+#include "OutputQueue.h"
+#include "TimerId.h"
+
+namespace net
+{
+    class Channel;
+    class EventLoop;
+
+    class ZeroCopyReaper
+    {
+    public:
+        // 等完成通知的最长时间，对端一直不读数据时到时间就中止连接
+        static const int64_t kTimeoutUs = 60 * 1000 * 1000;
+        // 对端关闭之后检查错误队列的间隔
+        static const int64_t kHangupPollUs = 10 * 1000;
+
+        explicit ZeroCopyReaper(EventLoop *loop);
+        ~ZeroCopyReaper();
+        ZeroCopyReaper(const ZeroCopyReaper &rhs) = delete;
+        ZeroCopyReaper &operator=(const ZeroCopyReaper &rhs) = delete;
+
+        // sockfd是连接socket dup出来的fd，之后归这里关闭；pins里是还没有收到完成通知的零拷贝发送
+        void adopt(int sockfd, std::unique_ptr<OutputQueue> pins);
+
+        // 还在等通知的socket数和内存字节数
+        size_t pendingSockets() const { return m_orphans.size(); }
+        size_t pinnedBytes() const;
+
+    private:
+        struct Orphan
+        {
+            int m_fd;
+            std::unique_ptr<Channel> m_channel;
+            std::unique_ptr<OutputQueue> m_pins;
+            TimerId m_timeout;
+            bool m_hangup; // 对端已经关闭，改成定时检查
+        };
+        typedef std::map<int64_t, std::unique_ptr<Orphan>> OrphanMap;
+
+        void handleError(int64_t id);
+        void handleHangup(int64_t id);
+        void pollHangup(int64_t id);
+        void handleTimeout(int64_t id);
+        // 收一遍完成通知，全部收到时返回true
+        bool reap(Orphan *orphan);
+        // abort为true时发RST中止连接，否则正常关闭
+        void release(int64_t id, bool abort);
+
+        EventLoop *m_loop;
+        OrphanMap m_orphans;
+        int64_t m_nextId;
+    };
+}
@@ -0,0 +1,120 @@
+/*
+ *  Filename:   AdaptiveReadBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:比较两种读socket的方式，socketpair一端写一批数据，另一端读到EAGAIN，消费者每次读完就全部取走
+ *              extrabuf：原来的readFd，可写空间不够时读进栈上64KB的extrabuf再append，多一次拷贝
+ *              adaptive：RecvSizePredictor预测大小，先准备好可写空间再直接读进缓冲区
+ *              small是每批200字节的请求，bulk是每批128KB的大块数据，mixed是先bulk再small，看缓冲区能不能缩回去
+ *  command:    g++ -O2 -pthread AdaptiveReadBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../net/ByteBuffer.h"
+#include "../net/RecvSizePredictor.h"
+
+using namespace net;
+
+const int kSmallRounds = 200 * 1000;
+const int kBulkRounds = 5 * 1000;
+const size_t kSmallSize = 200;
+const size_t kBulkSize = 128 * 1024;
+
+struct Result
+{
+    double nsPerRound;
+    double readsPerRound;
+    size_t capacity;
+};
+
+// 每一轮写size字节，再读到EAGAIN
+template <typename ReadFn>
+Result run(int rounds, size_t size, ByteBuffer *buffer, ReadFn readFn)
+{
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    int sndbuf = 4 * 1024 * 1024;
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+    ::fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    std::string payload(size, 'x');
+
+    long reads = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i)
+    {
+        size_t written = 0;
+        while (written < size)
+            written += ::write(fds[0], payload.data() + written, size - written);
+
+        size_t got = 0;
+        while (got < size)
+        {
+            int savedErrno = 0;
+            int32_t n = readFn(buffer, fds[1], &savedErrno);
+            if (n <= 0)
+                break;
+            ++reads;
+            got += n;
+            buffer->retrieveAll();
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    Result result;
+    result.nsPerRound = ns / rounds;
+    result.readsPerRound = static_cast<double>(reads) / rounds;
+    result.capacity = buffer->internalCapacity();
+    return result;
+}
+
+void report(const char *workload, const char *name, const Result &result)
+{
+    std::cout << std::left << std::setw(8) << workload << std::setw(10) << name
+              << std::setw(10) << result.nsPerRound << " ns/round  "
+              << std::setw(6) << result.readsPerRound << " reads/round  capacity "
+              << result.capacity / 1024.0 << " KB" << std::endl;
+}
+
+int main()
+{
+    std::cout << std::fixed << std::setprecision(1);
+
+    auto extrabuf = [](ByteBuffer *buffer, int fd, int *savedErrno)
+    { return buffer->readFd(fd, savedErrno); };
+
+    RecvSizePredictor predictor;
+    auto adaptive = [&predictor](ByteBuffer *buffer, int fd, int *savedErrno)
+    {
+        size_t attempted = 0;
+        int32_t n = buffer->readFd(fd, savedErrno, predictor.nextSize(), &attempted);
+        // 和TcpConnection一样每轮只调整一次，读满了要的量按不少于预测值算
+        if (n > 0)
+            predictor.record(static_cast<size_t>(n) >= attempted ? std::max(static_cast<size_t>(n), predictor.nextSize())
+                                                                 : static_cast<size_t>(n));
+        return n;
+    };
+
+    {
+        ByteBuffer a, b;
+        report("small", "extrabuf", run(kSmallRounds, kSmallSize, &a, extrabuf));
+        report("small", "adaptive", run(kSmallRounds, kSmallSize, &b, adaptive));
+    }
+    {
+        ByteBuffer a, b;
+        predictor = RecvSizePredictor(RecvSizePredictor::kDefaultMinimum, RecvSizePredictor::kDefaultInitial, 256 * 1024);
+        report("bulk", "extrabuf", run(kBulkRounds, kBulkSize, &a, extrabuf));
+        report("bulk", "adaptive", run(kBulkRounds, kBulkSize, &b, adaptive));
+        report("mixed", "extrabuf", run(kSmallRounds, kSmallSize, &a, extrabuf));
+        report("mixed", "adaptive", run(kSmallRounds, kSmallSize, &b, adaptive));
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ *  Filename:   AutoCorkBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:比较一次handleRead里回复多条小消息时，直接写和自动合并写(auto-cork)的写系统调用次数和耗时
+ *              连接是socketpair，对端在测试线程里一次写入一批请求(每条8字节)，再读回同样条数的应答
+ *              服务端在消息回调里对每条请求send一条32字节的应答
+ *              direct：原来的方式，输出队列为空时每次send都直接write
+ *              cork：setAutoCork(true)，本轮事件循环结束时一次writev
+ *              flush：cork模式下每批最后一条应答之后调用flush()，这批应答立刻写出，不等本轮结束
+ *  command:    g++ -O2 -pthread AutoCorkBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../base/CountDownLatch.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/TcpConnection.h"
+
+using namespace net;
+
+const int kRounds = 20000;
+const int kBatch = 32;
+const size_t kRequestSize = 8;
+const size_t kResponseSize = 32;
+
+enum Mode
+{
+    kDirect,
+    kCork,
+    kFlush
+};
+
+struct Result
+{
+    double ms;
+    int64_t corkedSends;
+    int64_t flushes;
+    int64_t saved;
+    bool ok;
+};
+
+// 对端：每轮写一批请求，读回这批应答，应答里带着请求的序号
+bool client(int fd)
+{
+    std::vector<char> requests(kRequestSize * kBatch);
+    std::vector<char> responses(kResponseSize * kBatch);
+    for (int round = 0; round < kRounds; ++round)
+    {
+        for (int i = 0; i < kBatch; ++i)
+        {
+            int32_t seq = round * kBatch + i;
+            memset(&requests[i * kRequestSize], 0, kRequestSize);
+            memcpy(&requests[i * kRequestSize], &seq, sizeof seq);
+        }
+        if (::write(fd, requests.data(), requests.size()) != static_cast<ssize_t>(requests.size()))
+            return false;
+
+        size_t got = 0;
+        while (got < responses.size())
+        {
+            ssize_t n = ::read(fd, responses.data() + got, responses.size() - got);
+            if (n <= 0)
+                return false;
+            got += n;
+        }
+        for (int i = 0; i < kBatch; ++i)
+        {
+            int32_t seq = 0;
+            memcpy(&seq, &responses[i * kResponseSize], sizeof seq);
+            if (seq != round * kBatch + i)
+                return false;
+        }
+    }
+    return true;
+}
+
+Result run(EventLoop *loop, Mode mode)
+{
+    Result result = {0, 0, 0, 0, false};
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        return result;
+    ::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    TcpConnectionPtr conn;
+    CountDownLatch established(1);
+    loop->runInLoop([&]()
+                    {
+        conn.reset(new TcpConnection(loop, "bench", fds[0], InetAddress(), InetAddress()));
+        conn->setConnectionCallback(defaultConnectionCallback);
+        conn->setMessageCallback([mode](const TcpConnectionPtr &c, ByteBuffer *buf, Timestamp)
+                                 {
+            char response[kResponseSize] = {0};
+            while (buf->readableBytes() >= kRequestSize)
+            {
+                memcpy(response, buf->peek(), sizeof(int32_t));
+                buf->retrieve(kRequestSize);
+                c->send(response, kResponseSize);
+            }
+            if (mode == kFlush)
+                c->flush(); });
+        conn->setAutoCork(mode != kDirect);
+        conn->connectEstablished();
+        established.countDown(); });
+    established.wait();
+
+    auto start = std::chrono::steady_clock::now();
+    result.ok = client(fds[1]);
+    result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    CountDownLatch finished(1);
+    loop->runInLoop([&]()
+                    {
+        result.corkedSends = conn->corkedSends();
+        result.flushes = conn->corkFlushes();
+        result.saved = conn->writeCallsSaved();
+        conn->connectDestroyed();
+        conn.reset();
+        finished.countDown(); });
+    finished.wait();
+    ::close(fds[1]);
+    return result;
+}
+
+void print(const char *name, const Result &r)
+{
+    std::cout << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << r.ms << std::setw(12) << r.corkedSends << std::setw(10) << r.flushes
+              << std::setw(10) << r.saved << (r.ok ? "" : "  response mismatch") << std::endl;
+}
+
+int main()
+{
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+
+    std::cout << kRounds << " rounds x " << kBatch << " requests, " << kResponseSize << " byte responses" << std::endl;
+    std::cout << std::left << std::setw(8) << "mode" << std::right << std::setw(10) << "ms"
+              << std::setw(12) << "corked" << std::setw(10) << "flushes" << std::setw(10) << "saved" << std::endl;
+    run(loop, kDirect);
+    print("direct", run(loop, kDirect));
+    print("cork", run(loop, kCork));
+    print("flush", run(loop, kFlush));
+
+    loopThread.stopLoop();
+    return 0;
+}
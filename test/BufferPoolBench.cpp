@@ -0,0 +1,102 @@
+/*
+ *  Filename:   BufferPoolBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:模拟连接频繁建立和断开时缓冲区的申请和释放
+ *              每个"连接"有一个输入缓冲区和一个输出缓冲区，写入一个小请求和一个响应，
+ *              每8个连接有一个响应比较大(64KB)，需要扩容
+ *              vector：原来的实现，std::vector<char>，扩容用resize，会逐字节清零
+ *              pool：BufferPool，分别测单线程和4个线程，统计线程缓存的命中率
+ *  command:    g++ -O2 -pthread BufferPoolBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include "../net/ByteBuffer.h"
+#include "../net/BufferPool.h"
+
+using namespace net;
+
+const int kConnections = 1000 * 1000;
+const int kThreads = 4;
+const size_t kRequestSize = 200;
+const size_t kResponseSize = 1000;
+const size_t kLargeResponseSize = 64 * 1024;
+
+// 原来ByteBuffer的存储方式
+class VectorBuffer
+{
+public:
+    VectorBuffer() : m_buffer(ByteBuffer::kCheapPrepend + ByteBuffer::kInitialSize), m_writerIndex(ByteBuffer::kCheapPrepend) {}
+
+    void append(const char *data, size_t len)
+    {
+        if (m_buffer.size() - m_writerIndex < len)
+            m_buffer.resize(m_writerIndex + len);
+        std::copy(data, data + len, m_buffer.begin() + m_writerIndex);
+        m_writerIndex += len;
+    }
+
+private:
+    std::vector<char> m_buffer;
+    size_t m_writerIndex;
+};
+
+template <typename Buffer>
+void churn(int connections, const std::string &payload)
+{
+    for (int i = 0; i < connections; ++i)
+    {
+        Buffer input;
+        Buffer output;
+        input.append(payload.data(), kRequestSize);
+        output.append(payload.data(), (i & 7) == 0 ? kLargeResponseSize : kResponseSize);
+    }
+}
+
+template <typename Buffer>
+double run(int threads, const std::string &payload)
+{
+    int perThread = kConnections / threads;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+        workers.emplace_back([perThread, &payload]()
+                             { churn<Buffer>(perThread, payload); });
+    for (std::thread &worker : workers)
+        worker.join();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / kConnections;
+}
+
+void report(const char *name, int threads, double ns)
+{
+    std::cout << std::left << std::setw(8) << name << std::setw(10) << (std::to_string(threads) + " thread")
+              << std::setw(8) << ns << " ns/connection";
+}
+
+int main()
+{
+    std::cout << std::fixed << std::setprecision(1);
+    std::string payload(kLargeResponseSize, 'x');
+
+    for (int threads : {1, kThreads})
+    {
+        report("vector", threads, run<VectorBuffer>(threads, payload));
+        std::cout << std::endl;
+
+        BufferPool::Stats before = BufferPool::stats();
+        double ns = run<ByteBuffer>(threads, payload);
+        BufferPool::Stats after = BufferPool::stats();
+        uint64_t allocations = after.allocations - before.allocations;
+        uint64_t hits = after.threadCacheHits - before.threadCacheHits;
+        report("pool", threads, ns);
+        std::cout << "  hit rate " << std::setprecision(4) << 100.0 * hits / allocations << "%"
+                  << std::setprecision(1) << ", system allocations " << after.systemAllocations - before.systemAllocations
+                  << ", reserved " << after.reservedBytes / 1024 << " KB" << std::endl;
+    }
+    return 0;
+}
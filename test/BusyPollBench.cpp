@@ -0,0 +1,69 @@
+/*
+ *  Filename:   BusyPollBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:对比普通模式和忙轮询模式下跨线程投递任务的延迟，
+ *              每次投递之间间隔一段时间，让loop回到等待状态，模拟低负载的请求/响应流量，
+ *              忙轮询需要loop线程独占一个核，在单核机器上测出来的数据没有意义
+ *  command:    g++ -O2 -pthread BusyPollBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ *              ./bench [spinUs] [gapUs]
+ */
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+
+using namespace net;
+
+const int kSamples = 20000;
+
+void bench(int64_t spinUs, int64_t gapUs)
+{
+    EventLoopThread thread([spinUs](EventLoop *loop)
+                           { loop->setBusyPoll(spinUs); });
+    EventLoop *loop = thread.startLoop();
+
+    std::vector<int64_t> latencies;
+    latencies.reserve(kSamples);
+    for (int i = 0; i < kSamples; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(gapUs));
+
+        std::atomic<int64_t> done(0);
+        auto start = std::chrono::steady_clock::now();
+        loop->queueInLoop([&done]()
+                          { done.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release); });
+        while (done.load(std::memory_order_acquire) == 0)
+        {
+        }
+        int64_t ns = done.load() - start.time_since_epoch().count();
+        latencies.push_back(ns / 1000);
+    }
+
+    EventLoop::BusyPollStats stats = loop->busyPollStats();
+    thread.stopLoop();
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "spin: " << spinUs << "us, gap: " << gapUs << "us"
+              << ", latency p50: " << latencies[kSamples / 2] << "us"
+              << ", p99: " << latencies[kSamples * 99 / 100] << "us"
+              << ", max: " << latencies.back() << "us"
+              << ", spins: " << stats.spins << ", hits: " << stats.hits
+              << ", spin time: " << stats.spinMicroSeconds / 1000 << "ms" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t spinUs = argc > 1 ? atoll(argv[1]) : 200;
+    int64_t gapUs = argc > 2 ? atoll(argv[2]) : 50;
+
+    bench(0, gapUs);
+    bench(spinUs, gapUs);
+
+    return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ *  Filename:   ByteSearchBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:ByteSearch各个实现的正确性和速度
+ *              先用随机数据和std::search/标量查找对比每种实现的结果(各种长度和对齐，目标落在向量块边界上)
+ *              再测查找速度：64KB数据里找末尾的CRLF、找"\r\n\r\n"、找分隔字节，和std::search对比
+ *              最后模拟一个8KB的包分成64字节陆续到达，每次到达都找一次CRLF，比较从头找和接着上次的位置找
+ *  command:    g++ -O2 -pthread ByteSearchBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include "../net/ByteBuffer.h"
+#include "../net/ByteSearch.h"
+
+using namespace net;
+
+const ByteSearch::Implementation kImpls[] = {ByteSearch::kScalar, ByteSearch::kSse2, ByteSearch::kAvx2};
+const char *const kImplNames[] = {"scalar", "sse2", "avx2"};
+
+const char *referenceFind(const std::string &hay, size_t from, const char *needle, size_t len)
+{
+    const char *begin = hay.data() + from;
+    const char *end = hay.data() + hay.size();
+    const char *found = std::search(begin, end, needle, needle + len);
+    return found == end && len > 0 ? nullptr : found;
+}
+
+bool verify(std::mt19937 &rng)
+{
+    // 字母表很小，候选位置多，容易碰到部分匹配
+    const char alphabet[] = "ab\r\n";
+    const char *needles[] = {"\r\n", "\r\n\r\n", "aab", "ba\r\nab", "abababababababababababababababababab\r"};
+    const char set[] = " \t;,";
+    bool ok = true;
+    for (int round = 0; round < 20000 && ok; ++round)
+    {
+        std::string hay(rng() % 200, 'x');
+        for (char &c : hay)
+            c = (rng() % 4 == 0) ? alphabet[rng() % 4] : static_cast<char>('c' + rng() % 20);
+        if (rng() % 3 == 0 && !hay.empty())
+            hay[rng() % hay.size()] = set[rng() % 4];
+        size_t from = hay.empty() ? 0 : rng() % hay.size();
+        const char *begin = hay.data() + from;
+        const char *end = hay.data() + hay.size();
+
+        const char *crlf = referenceFind(hay, from, "\r\n", 2);
+        const char *needle = needles[rng() % 5];
+        const char *sub = referenceFind(hay, from, needle, strlen(needle));
+        const char *any = std::find_first_of(begin, end, set, set + 4);
+        any = any == end ? nullptr : any;
+
+        for (ByteSearch::Implementation impl : kImpls)
+        {
+            if (!ByteSearch::setImplementation(impl))
+                continue;
+            ok &= ByteSearch::findCRLF(begin, end) == crlf;
+            ok &= ByteSearch::find(begin, end, needle, strlen(needle)) == sub;
+            ok &= ByteSearch::findAnyOf(begin, end, set, 4) == any;
+        }
+    }
+    return ok;
+}
+
+template <typename Fn>
+double measure(int iterations, Fn fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    const char *sink = nullptr;
+    for (int i = 0; i < iterations; ++i)
+    {
+        sink = fn();
+        asm volatile("" : : "r"(sink) : "memory");
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+int main()
+{
+    std::mt19937 rng(12345);
+    std::cout << "detected " << ByteSearch::implementationName() << std::endl;
+    std::cout << (verify(rng) ? "PASS" : "FAIL") << " all implementations match std::search" << std::endl;
+
+    // 64KB可见字符，目标都在最后
+    std::string hay(64 * 1024, 'x');
+    for (char &c : hay)
+        c = static_cast<char>('a' + rng() % 26);
+    hay.replace(hay.size() - 8, 8, "\r\n\r\n;\r\n.");
+    const char *begin = hay.data();
+    const char *end = begin + hay.size();
+    const int kIterations = 20000;
+
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << std::left << std::setw(10) << "impl" << std::setw(12) << "CRLF" << std::setw(12) << "CRLFCRLF"
+              << std::setw(12) << "anyOf" << " (ns per 64KB)" << std::endl;
+    std::cout << std::setw(10) << "std" << std::setw(12)
+              << measure(kIterations, [&]
+                         { return std::search(begin, end, "\r\n", "\r\n" + 2); })
+              << std::setw(12)
+              << measure(kIterations, [&]
+                         { return std::search(begin, end, "\r\n\r\n", "\r\n\r\n" + 4); })
+              << std::setw(12)
+              << measure(kIterations, [&]
+                         { return std::find_first_of(begin, end, ";,\t", ";,\t" + 3); })
+              << std::endl;
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!ByteSearch::setImplementation(kImpls[i]))
+            continue;
+        std::cout << std::setw(10) << kImplNames[i] << std::setw(12)
+                  << measure(kIterations, [&]
+                             { return ByteSearch::findCRLF(begin, end); })
+                  << std::setw(12)
+                  << measure(kIterations, [&]
+                             { return ByteSearch::find(begin, end, "\r\n\r\n", 4); })
+                  << std::setw(12)
+                  << measure(kIterations, [&]
+                             { return ByteSearch::findAnyOf(begin, end, ";,\t", 3); })
+                  << std::endl;
+    }
+
+    // 64KB的短行(平均40字节)，一行一行地找
+    std::string lines;
+    while (lines.size() < 64 * 1024)
+    {
+        lines.append(20 + rng() % 40, 'h');
+        lines += "\r\n";
+    }
+    const char *linesEnd = lines.data() + lines.size();
+    std::cout << "short lines (ns per 64KB):";
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!ByteSearch::setImplementation(kImpls[i]))
+            continue;
+        std::cout << "  " << kImplNames[i] << " " << measure(kIterations / 4, [&]
+                                                      {
+            const char *p = lines.data();
+            const char *crlf = nullptr;
+            while ((crlf = ByteSearch::findCRLF(p, linesEnd)) != nullptr)
+                p = crlf + 2;
+            return p; });
+    }
+    std::cout << std::endl;
+
+    // 同样的短行里找"\r\n\r\n"，像在一个很大的HTTP头里找头部的结尾，首字节\r频繁出现
+    lines += "\r\n";
+    linesEnd = lines.data() + lines.size();
+    std::cout << "header end (ns per 64KB):  std " << measure(kIterations / 4, [&]
+                                                           { return std::search(static_cast<const char *>(lines.data()), linesEnd, "\r\n\r\n", "\r\n\r\n" + 4); });
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!ByteSearch::setImplementation(kImpls[i]))
+            continue;
+        std::cout << "  " << kImplNames[i] << " " << measure(kIterations / 4, [&]
+                                                      { return ByteSearch::find(lines.data(), linesEnd, "\r\n\r\n", 4); });
+    }
+    std::cout << std::endl;
+
+    // 8KB的一行分成128次到达，每次到达都找一次行尾
+    ByteSearch::setImplementation(ByteSearch::kAvx2) || ByteSearch::setImplementation(ByteSearch::kSse2);
+    std::string line(8 * 1024 - 2, 'y');
+    line += "\r\n";
+    const size_t kPiece = 64;
+    double rescan = measure(2000, [&]
+                            {
+        ByteBuffer buffer;
+        const char *found = nullptr;
+        for (size_t off = 0; off < line.size() && found == nullptr; off += kPiece)
+        {
+            buffer.append(line.data() + off, kPiece);
+            found = buffer.findCRLF();
+        }
+        return found; });
+    double resume = measure(2000, [&]
+                            {
+        ByteBuffer buffer;
+        size_t scanned = 0;
+        const char *found = nullptr;
+        for (size_t off = 0; off < line.size() && found == nullptr; off += kPiece)
+        {
+            buffer.append(line.data() + off, kPiece);
+            found = buffer.findCRLF(&scanned);
+        }
+        return found; });
+    std::cout << "8KB line in 64B pieces: rescan " << rescan << " ns, resume " << resume << " ns" << std::endl;
+    return 0;
+}
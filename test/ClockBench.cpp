@@ -0,0 +1,89 @@
+/*
+ *  Filename:   ClockBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:各种取时间方式的单次调用开销
+ *              Timestamp::now()是墙上时间(gettimeofday)，monotonic是CLOCK_MONOTONIC，
+ *              coarse是CLOCK_MONOTONIC_COARSE，tsc是校准后的TSC，loopNow是EventLoop每轮缓存的值
+ *              同时检查TSC换算出来的时间和CLOCK_MONOTONIC的偏差
+ *  command:    g++ -O2 -pthread ClockBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include "../base/Clock.h"
+#include "../base/CountDownLatch.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+
+using namespace net;
+
+const int kCalls = 10 * 1000 * 1000;
+
+// 把结果累加起来输出，防止调用被优化掉
+volatile int64_t g_sink;
+
+template <typename F>
+void bench(const char *name, F f)
+{
+    int64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kCalls; ++i)
+        sum += f();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / kCalls;
+    g_sink = sum;
+    std::cout << std::left << std::setw(16) << name << std::setw(8) << ns << " ns/call" << std::endl;
+}
+
+int main()
+{
+    std::cout << std::fixed << std::setprecision(1);
+
+    bench("Timestamp::now", []()
+          { return Timestamp::now().microSecondsSinceEpoch(); });
+    bench("monotonic", []()
+          { return Clock::monotonicNs(); });
+    bench("coarse", []()
+          { return Clock::monotonicCoarseUs(); });
+
+    if (Clock::enableTsc(true))
+    {
+        bench("tsc", []()
+              { return Clock::fastNowNs(); });
+
+        // CLOCK_MONOTONIC前后各读一次TSC，和中点比较，看两者之间的最大偏差；
+        // 两次TSC相隔超过1微秒说明中途被调度出去了，这次采样不算
+        int64_t maxDiff = 0;
+        auto end = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (std::chrono::steady_clock::now() < end)
+        {
+            int64_t before = Clock::fastNowNs();
+            int64_t monotonic = Clock::monotonicNs();
+            int64_t after = Clock::fastNowNs();
+            if (after - before > 1000)
+                continue;
+            int64_t diff = before + (after - before) / 2 - monotonic;
+            maxDiff = std::max(maxDiff, diff < 0 ? -diff : diff);
+        }
+        std::cout << "tsc vs monotonic max deviation over 1s: " << maxDiff << " ns" << std::endl;
+        Clock::enableTsc(false);
+    }
+    else
+    {
+        std::cout << "tsc             not supported on this CPU" << std::endl;
+    }
+
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+    CountDownLatch done(1);
+    loop->runInLoop([loop, &done]()
+                    {
+        bench("loopNow", [loop]()
+              { return loop->loopNow(); });
+        done.countDown(); });
+    done.wait();
+    loopThread.stopLoop();
+    return 0;
+}
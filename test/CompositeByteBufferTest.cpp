@@ -0,0 +1,135 @@
+/*
+ *  Filename:   CompositeByteBufferTest.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:测试CompositeByteBuffer
+ *              append：大块数据按块串起来，跨块读整数
+ *              slice：视图共享内存块，引用计数随视图增减，原缓冲区析构后视图仍然可用
+ *              frame：用很小的块切包，包跨越块边界时readSlice也不拷贝
+ *              io：socketpair上readFd/writeFd，writev一次写出多段
+ *  command:    g++ -O2 -pthread CompositeByteBufferTest.cpp ../base/*.cpp ../net/*.cpp -o test
+ */
+
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../net/BufferPool.h"
+#include "../net/CompositeByteBuffer.h"
+#include "TestConnection.h"
+
+using namespace net;
+
+std::string pattern(size_t len)
+{
+    std::string s(len, '\0');
+    for (size_t i = 0; i < len; ++i)
+        s[i] = static_cast<char>('a' + i % 26);
+    return s;
+}
+
+int main()
+{
+    bool ok = true;
+
+    {
+        CompositeByteBuffer buf;
+        std::string data = pattern(100 * 1000);
+        buf.append(data);
+        buf.appendInt32(0x12345678);
+        ok &= check("large append spans chunks", buf.segmentCount() > 1 && buf.readableBytes() == data.size() + 4);
+        ok &= check("content preserved", buf.retrieveAsString(data.size()) == data);
+        ok &= check("int read", buf.readInt32() == 0x12345678 && buf.empty());
+    }
+
+    {
+        CompositeByteBuffer buf(256);
+        buf.append(pattern(1000));
+        BufferChunk *first = buf.segment(0).m_chunk;
+        CompositeByteBuffer view = buf.slice(10, 500);
+        ok &= check("slice content", view.toString() == pattern(1000).substr(10, 500));
+        ok &= check("slice shares chunk", view.segment(0).m_chunk == first && first->refCount() == 2);
+        ok &= check("slice out of range", buf.slice(900, 200).empty());
+
+        CompositeByteBuffer copy(view);
+        ok &= check("copy retains", first->refCount() == 3);
+        copy.release();
+        ok &= check("release drops reference", first->refCount() == 2 && copy.empty());
+
+        buf.retrieveAll();
+        ok &= check("view outlives source", view.toString() == pattern(1000).substr(10, 500));
+    }
+
+    {
+        // 每个包是4字节长度加包体，块很小，几乎每个包都跨块
+        CompositeByteBuffer input(256);
+        std::string body = pattern(300);
+        for (int i = 0; i < 10; ++i)
+        {
+            input.appendInt32(static_cast<int32_t>(body.size()));
+            input.append(body);
+        }
+
+        int frames = 0;
+        bool same = true;
+        bool shared = true;
+        while (input.readableBytes() >= sizeof(int32_t))
+        {
+            int32_t len = input.peekInt32();
+            if (input.readableBytes() < sizeof(int32_t) + len)
+                break;
+            input.retrieve(sizeof(int32_t));
+            CompositeByteBuffer frame = input.readSlice(len);
+            same &= frame.toString() == body;
+            shared &= frame.segmentCount() > 1 || frame.contiguous(len) != nullptr;
+            ++frames;
+        }
+        ok &= check("frames across chunks", frames == 10 && same && shared && input.empty());
+        ok &= check("find across chunks", [] {
+            CompositeByteBuffer buf(128);
+            buf.append(pattern(200));
+            buf.append("\n", 1);
+            return buf.find('\n') == 200 && buf.find('a', 1) == 26 && buf.find('#') == -1;
+        }());
+    }
+
+    {
+        int fds[2];
+        ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        CompositeByteBuffer out(512);
+        std::string data = pattern(5000);
+        out.append(data);
+        CompositeByteBuffer header;
+        header.append("HEAD", 4);
+        header.append(std::move(out));
+        int savedErrno = 0;
+        int32_t written = header.writeFd(fds[0], &savedErrno);
+        ok &= check("writev all segments", written == static_cast<int32_t>(data.size() + 4) && header.empty());
+
+        CompositeByteBuffer in(1024);
+        size_t total = 0;
+        while (total < data.size() + 4)
+        {
+            int32_t n = in.readFd(fds[1], &savedErrno);
+            if (n <= 0)
+                break;
+            total += n;
+        }
+        ok &= check("readFd", in.retrieveAllAsString() == "HEAD" + data);
+
+        // 当前块剩下的空间够读时不申请备用块
+        CompositeByteBuffer small(1024);
+        ::write(fds[0], data.data(), 100);
+        uint64_t before = BufferPool::threadStats().allocations;
+        small.readFd(fds[1], &savedErrno);
+        ::write(fds[0], data.data(), 100);
+        small.readFd(fds[1], &savedErrno, 200);
+        ok &= check("readFd spare only when needed", BufferPool::threadStats().allocations - before == 1 &&
+                                                         small.retrieveAllAsString() == data.substr(0, 100) + data.substr(0, 100));
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    std::cout << (ok ? "all passed" : "some failed") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+/*
+ *  Filename:   ConnectionTimeoutTest.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:测试TcpConnection的空闲、读、写超时，连接都是socketpair，对端在测试线程里直接读写
+ *              idle：不收发数据的连接在超时后被关闭；一直有数据的连接不会被关闭
+ *              read：设置了超时回调时只调用回调，不关闭连接，回调之后重新计时
+ *              write：对端不读，输出缓冲区一直非空，超时后被关闭
+ *  command:    g++ -O2 -pthread ConnectionTimeoutTest.cpp ../base/*.cpp ../net/*.cpp -o test
+ */
+
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/TcpConnection.h"
+#include "TestConnection.h"
+
+using namespace net;
+
+const int64_t kTimeoutUs = 100 * 1000;
+
+int main()
+{
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+    bool ok = true;
+
+    // 空闲连接：超时后关闭，只计一次
+    TestConnection idle;
+    establish(loop, &idle, [](const TcpConnectionPtr &c)
+              { c->setIdleTimeout(kTimeoutUs); });
+    // 活跃连接：每20毫秒发一次数据，持续3个超时周期
+    TestConnection active;
+    establish(loop, &active, [](const TcpConnectionPtr &c)
+              { c->setIdleTimeout(kTimeoutUs); });
+    for (int i = 0; i < 15; ++i)
+    {
+        ::write(active.peerfd, "x", 1);
+        ::usleep(20 * 1000);
+    }
+    std::cout << "idle connection closed after " << idle.closedAfterUs / 1000.0 << " ms" << std::endl;
+    ok &= check("idle connection closed", idle.closedAfterUs >= kTimeoutUs && idle.closedAfterUs < kTimeoutUs * 2);
+    ok &= check("active connection kept", active.closedAfterUs < 0);
+    ok &= check("idle timeout counted once", loop->timeoutCount(kIdleTimeout) == 1);
+    destroy(loop, &idle);
+    destroy(loop, &active);
+
+    // 读超时回调：不关闭连接，回调后重新计时
+    TestConnection readConn;
+    establish(loop, &readConn, [&readConn](const TcpConnectionPtr &c)
+              {
+        c->setReadTimeout(kTimeoutUs);
+        c->setTimeoutCallback([&readConn](const TcpConnectionPtr &, ConnectionTimeout type)
+                              {
+            if (type == kReadTimeout)
+                ++readConn.callbacks; }); });
+    ::usleep(static_cast<useconds_t>(kTimeoutUs * 3 + kTimeoutUs / 2));
+    std::cout << "read timeout callbacks " << readConn.callbacks << std::endl;
+    ok &= check("read timeout callback repeats", readConn.callbacks == 3);
+    ok &= check("read timeout keeps connection", readConn.closedAfterUs < 0);
+    destroy(loop, &readConn);
+
+    // 写超时：对端不读，输出缓冲区一直非空
+    TestConnection writeConn;
+    establish(loop, &writeConn, [](const TcpConnectionPtr &c)
+              { c->setWriteTimeout(kTimeoutUs); });
+    loop->runInLoop([&writeConn]()
+                    { writeConn.conn->send(std::string(4 * 1024 * 1024, 'x')); });
+    ::usleep(static_cast<useconds_t>(kTimeoutUs * 2));
+    std::cout << "write-stalled connection closed after " << writeConn.closedAfterUs / 1000.0 << " ms" << std::endl;
+    ok &= check("write-stalled connection closed", writeConn.closedAfterUs >= kTimeoutUs);
+    ok &= check("write timeout counted once", loop->timeoutCount(kWriteTimeout) == 1);
+    destroy(loop, &writeConn);
+
+    loopThread.stopLoop();
+    return ok ? 0 : 1;
+}
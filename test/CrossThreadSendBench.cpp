@@ -0,0 +1,159 @@
+/*
+ *  Filename:   CrossThreadSendBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:比较在其他线程里向同一个连接大量发送小消息的两种方式，连接是socketpair，对端在测试线程里读并校验
+ *              task：原来的方式，每条消息拷贝成string，各投递一个任务，到loop线程里各写一次
+ *              queue：send(string&&)，消息移动进连接的发送队列，连续的消息只投递一个任务，合成一次writev
+ *              4个生产者线程各发10万条64字节的消息，消息头是生产者编号和序号，对端检查每个生产者的消息按顺序到达
+ *  command:    g++ -O2 -pthread CrossThreadSendBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../base/CountDownLatch.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/TcpConnection.h"
+
+using namespace net;
+
+const int kProducers = 4;
+const int kMessages = 100 * 1000;
+const size_t kMessageSize = 64;
+
+struct Result
+{
+    double ms;
+    bool ok;
+};
+
+// 消息：4字节生产者编号，4字节序号，其余填充
+std::string makeMessage(int producer, int seq)
+{
+    std::string message(kMessageSize, 'x');
+    memcpy(&message[0], &producer, sizeof producer);
+    memcpy(&message[4], &seq, sizeof seq);
+    return message;
+}
+
+bool drain(int fd)
+{
+    std::vector<int> next(kProducers, 0);
+    std::vector<char> buf(256 * 1024);
+    size_t total = kMessageSize * kMessages * kProducers;
+    size_t got = 0;
+    size_t pending = 0; // buf里还不够一条消息的字节数
+    bool ok = true;
+    while (got < total)
+    {
+        ssize_t n = ::read(fd, buf.data() + pending, buf.size() - pending);
+        if (n <= 0)
+            return false;
+        got += n;
+        size_t available = pending + n;
+        size_t offset = 0;
+        for (; offset + kMessageSize <= available; offset += kMessageSize)
+        {
+            int producer = 0;
+            int seq = 0;
+            memcpy(&producer, &buf[offset], sizeof producer);
+            memcpy(&seq, &buf[offset + 4], sizeof seq);
+            if (producer < 0 || producer >= kProducers || seq != next[producer])
+                ok = false;
+            else
+                ++next[producer];
+        }
+        pending = available - offset;
+        memmove(buf.data(), buf.data() + offset, pending);
+    }
+    return ok;
+}
+
+Result run(EventLoop *loop, bool useQueue)
+{
+    Result result = {0, false};
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        return result;
+    ::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    TcpConnectionPtr conn;
+    CountDownLatch established(1);
+    loop->runInLoop([&]()
+                    {
+        conn.reset(new TcpConnection(loop, "bench", fds[0], InetAddress(), InetAddress()));
+        conn->setConnectionCallback(defaultConnectionCallback);
+        conn->setMessageCallback(defaultMessageCallback);
+        conn->connectEstablished();
+        established.countDown(); });
+    established.wait();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p)
+    {
+        producers.emplace_back([&, p]()
+                               {
+            for (int i = 0; i < kMessages; ++i)
+            {
+                std::string message = makeMessage(p, i);
+                if (useQueue)
+                {
+                    conn->send(std::move(message));
+                }
+                else
+                {
+                    TcpConnection *c = conn.get();
+                    loop->runInLoop([c, message]()
+                                    { c->send(message); });
+                }
+            } });
+    }
+    result.ok = drain(fds[1]);
+    result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    for (std::thread &t : producers)
+        t.join();
+
+    CountDownLatch finished(1);
+    loop->runInLoop([&]()
+                    {
+        conn->connectDestroyed();
+        conn.reset();
+        finished.countDown(); });
+    finished.wait();
+    ::close(fds[1]);
+    return result;
+}
+
+void print(const char *name, const Result &r)
+{
+    double messages = static_cast<double>(kProducers) * kMessages;
+    std::cout << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << r.ms << std::setw(14) << messages / r.ms / 1000.0
+              << (r.ok ? "" : "  order mismatch") << std::endl;
+}
+
+int main()
+{
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+
+    std::cout << kProducers << " producers x " << kMessages << " messages of " << kMessageSize << " bytes" << std::endl;
+    std::cout << std::left << std::setw(8) << "mode" << std::right << std::setw(10) << "ms"
+              << std::setw(14) << "M msgs/s" << std::endl;
+    run(loop, true);
+    print("task", run(loop, false));
+    print("queue", run(loop, true));
+
+    loopThread.stopLoop();
+    return 0;
+}
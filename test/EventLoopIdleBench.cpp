@@ -0,0 +1,112 @@
+/*
+ *  Filename:   EventLoopIdleBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:测量空闲EventLoop的CPU占用和定时器抖动
+ *              在引入timerfd之前(固定1ms轮询)，每个空闲loop每秒被唤醒1000次，
+ *              切换到旧版本重新编译运行即可得到对比数据
+ *  command:    g++ -O2 -pthread EventLoopIdleBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ *              ./bench [loops] [seconds]
+ */
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <sys/resource.h>
+#include "../base/Clock.h"
+#include "../base/CountDownLatch.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+
+using namespace net;
+
+double cpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void benchIdleCpu(int numLoops, int seconds)
+{
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    for (int i = 0; i < numLoops; ++i)
+    {
+        threads.emplace_back(new EventLoopThread());
+        threads.back()->startLoop();
+    }
+
+    double cpuStart = cpuSeconds();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    double cpuUsed = cpuSeconds() - cpuStart;
+
+    std::cout << "loops: " << numLoops << ", seconds: " << seconds
+              << ", cpu total: " << cpuUsed << "s"
+              << ", cpu per loop: " << cpuUsed / numLoops / seconds * 100 << "%" << std::endl;
+
+    for (auto &t : threads)
+    {
+        t->stopLoop();
+    }
+}
+
+void benchTimerJitter(int64_t intervalUs, int count)
+{
+    EventLoopThread thread;
+    EventLoop *loop = thread.startLoop();
+
+    std::vector<int64_t> jitters;
+    jitters.reserve(count);
+    CountDownLatch latch(1);
+    int64_t start = Clock::monotonicUs();
+    int fired = 0;
+    int64_t lastPeriod = 0;
+    int64_t missed = 0;
+
+    // 重复定时器错过的周期会直接跳过，每次触发按它所在的周期计算抖动，跳过的周期单独统计
+    loop->runEvery(intervalUs, [&]()
+                   {
+        if (fired >= count)
+            return;
+        ++fired;
+        int64_t elapsed = Clock::monotonicUs() - start;
+        int64_t period = elapsed / intervalUs;
+        missed += period > lastPeriod + 1 ? period - lastPeriod - 1 : 0;
+        lastPeriod = period;
+        jitters.push_back(elapsed - period * intervalUs);
+        if (fired == count)
+            latch.countDown(); });
+
+    latch.wait();
+    thread.stopLoop();
+
+    std::sort(jitters.begin(), jitters.end());
+    int64_t sum = 0;
+    for (int64_t j : jitters)
+        sum += j;
+
+    std::cout << "timer interval: " << intervalUs << "us, samples: " << count
+              << ", jitter avg: " << sum / count << "us"
+              << ", p50: " << jitters[count / 2] << "us"
+              << ", p99: " << jitters[count * 99 / 100] << "us"
+              << ", max: " << jitters.back() << "us"
+              << ", missed periods: " << missed << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int numLoops = argc > 1 ? atoi(argv[1]) : 6;
+    int seconds = argc > 2 ? atoi(argv[2]) : 5;
+
+    std::cout << "=== Idle CPU ===\n";
+    benchIdleCpu(numLoops, seconds);
+
+    std::cout << "\n=== Timer Jitter ===\n";
+    benchTimerJitter(500, 2000);
+    benchTimerJitter(10 * 1000, 200);
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ *  Filename:   FlowControlTest.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:测试TcpConnection的流量控制，连接都是socketpair，对端在测试线程里读写
+ *              echo：对端只写不读，输出队列到高水位时暂停读自己，积压不超过高水位加一次读的量；对端开始读之后恢复，数据完整
+ *              linked：A读到的数据转发给B，B的对端不读，B积压时暂停的是A的读
+ *              global：两个echo连接都不设高水位，只有全局上限，总积压不超过上限加每个连接一次读的量
+ *  command:    g++ -O2 -pthread FlowControlTest.cpp ../base/*.cpp ../net/*.cpp -o test
+ */
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/TcpConnection.h"
+#include "TestConnection.h"
+
+using namespace net;
+
+const size_t kHighMark = 256 * 1024;
+const size_t kLowMark = 64 * 1024;
+// 一次handleRead最多读进来的量：暂停发生在第一次读之后的消息回调里
+const size_t kReadSlack = 64 * 1024;
+const size_t kPayloadSize = 4 * 1024 * 1024;
+
+std::string pattern(size_t len, char seed)
+{
+    std::string s(len, '\0');
+    for (size_t i = 0; i < len; ++i)
+        s[i] = static_cast<char>(seed + i % 23);
+    return s;
+}
+
+void echo(const TcpConnectionPtr &conn, ByteBuffer *buf, Timestamp)
+{
+    conn->send(buf);
+}
+
+int main()
+{
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+    bool ok = true;
+
+    {
+        TestConnection tc;
+        establish(loop, &tc, [](const TcpConnectionPtr &c)
+                  {
+            c->setMessageCallback(echo);
+            c->setFlowControl(kHighMark, kLowMark); });
+        std::string data = pattern(kPayloadSize, 'a');
+        std::thread writer([&]()
+                           { ::write(tc.peerfd, data.data(), data.size()); });
+        ::usleep(200 * 1000);
+
+        size_t queued = 0;
+        int64_t pauses = 0;
+        inLoop(loop, [&]()
+               {
+            queued = tc.conn->outputQueue().readableBytes();
+            pauses = tc.conn->readPauseCount(); });
+        std::cout << "echo backlog " << queued / 1024 << " KB" << std::endl;
+        ok &= check("echo reading paused", pauses >= 1);
+        ok &= check("echo backlog bounded", queued >= kHighMark && queued <= kHighMark + kReadSlack);
+
+        ok &= check("echo data complete", readExactly(tc.peerfd, data.size()) == data);
+        writer.join();
+        int64_t pausedUs = 0;
+        inLoop(loop, [&]()
+               { pausedUs = tc.conn->readPausedUs(); });
+        ok &= check("echo paused time recorded", pausedUs > 0);
+        destroy(loop, &tc);
+    }
+
+    {
+        TestConnection upstream;
+        TestConnection downstream;
+        establish(loop, &downstream, [](const TcpConnectionPtr &c)
+                  { c->setFlowControl(kHighMark, kLowMark); });
+        establish(loop, &upstream, [&downstream](const TcpConnectionPtr &c)
+                  {
+            TcpConnectionPtr target = downstream.conn;
+            c->setMessageCallback([target](const TcpConnectionPtr &, ByteBuffer *buf, Timestamp)
+                                  { target->send(buf); });
+            target->linkUpstream(c); });
+        std::string data = pattern(kPayloadSize, 'A');
+        std::thread writer([&]()
+                           { ::write(upstream.peerfd, data.data(), data.size()); });
+        ::usleep(200 * 1000);
+
+        size_t queued = 0;
+        int64_t upstreamPauses = 0;
+        int64_t downstreamPauses = 0;
+        inLoop(loop, [&]()
+               {
+            queued = downstream.conn->outputQueue().readableBytes();
+            upstreamPauses = upstream.conn->readPauseCount();
+            downstreamPauses = downstream.conn->readPauseCount(); });
+        ok &= check("linked upstream paused", upstreamPauses >= 1 && downstreamPauses == 0);
+        ok &= check("linked backlog bounded", queued >= kHighMark && queued <= kHighMark + kReadSlack);
+
+        ok &= check("linked data complete", readExactly(downstream.peerfd, data.size()) == data);
+        writer.join();
+        destroy(loop, &upstream);
+        destroy(loop, &downstream);
+    }
+
+    {
+        const size_t kGlobalHigh = 512 * 1024;
+        TcpConnection::setGlobalOutputLimit(kGlobalHigh, kGlobalHigh / 4);
+        TestConnection first;
+        TestConnection second;
+        establish(loop, &first, [](const TcpConnectionPtr &c)
+                  { c->setMessageCallback(echo); });
+        establish(loop, &second, [](const TcpConnectionPtr &c)
+                  { c->setMessageCallback(echo); });
+        std::string data1 = pattern(kPayloadSize, 'a');
+        std::string data2 = pattern(kPayloadSize, 'A');
+        std::thread writer1([&]()
+                            { ::write(first.peerfd, data1.data(), data1.size()); });
+        std::thread writer2([&]()
+                            { ::write(second.peerfd, data2.data(), data2.size()); });
+        ::usleep(200 * 1000);
+
+        int64_t total = 0;
+        inLoop(loop, [&]()
+               { total = TcpConnection::globalOutputBytes(); });
+        std::cout << "global backlog " << total / 1024 << " KB" << std::endl;
+        ok &= check("global backlog bounded", total >= static_cast<int64_t>(kGlobalHigh) &&
+                                                  total <= static_cast<int64_t>(kGlobalHigh + 2 * kReadSlack));
+
+        ok &= check("global data complete", readExactly(first.peerfd, data1.size()) == data1 &&
+                                                readExactly(second.peerfd, data2.size()) == data2);
+        writer1.join();
+        writer2.join();
+        destroy(loop, &first);
+        destroy(loop, &second);
+        ok &= check("global accounting released", TcpConnection::globalOutputBytes() == 0 &&
+                                                      TcpConnection::globalReadPausedUs() > 0);
+        TcpConnection::setGlobalOutputLimit(0, 0);
+    }
+
+    loopThread.stopLoop();
+    return ok ? 0 : 1;
+}
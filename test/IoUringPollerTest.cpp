@@ -0,0 +1,187 @@
+/*
+ *  Filename:   IoUringPollerTest.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:测试IoUringPoller，Channel都挂在pipe的读端上，测试线程往写端写数据
+ *              level：水平触发每次回调只读1字节，one-shot poll每轮重新登记，写3字节收到3次回调
+ *              edge：边缘触发每次回调只读1字节，写3字节只收到1次回调，再写才有下一次
+ *              modify：关掉读事件之后写数据不回调，重新打开之后收到
+ *              error：登记之后关闭fd，提交时poll出错，Channel收到错误回调，fd恢复之后重新登记还能收到读事件
+ *              内核不支持io_uring时跳过
+ *  command:    g++ -O2 -pthread IoUringPollerTest.cpp ../base/*.cpp ../net/*.cpp -o test
+ */
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../net/Channel.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/IoUringPoller.h"
+#include "../net/Poller.h"
+#include "TestConnection.h"
+
+using namespace net;
+
+// 等不到的事件等这么久就算失败，不该来的事件等这么久没来就算通过
+const int kWaitMs = 1000;
+const int kQuietMs = 100;
+
+struct TestChannel
+{
+    Channel *channel;
+    int readfd;
+    int writefd;
+    std::atomic<int> reads;
+    std::atomic<int> errors;
+
+    TestChannel() : channel(NULL), readfd(-1), writefd(-1), reads(0), errors(0) {}
+};
+
+// 每次读回调只读1字节，剩下的留在pipe里
+void openChannel(EventLoop *loop, TestChannel *tc, bool edgeTriggered)
+{
+    int fds[2];
+    if (::pipe(fds) < 0)
+        return;
+    ::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    tc->readfd = fds[0];
+    tc->writefd = fds[1];
+
+    inLoop(loop, [&]()
+           {
+        tc->channel = new Channel(loop, tc->readfd);
+        tc->channel->setEdgeTriggered(edgeTriggered);
+        tc->channel->setReadCallback([tc](Timestamp)
+                                     {
+            char c;
+            if (::read(tc->readfd, &c, 1) == 1)
+                ++tc->reads; });
+        tc->channel->setErrorCallback([tc]()
+                                      { ++tc->errors; });
+        tc->channel->enableReading(); });
+}
+
+void closeChannel(EventLoop *loop, TestChannel *tc)
+{
+    inLoop(loop, [&]()
+           {
+        tc->channel->disableAll();
+        tc->channel->remove();
+        delete tc->channel;
+        tc->channel = NULL; });
+    ::close(tc->readfd);
+    ::close(tc->writefd);
+}
+
+bool writeBytes(int fd, int n)
+{
+    std::string data(n, 'x');
+    return ::write(fd, data.data(), data.size()) == n;
+}
+
+int main()
+{
+    {
+        IoUringPoller probe(NULL);
+        if (!probe.valid())
+        {
+            std::cout << "io_uring is not supported, skip" << std::endl;
+            return 0;
+        }
+    }
+
+    Poller::setDefaultPollerType(Poller::kIoUring);
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+    bool ok = true;
+
+    {
+        TestChannel tc;
+        openChannel(loop, &tc, false);
+        writeBytes(tc.writefd, 3);
+        ok &= check("level triggered re-armed", waitFor([&]()
+                                                        { return tc.reads == 3; }, kWaitMs));
+        std::this_thread::sleep_for(std::chrono::milliseconds(kQuietMs));
+        ok &= check("level triggered no extra events", tc.reads == 3 && tc.errors == 0);
+        closeChannel(loop, &tc);
+    }
+
+    {
+        TestChannel tc;
+        openChannel(loop, &tc, true);
+        writeBytes(tc.writefd, 3);
+        ok &= check("edge triggered first event", waitFor([&]()
+                                                          { return tc.reads == 1; }, kWaitMs));
+        std::this_thread::sleep_for(std::chrono::milliseconds(kQuietMs));
+        ok &= check("edge triggered once per change", tc.reads == 1);
+        writeBytes(tc.writefd, 1);
+        ok &= check("edge triggered next change", waitFor([&]()
+                                                          { return tc.reads == 2; }, kWaitMs));
+        closeChannel(loop, &tc);
+    }
+
+    {
+        TestChannel tc;
+        openChannel(loop, &tc, false);
+        inLoop(loop, [&]()
+               { tc.channel->disableReading(); });
+        writeBytes(tc.writefd, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(kQuietMs));
+        ok &= check("disabled channel quiet", tc.reads == 0);
+        inLoop(loop, [&]()
+               { tc.channel->enableReading(); });
+        ok &= check("re-enabled channel readable", waitFor([&]()
+                                                           { return tc.reads == 1; }, kWaitMs));
+        closeChannel(loop, &tc);
+    }
+
+    {
+        // 登记的SQE在下一轮poll()时才提交，提交之前关掉fd，内核返回EBADF；
+        // 错误回调里把另一个pipe的读端dup2到同一个fd上并写入数据，重新登记之后应该收到读事件
+        TestChannel tc;
+        int spare[2];
+        if (::pipe(spare) < 0)
+            return 1;
+        inLoop(loop, [&]()
+               {
+            tc.readfd = spare[0];
+            tc.writefd = spare[1];
+            int fds[2];
+            if (::pipe(fds) < 0)
+                return;
+            int fd = fds[0];
+            ::close(fds[1]);
+            tc.channel = new Channel(loop, fd);
+            tc.channel->setReadCallback([&tc, fd](Timestamp)
+                                        {
+                char c;
+                if (::read(fd, &c, 1) == 1)
+                    ++tc.reads; });
+            tc.channel->setErrorCallback([&tc, fd]()
+                                         {
+                if (++tc.errors == 1)
+                {
+                    ::dup2(tc.readfd, fd);
+                    writeBytes(tc.writefd, 1);
+                } });
+            tc.channel->enableReading();
+            ::close(fd); });
+        ok &= check("poll error reported", waitFor([&]()
+                                                   { return tc.errors > 0; }, kWaitMs));
+        ok &= check("poll re-armed after error", waitFor([&]()
+                                                         { return tc.reads == 1; }, kWaitMs));
+        ok &= check("poll error reported once", tc.errors == 1);
+        int fd = tc.channel->fd();
+        closeChannel(loop, &tc);
+        ::close(fd);
+    }
+
+    loopThread.stopLoop();
+    return ok ? 0 : 1;
+}
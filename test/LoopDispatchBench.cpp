@@ -0,0 +1,109 @@
+/*
+ *  Filename:   LoopDispatchBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:模拟连接分配，比较几种LoopDispatcher策略下各个loop的负载是否均衡
+ *              8个loop，每毫秒来一个新连接，每8个连接里有一个是持续10秒、每秒10MB的大流量长连接，
+ *              其余是持续50毫秒的小流量短连接，正好和轮询的周期对齐，是轮询最差的情况
+ *              统计每个loop的瞬时流量，输出最大值和平均值的比例(1.0表示完全均衡)
+ *  command:    g++ -O2 -pthread LoopDispatchBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+#include "../net/LoopDispatcher.h"
+
+using namespace net;
+
+const int kLoops = 8;
+const int64_t kStepUs = 1000;
+const int64_t kDurationUs = 30 * 1000 * 1000;
+const int64_t kHeavyLifetimeUs = 10 * 1000 * 1000;
+const int64_t kHeavyBytesPerSecond = 10 * 1024 * 1024;
+const int64_t kLightLifetimeUs = 50 * 1000;
+const int64_t kLightBytesPerSecond = 10 * 1024;
+
+struct SimConnection
+{
+    int loop;
+    int64_t closeUs;
+    int64_t bytesPerSecond;
+};
+
+void simulate(const char *name, LoopDispatcher *dispatcher)
+{
+    std::unique_ptr<LoopDispatcher> guard(dispatcher);
+    std::vector<SimConnection> connections;
+    std::vector<LoopLoad> loads(kLoops);
+    for (LoopLoad &load : loads)
+    {
+        load.connections = 0;
+        load.queueDepth = 0;
+        load.bytesTransferred = 0;
+    }
+
+    double imbalanceSum = 0;
+    double worstImbalance = 0;
+    int samples = 0;
+    int64_t accepted = 0;
+    for (int64_t now = 0; now < kDurationUs; now += kStepUs)
+    {
+        // 关闭到期的连接，累计这一步里各个loop收发的字节数
+        std::vector<int64_t> rates(kLoops, 0);
+        for (size_t i = 0; i < connections.size();)
+        {
+            SimConnection &c = connections[i];
+            if (c.closeUs <= now)
+            {
+                --loads[c.loop].connections;
+                c = connections.back();
+                connections.pop_back();
+                continue;
+            }
+            loads[c.loop].bytesTransferred += c.bytesPerSecond * kStepUs / 1000000;
+            rates[c.loop] += c.bytesPerSecond;
+            ++i;
+        }
+
+        bool heavy = accepted % kLoops == 0;
+        SimConnection c;
+        c.loop = static_cast<int>(dispatcher->select(loads, now));
+        c.closeUs = now + (heavy ? kHeavyLifetimeUs : kLightLifetimeUs);
+        c.bytesPerSecond = heavy ? kHeavyBytesPerSecond : kLightBytesPerSecond;
+        ++loads[c.loop].connections;
+        connections.push_back(c);
+        ++accepted;
+
+        // 跳过开始的一个长连接生命周期，等进入稳定状态之后再统计
+        if (now < kHeavyLifetimeUs)
+            continue;
+
+        int64_t total = 0, max = 0;
+        for (int64_t rate : rates)
+        {
+            total += rate;
+            if (rate > max)
+                max = rate;
+        }
+        double imbalance = static_cast<double>(max) * kLoops / static_cast<double>(total);
+        imbalanceSum += imbalance;
+        if (imbalance > worstImbalance)
+            worstImbalance = imbalance;
+        ++samples;
+    }
+
+    std::cout << std::left << std::setw(20) << name
+              << " mean max/avg=" << std::fixed << std::setprecision(2) << imbalanceSum / samples
+              << " worst max/avg=" << worstImbalance << std::endl;
+}
+
+int main()
+{
+    simulate("round-robin", LoopDispatcher::create(LoopDispatcher::kRoundRobin));
+    simulate("least-loaded", LoopDispatcher::create(LoopDispatcher::kLeastLoaded));
+    simulate("power-of-two", LoopDispatcher::create(LoopDispatcher::kPowerOfTwoChoices));
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ *  Filename:   LoopStatsBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:测量打开EventLoop统计之后每轮循环增加的开销，并打印统计结果
+ *              两个loop线程通过socketpair互相发送1字节做ping-pong，同时带一个周期定时器
+ *  command:    g++ -O2 -pthread LoopStatsBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ */
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../base/CountDownLatch.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/Channel.h"
+
+using namespace net;
+
+const int kRoundTrips = 200000;
+
+struct Peer
+{
+    EventLoop *loop;
+    int fd;
+    std::unique_ptr<Channel> channel;
+};
+
+void bench(bool statsEnabled)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) < 0)
+        return;
+
+    auto init = [statsEnabled](EventLoop *loop)
+    { loop->setStatsEnabled(statsEnabled); };
+    EventLoopThread t1(init), t2(init);
+    Peer peers[2];
+    peers[0].loop = t1.startLoop();
+    peers[1].loop = t2.startLoop();
+    peers[0].fd = fds[0];
+    peers[1].fd = fds[1];
+
+    std::atomic<int> trips(0);
+    CountDownLatch done(1);
+    CountDownLatch registered(2);
+    for (int i = 0; i < 2; ++i)
+    {
+        Peer *peer = &peers[i];
+        peer->loop->runInLoop([peer, i, &trips, &done, &registered]()
+                              {
+            peer->channel.reset(new Channel(peer->loop, peer->fd));
+            peer->channel->setReadCallback([peer, i, &trips, &done](Timestamp)
+                                           {
+                char c;
+                while (::read(peer->fd, &c, 1) == 1)
+                {
+                    if (i == 0 && ++trips == kRoundTrips)
+                    {
+                        done.countDown();
+                        return;
+                    }
+                    ssize_t n = ::write(peer->fd, &c, 1);
+                    (void)n;
+                } });
+            peer->channel->enableReading();
+            registered.countDown(); });
+    }
+    registered.wait();
+    peers[0].loop->runEvery(1000, []() {});
+
+    auto start = std::chrono::steady_clock::now();
+    char c = 'x';
+    ssize_t n = ::write(fds[0], &c, 1);
+    (void)n;
+    done.wait();
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "stats " << (statsEnabled ? "on" : "off") << ": "
+              << elapsed.count() / kRoundTrips << " us per round trip" << std::endl;
+    if (statsEnabled)
+        std::cout << peers[0].loop->stats().toString() << std::endl;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        Peer *peer = &peers[i];
+        CountDownLatch removed(1);
+        peer->loop->runInLoop([peer, &removed]()
+                              {
+            peer->channel->disableAll();
+            peer->channel->remove();
+            peer->channel.reset();
+            removed.countDown(); });
+        removed.wait();
+    }
+    t1.stopLoop();
+    t2.stopLoop();
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+int main()
+{
+    bench(false);
+    bench(true);
+    return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ *  Filename:   MpscQueueBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:EventLoop任务队列的竞争测试，对比 mutex+vector+每次写eventfd 和
+ *              无锁MPSC队列+合并唤醒，生产者线程数从1到32
+ *  command:    g++ -O2 -pthread MpscQueueBench.cpp -o bench
+ */
+
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include "../net/MpscQueue.h"
+
+using namespace net;
+
+typedef std::function<void()> Functor;
+
+const int kOpsPerProducer = 200000;
+
+void waitEventfd(int fd)
+{
+    struct pollfd pfd = {fd, POLLIN, 0};
+    ::poll(&pfd, 1, 10);
+    uint64_t n;
+    ssize_t r = ::read(fd, &n, sizeof n);
+    (void)r;
+}
+
+void notifyEventfd(int fd)
+{
+    uint64_t one = 1;
+    ssize_t r = ::write(fd, &one, sizeof one);
+    (void)r;
+}
+
+struct Result
+{
+    double seconds;
+    int64_t wakeups;
+};
+
+// 旧实现：每次投递都加锁，并且每次都写eventfd
+Result benchMutexQueue(int producers)
+{
+    int efd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    std::mutex mutex;
+    std::vector<Functor> pending;
+    std::atomic<int64_t> wakeups(0);
+    int64_t total = static_cast<int64_t>(producers) * kOpsPerProducer;
+    int64_t executed = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&]()
+                         {
+        std::vector<Functor> functors;
+        while (executed < total)
+        {
+            waitEventfd(efd);
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                functors.swap(pending);
+            }
+            for (auto &f : functors)
+                f();
+            functors.clear();
+        } });
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; ++i)
+    {
+        threads.emplace_back([&]()
+                             {
+            for (int n = 0; n < kOpsPerProducer; ++n)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    pending.push_back([&executed]() { ++executed; });
+                }
+                notifyEventfd(efd);
+                wakeups.fetch_add(1, std::memory_order_relaxed);
+            } });
+    }
+    for (auto &t : threads)
+        t.join();
+    consumer.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    ::close(efd);
+    return Result{elapsed.count(), wakeups.load()};
+}
+
+struct Task : public MpscNode
+{
+    Functor m_functor;
+};
+
+// 新实现：无锁入队，队列从空变成非空时才写eventfd
+Result benchMpscQueue(int producers)
+{
+    int efd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    MpscQueue<Task> queue;
+    std::atomic<bool> wakeupPending(false);
+    std::atomic<int64_t> wakeups(0);
+    int64_t total = static_cast<int64_t>(producers) * kOpsPerProducer;
+    int64_t executed = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&]()
+                         {
+        while (executed < total)
+        {
+            waitEventfd(efd);
+            wakeupPending.exchange(false, std::memory_order_acq_rel);
+            while (Task *task = queue.pop())
+            {
+                task->m_functor();
+                delete task;
+            }
+        } });
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; ++i)
+    {
+        threads.emplace_back([&]()
+                             {
+            for (int n = 0; n < kOpsPerProducer; ++n)
+            {
+                Task *task = new Task;
+                task->m_functor = [&executed]() { ++executed; };
+                queue.push(task);
+                if (!wakeupPending.exchange(true, std::memory_order_acq_rel))
+                {
+                    notifyEventfd(efd);
+                    wakeups.fetch_add(1, std::memory_order_relaxed);
+                }
+            } });
+    }
+    for (auto &t : threads)
+        t.join();
+    consumer.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    ::close(efd);
+    return Result{elapsed.count(), wakeups.load()};
+}
+
+int main()
+{
+    std::cout << "producers | mutex Mops/s | mutex wakeups | mpsc Mops/s | mpsc wakeups\n";
+    for (int producers = 1; producers <= 32; producers *= 2)
+    {
+        double ops = static_cast<double>(producers) * kOpsPerProducer / 1e6;
+        Result m = benchMutexQueue(producers);
+        Result q = benchMpscQueue(producers);
+        std::cout << producers << " | "
+                  << ops / m.seconds << " | " << m.wakeups << " | "
+                  << ops / q.seconds << " | " << q.wakeups << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,255 @@
+/*
+ *  Filename:   OutputQueueBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:比较两种输出缓冲：socketpair一端由另一个线程一直读并校验数据，这一端把消息放进输出缓冲再写出去
+ *              buffer：原来的方式，所有消息拷进一个连续的ByteBuffer，每次write连续的那一段
+ *              queue：OutputQueue，小消息拷进内存块，共享的视图和移动进来的大字符串不拷贝，一次writev写多段
+ *              small：20万条100字节的消息，每攒64条写一次；slice是同样的消息，但是是共享同一块内存的视图
+ *              mixed：2000条消息，每条是16字节的头加64KB的包体，包体是移动进来的字符串
+ *              huge：4条32MB的消息，一次放进去再写完
+ *  command:    g++ -O2 -pthread OutputQueueBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../net/ByteBuffer.h"
+#include "../net/OutputQueue.h"
+
+using namespace net;
+
+const int kSmallMessages = 200 * 1000;
+const size_t kSmallSize = 100;
+const int kBatch = 64;
+const int kMixedMessages = 2000;
+const size_t kHeaderSize = 16;
+const size_t kBodySize = 64 * 1024;
+const int kHugeMessages = 4;
+const size_t kHugeSize = 32 * 1024 * 1024;
+
+struct Result
+{
+    double ms;
+    long syscalls;
+    bool ok;
+};
+
+// 对端：读出所有数据，检查每个字节是不是按位置生成的
+void drain(int fd, size_t total, bool *ok)
+{
+    const size_t kReadSize = 256 * 1024;
+    std::vector<char> buf(kReadSize);
+    std::vector<char> pattern(kReadSize + 251);
+    for (size_t i = 0; i < pattern.size(); ++i)
+        pattern[i] = static_cast<char>(i % 251);
+    size_t got = 0;
+    *ok = true;
+    while (got < total)
+    {
+        ssize_t n = ::read(fd, buf.data(), buf.size());
+        if (n <= 0)
+        {
+            *ok = false;
+            return;
+        }
+        *ok &= ::memcmp(buf.data(), pattern.data() + got % 251, n) == 0;
+        got += n;
+    }
+}
+
+std::string makeMessage(size_t start, size_t len)
+{
+    std::string s(len, '\0');
+    for (size_t i = 0; i < len; ++i)
+        s[i] = static_cast<char>((start + i) % 251);
+    return s;
+}
+
+void waitWritable(int fd)
+{
+    struct pollfd pfd = {fd, POLLOUT, 0};
+    ::poll(&pfd, 1, -1);
+}
+
+// produce(sink)往输出缓冲里放消息，每放一批调用一次flush
+template <typename Produce>
+Result run(size_t total, Produce produce)
+{
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    bool ok = false;
+    std::thread reader(drain, fds[1], total, &ok);
+
+    auto start = std::chrono::steady_clock::now();
+    long syscalls = produce(fds[0]);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    reader.join();
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    Result result = {ms, syscalls, ok};
+    return result;
+}
+
+// 写到缓冲区为空为止
+long flushBuffer(int fd, ByteBuffer *buffer)
+{
+    long syscalls = 0;
+    while (buffer->readableBytes() > 0)
+    {
+        ++syscalls;
+        ssize_t n = ::write(fd, buffer->peek(), buffer->readableBytes());
+        if (n > 0)
+            buffer->retrieve(n);
+        else
+            waitWritable(fd);
+    }
+    return syscalls;
+}
+
+long flushQueue(int fd, OutputQueue *queue)
+{
+    long syscalls = 0;
+    while (!queue->empty())
+    {
+        ++syscalls;
+        int savedErrno = 0;
+        if (queue->writeTo(fd, &savedErrno) <= 0)
+            waitWritable(fd);
+    }
+    return syscalls;
+}
+
+void report(const char *workload, const char *name, const Result &result)
+{
+    std::cout << std::left << std::setw(8) << workload << std::setw(8) << name
+              << std::setw(10) << result.ms << " ms  " << std::setw(8) << result.syscalls << " syscalls  "
+              << (result.ok ? "ok" : "DATA MISMATCH") << std::endl;
+}
+
+int main()
+{
+    std::cout << std::fixed << std::setprecision(1);
+
+    // 一条消息在数据流里的位置决定它的内容，先按位置生成好，计时的部分只有放进缓冲和写出去
+    std::vector<std::string> small;
+    std::vector<CompositeByteBuffer> slices;
+    for (int i = 0; i < kSmallMessages; ++i)
+    {
+        small.push_back(makeMessage(i * kSmallSize, kSmallSize));
+        // 视图都来自同一个大缓冲区，像应用层把一个预先编码好的响应切片发出去
+        if (i % 1024 == 0)
+        {
+            CompositeByteBuffer block;
+            block.append(makeMessage(i * kSmallSize, kSmallSize * 1024));
+            for (int j = 0; j < 1024 && i + j < kSmallMessages; ++j)
+                slices.push_back(block.slice(j * kSmallSize, kSmallSize));
+        }
+    }
+    size_t smallTotal = kSmallMessages * kSmallSize;
+
+    report("small", "buffer", run(smallTotal, [&](int fd)
+                                  {
+        ByteBuffer buffer;
+        long syscalls = 0;
+        for (int i = 0; i < kSmallMessages; ++i)
+        {
+            buffer.append(small[i]);
+            if (i % kBatch == kBatch - 1)
+                syscalls += flushBuffer(fd, &buffer);
+        }
+        return syscalls + flushBuffer(fd, &buffer); }));
+
+    report("small", "queue", run(smallTotal, [&](int fd)
+                                 {
+        OutputQueue queue;
+        long syscalls = 0;
+        for (int i = 0; i < kSmallMessages; ++i)
+        {
+            queue.append(small[i].data(), small[i].size());
+            if (i % kBatch == kBatch - 1)
+                syscalls += flushQueue(fd, &queue);
+        }
+        return syscalls + flushQueue(fd, &queue); }));
+
+    report("slice", "queue", run(smallTotal, [&](int fd)
+                                 {
+        OutputQueue queue;
+        long syscalls = 0;
+        for (int i = 0; i < kSmallMessages; ++i)
+        {
+            queue.append(slices[i]);
+            if (i % kBatch == kBatch - 1)
+                syscalls += flushQueue(fd, &queue);
+        }
+        return syscalls + flushQueue(fd, &queue); }));
+
+    std::vector<std::string> headers, bodies;
+    for (int i = 0; i < kMixedMessages; ++i)
+    {
+        size_t start = i * (kHeaderSize + kBodySize);
+        headers.push_back(makeMessage(start, kHeaderSize));
+        bodies.push_back(makeMessage(start + kHeaderSize, kBodySize));
+    }
+    size_t mixedTotal = kMixedMessages * (kHeaderSize + kBodySize);
+
+    report("mixed", "buffer", run(mixedTotal, [&](int fd)
+                                  {
+        std::vector<std::string> messages = bodies;
+        ByteBuffer buffer;
+        long syscalls = 0;
+        for (int i = 0; i < kMixedMessages; ++i)
+        {
+            buffer.append(headers[i]);
+            buffer.append(messages[i]);
+            if (i % 8 == 7)
+                syscalls += flushBuffer(fd, &buffer);
+        }
+        return syscalls + flushBuffer(fd, &buffer); }));
+
+    report("mixed", "queue", run(mixedTotal, [&](int fd)
+                                 {
+        std::vector<std::string> messages = bodies;
+        OutputQueue queue;
+        long syscalls = 0;
+        for (int i = 0; i < kMixedMessages; ++i)
+        {
+            queue.append(headers[i].data(), headers[i].size());
+            queue.append(std::move(messages[i]));
+            if (i % 8 == 7)
+                syscalls += flushQueue(fd, &queue);
+        }
+        return syscalls + flushQueue(fd, &queue); }));
+
+    std::vector<std::string> huge;
+    for (int i = 0; i < kHugeMessages; ++i)
+        huge.push_back(makeMessage(i * kHugeSize, kHugeSize));
+    size_t hugeTotal = kHugeMessages * kHugeSize;
+
+    report("huge", "buffer", run(hugeTotal, [&](int fd)
+                                 {
+        std::vector<std::string> messages = huge;
+        ByteBuffer buffer;
+        for (std::string &message : messages)
+            buffer.append(message);
+        return flushBuffer(fd, &buffer); }));
+
+    report("huge", "queue", run(hugeTotal, [&](int fd)
+                                {
+        std::vector<std::string> messages = huge;
+        OutputQueue queue;
+        for (std::string &message : messages)
+            queue.append(std::move(message));
+        return flushQueue(fd, &queue); }));
+    return 0;
+}
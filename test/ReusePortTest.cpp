@@ -0,0 +1,149 @@
+/*
+ *  Filename:   ReusePortTest.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:测试TcpServer的kReusePortPerLoop模式，4个IO线程各自用SO_REUSEPORT监听同一个端口
+ *              listen：start()返回时所有线程都已经在监听，马上就能连上
+ *              spread：建立64个连接，内核按四元组把它们分到各个监听socket上，应该落在不止一个IO线程里
+ *              echo：每个连接都能收发数据
+ *              stop：stop()之后所有监听socket都关闭了，再连接被拒绝
+ *  command:    g++ -O2 -pthread ReusePortTest.cpp ../base/*.cpp ../net/*.cpp -o test
+ */
+
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../net/EventLoop.h"
+#include "../net/InetAddress.h"
+#include "../net/TcpServer.h"
+#include "TestConnection.h"
+
+using namespace net;
+
+const int kLoops = 4;
+const int kConnections = 64;
+
+// 绑定端口0让内核挑一个空闲端口，关掉之后给服务器用
+uint16_t pickPort()
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof addr;
+    uint16_t port = 0;
+    if (::bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) == 0 &&
+        ::getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &len) == 0)
+    {
+        port = ntohs(addr.sin_port);
+    }
+    ::close(fd);
+    return port;
+}
+
+int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool echo(int fd, const std::string &message)
+{
+    if (::write(fd, message.data(), message.size()) != static_cast<ssize_t>(message.size()))
+        return false;
+    std::string got;
+    char buf[256];
+    while (got.size() < message.size())
+    {
+        ssize_t n = ::read(fd, buf, sizeof buf);
+        if (n <= 0)
+            return false;
+        got.append(buf, n);
+    }
+    return got == message;
+}
+
+int main()
+{
+    uint16_t port = pickPort();
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress("127.0.0.1", port), "ReusePortTest", TcpServer::kReusePortPerLoop);
+
+    std::mutex mutex;
+    std::set<EventLoop *> loops;
+    int established = 0;
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn)
+                                 {
+        if (!conn->connected())
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        loops.insert(conn->getLoop());
+        ++established; });
+    server.setMessageCallback([](const TcpConnectionPtr &conn, ByteBuffer *buf, Timestamp)
+                              { conn->send(buf); });
+    server.start(kLoops);
+
+    bool ok = true;
+    std::thread client([&]()
+                       {
+        std::vector<int> fds;
+        for (int i = 0; i < kConnections; ++i)
+        {
+            int fd = connectTo(port);
+            if (fd < 0)
+                break;
+            fds.push_back(fd);
+        }
+        ok &= check("all connections accepted", fds.size() == static_cast<size_t>(kConnections));
+
+        bool echoed = true;
+        for (size_t i = 0; i < fds.size(); ++i)
+            echoed = echo(fds[i], "hello " + std::to_string(i)) && echoed;
+        ok &= check("echo on every loop", echoed);
+
+        size_t loopCount = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            loopCount = loops.size();
+            ok &= check("connection callbacks", established == kConnections);
+        }
+        std::cout << kConnections << " connections on " << loopCount << " of " << kLoops << " loops" << std::endl;
+        ok &= check("connections spread across loops", loopCount > 1 && loopCount <= static_cast<size_t>(kLoops));
+        ok &= check("base loop accepts nothing", loops.count(&loop) == 0);
+
+        for (int fd : fds)
+            ::close(fd);
+
+        loop.runInLoop([&]()
+                       {
+            server.stop();
+            loop.quit(); }); });
+
+    loop.loop();
+    client.join();
+
+    int fd = connectTo(port);
+    ok &= check("refused after stop", fd < 0);
+    if (fd >= 0)
+        ::close(fd);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+/*
+ *  Filename:   SendFileTest.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:测试TcpConnection::sendFile，连接是socketpair，对端在测试线程里直接读
+ *              order：send、sendFile、send在其他线程里调用，对端按调用顺序收到，文件区间从offset开始
+ *              dup：调用sendFile之后马上关闭自己的fd，不影响发送
+ *              write complete：全部发完之后调用写完成回调
+ *              truncated：文件比要发送的区间短时关闭连接
+ *  command:    g++ -O2 -pthread SendFileTest.cpp ../base/*.cpp ../net/*.cpp -o test
+ */
+
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/TcpConnection.h"
+#include "TestConnection.h"
+
+using namespace net;
+
+// 临时文件，内容是len字节的可见字符
+int createFile(std::string *content, size_t len)
+{
+    char path[] = "/tmp/sendfiletestXXXXXX";
+    int fd = ::mkstemp(path);
+    if (fd < 0)
+        return -1;
+    ::unlink(path);
+    content->resize(len);
+    for (size_t i = 0; i < len; ++i)
+        (*content)[i] = static_cast<char>('a' + i * 7 % 26);
+    if (::write(fd, content->data(), len) != static_cast<ssize_t>(len))
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main()
+{
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+    bool ok = true;
+
+    std::string content;
+    int filefd = createFile(&content, 1024 * 1024);
+    if (filefd < 0)
+    {
+        std::cout << "create file failed" << std::endl;
+        return 1;
+    }
+
+    // 大于socketpair的发送缓冲区，sendfile要分多次发完
+    {
+        TestConnection tc;
+        establish(loop, &tc);
+        const int64_t offset = 100;
+        const size_t len = 800 * 1000;
+        tc.conn->send(std::string("HEAD"));
+        int fd = ::dup(filefd);
+        tc.conn->sendFile(fd, offset, len);
+        ::close(fd);
+        tc.conn->send(std::string("TAIL"));
+
+        std::string received = readExactly(tc.peerfd, len + 8);
+        ok &= check("order kept", received == "HEAD" + content.substr(offset, len) + "TAIL");
+        ::usleep(50 * 1000);
+        ok &= check("write complete", tc.writeCompletes >= 1 && tc.conn->outputQueue().empty());
+        ok &= check("connection kept", !tc.closed());
+        destroy(loop, &tc);
+    }
+
+    // 要发送的区间超出文件末尾，发完文件里已有的数据之后关闭连接
+    {
+        TestConnection tc;
+        establish(loop, &tc);
+        tc.conn->sendFile(filefd, content.size() - 1000, 5000);
+        // 连接关闭后socket要等TcpConnection析构才关，这里只读文件里实际有的部分
+        std::string received = readExactly(tc.peerfd, 1000);
+        ok &= check("truncated file sent what exists", received == content.substr(content.size() - 1000));
+        ::usleep(50 * 1000);
+        ok &= check("truncated file closes connection", tc.closed());
+        destroy(loop, &tc);
+    }
+
+    ::close(filefd);
+    loopThread.stopLoop();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+/*
+ *  Filename:   TaskAllocBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:统计发送路径上每次send的内存分配次数(替换全局operator new计数)
+ *              loop线程内发送：写完成回调里接着发下一条，每条都会投递一次写完成任务，分别测send(data, len)和
+ *              send(std::string&&)(构造string本身的那次不算)，稳定后应该是0次，不是0时返回非0
+ *              跨线程发送：消息放进连接自己的发送队列(MpscQueue)，队列原来是空的时才投递一个任务；
+ *              send(const string&)要拷贝一份消息，有节点和消息两次，send(std::string&&)把string换进节点，只有节点一次
+ *  command:    g++ -O2 -pthread TaskAllocBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ */
+
+#include <iostream>
+#include <atomic>
+#include <functional>
+#include <new>
+#include <thread>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../base/CountDownLatch.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/TcpConnection.h"
+
+using namespace net;
+
+static std::atomic<uint64_t> g_allocations(0);
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+const int kWarmup = 10000;
+const int kSends = 200000;
+const int kMessageSize = 64;
+
+// 在写完成回调里接连发送kWarmup + kSends条，统计后kSends条的分配次数
+// send返回它自己的分配里不该算进去的次数(比如构造消息)；establish为true时先建立连接再发第一条
+double measureInLoop(EventLoop *loop, const TcpConnectionPtr &conn,
+                     const std::function<uint64_t(const TcpConnectionPtr &)> &send, bool establish)
+{
+    int sent = 0;
+    uint64_t before = 0;
+    uint64_t excluded = 0;
+    double result = 0;
+    CountDownLatch done(1);
+    conn->setWriteCompleteCallback([&](const TcpConnectionPtr &c)
+                                   {
+        ++sent;
+        if (sent == kWarmup)
+        {
+            before = g_allocations.load(std::memory_order_relaxed);
+            excluded = 0;
+        }
+        if (sent == kWarmup + kSends)
+        {
+            result = static_cast<double>(g_allocations.load(std::memory_order_relaxed) - before - excluded) / kSends;
+            done.countDown();
+            return;
+        }
+        excluded += send(c); });
+    loop->runInLoop([&]()
+                    {
+        if (establish)
+            conn->connectEstablished();
+        send(conn); });
+    done.wait();
+    conn->setWriteCompleteCallback(WriteCompleteCallback());
+    return result;
+}
+
+// 投递一个任务等前面跨线程的发送全部执行完，返回到那时为止的分配次数，不算这个任务节点
+uint64_t waitForSends(EventLoop *loop)
+{
+    CountDownLatch done(1);
+    loop->queueInLoop([&done]()
+                      { done.countDown(); });
+    done.wait();
+    return g_allocations.load(std::memory_order_relaxed) - 1;
+}
+
+int main()
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        return 1;
+    ::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    // 对端只负责把数据读掉
+    std::thread reader([&fds]()
+                       {
+        char buf[65536];
+        while (::read(fds[1], buf, sizeof buf) > 0)
+        {
+        } });
+
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+    TcpConnectionPtr conn(new TcpConnection(loop, "bench", fds[0], InetAddress(), InetAddress()));
+    conn->setConnectionCallback(defaultConnectionCallback);
+    conn->setMessageCallback(defaultMessageCallback);
+    char message[kMessageSize] = {0};
+
+    // loop线程内发送
+    double inLoopRaw = measureInLoop(loop, conn, [&](const TcpConnectionPtr &c)
+                                     {
+        c->send(message, kMessageSize);
+        return 0; }, true);
+    std::cout << "in-loop send(data, len): " << inLoopRaw << " allocations per send" << std::endl;
+    double inLoopMoved = measureInLoop(loop, conn, [&](const TcpConnectionPtr &c)
+                                       {
+        uint64_t start = g_allocations.load(std::memory_order_relaxed);
+        std::string payload(message, kMessageSize);
+        uint64_t built = g_allocations.load(std::memory_order_relaxed) - start;
+        c->send(std::move(payload));
+        return built; }, false);
+    std::cout << "in-loop send(string&&): " << inLoopMoved << " allocations per send" << std::endl;
+
+    // 跨线程发送
+    std::string payload(message, kMessageSize);
+    uint64_t before = g_allocations.load(std::memory_order_relaxed);
+    for (int i = 0; i < kSends; ++i)
+        conn->send(payload);
+    std::cout << "cross-thread send(const string&): " << static_cast<double>(waitForSends(loop) - before) / kSends
+              << " allocations per send" << std::endl;
+
+    std::vector<std::string> payloads(kSends, payload);
+    before = g_allocations.load(std::memory_order_relaxed);
+    for (int i = 0; i < kSends; ++i)
+        conn->send(std::move(payloads[i]));
+    std::cout << "cross-thread send(string&&): " << static_cast<double>(waitForSends(loop) - before) / kSends
+              << " allocations per send" << std::endl;
+
+    CountDownLatch destroyed(1);
+    loop->runInLoop([&]()
+                    {
+        conn->connectDestroyed();
+        destroyed.countDown(); });
+    destroyed.wait();
+    conn.reset();
+    reader.join();
+    loopThread.stopLoop();
+    bool ok = inLoopRaw == 0 && inLoopMoved == 0;
+    if (!ok)
+        std::cout << "FAIL in-loop send allocates" << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+/*
+ *  Filename:   TestConnection.h
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:TcpConnection测试共用的辅助函数，连接默认用socketpair建立，一端交给TcpConnection，
+ *              另一端(peerfd)留在测试线程里直接读写；记录关闭时间和写完成次数，销毁时已经关闭的连接不再重复销毁
+ */
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../base/CountDownLatch.h"
+#include "../base/Timestamp.h"
+#include "../net/EventLoop.h"
+#include "../net/TcpConnection.h"
+
+struct TestConnection
+{
+    net::TcpConnectionPtr conn;
+    int peerfd;
+    Timestamp start;                    // connectEstablished()的时间
+    std::atomic<int64_t> closedAfterUs; // 关闭回调距离start的微秒数，-1表示还没有关闭
+    std::atomic<int> writeCompletes;
+    std::atomic<int> callbacks; // 留给测试自己计数
+
+    TestConnection() : peerfd(-1), closedAfterUs(-1), writeCompletes(0), callbacks(0) {}
+
+    bool closed() const
+    {
+        return closedAfterUs >= 0;
+    }
+};
+
+// 在loop线程里执行f并等它返回
+inline void inLoop(net::EventLoop *loop, const std::function<void()> &f)
+{
+    CountDownLatch done(1);
+    loop->runInLoop([&]()
+                    {
+        f();
+        done.countDown(); });
+    done.wait();
+}
+
+typedef std::function<void(const net::TcpConnectionPtr &)> SetupCallback;
+
+// 在loop线程里用已经连好的一对fd建立连接，sockfd交给TcpConnection，peerfd留给测试线程
+// setup在connectEstablished()之前调用，可以覆盖默认的回调，返回时连接已经开始计时
+inline void establishOn(net::EventLoop *loop, TestConnection *tc, int sockfd, int peerfd,
+                        const SetupCallback &setup = SetupCallback())
+{
+    ::fcntl(sockfd, F_SETFL, ::fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+    tc->peerfd = peerfd;
+
+    inLoop(loop, [&]()
+           {
+        tc->conn.reset(new net::TcpConnection(loop, "test", sockfd, net::InetAddress(), net::InetAddress()));
+        tc->conn->setConnectionCallback(net::defaultConnectionCallback);
+        tc->conn->setMessageCallback(net::defaultMessageCallback);
+        tc->conn->setWriteCompleteCallback([tc](const net::TcpConnectionPtr &)
+                                           { ++tc->writeCompletes; });
+        tc->conn->setCloseCallback([tc, loop](const net::TcpConnectionPtr &c)
+                                   {
+            tc->closedAfterUs = Timestamp::now().microSecondsSinceEpoch() - tc->start.microSecondsSinceEpoch();
+            loop->queueInLoop(std::bind(&net::TcpConnection::connectDestroyed, c)); });
+        if (setup)
+            setup(tc->conn);
+        tc->start = Timestamp::now();
+        tc->conn->connectEstablished(); });
+}
+
+// 用socketpair建立连接
+inline void establish(net::EventLoop *loop, TestConnection *tc, const SetupCallback &setup = SetupCallback())
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        return;
+    establishOn(loop, tc, fds[0], fds[1], setup);
+}
+
+inline void destroy(net::EventLoop *loop, TestConnection *tc)
+{
+    inLoop(loop, [&]()
+           {
+        if (!tc->closed())
+            tc->conn->connectDestroyed();
+        tc->conn.reset(); });
+    ::close(tc->peerfd);
+}
+
+// 从对端读len字节，对端关闭时提前返回
+inline std::string readExactly(int fd, size_t len)
+{
+    std::string result;
+    char buf[65536];
+    while (result.size() < len)
+    {
+        ssize_t n = ::read(fd, buf, std::min(sizeof buf, len - result.size()));
+        if (n <= 0)
+            break;
+        result.append(buf, n);
+    }
+    return result;
+}
+
+// 每毫秒检查一次cond，等ms毫秒还不成立就返回false
+inline bool waitFor(const std::function<bool()> &cond, int ms)
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while (!cond())
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+inline bool check(const char *name, bool ok)
+{
+    std::cout << (ok ? "PASS " : "FAIL ") << name << std::endl;
+    return ok;
+}
@@ -0,0 +1,170 @@
+/*
+ *  Filename:   TimerQueueBench.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:对比原来基于std::set的定时器队列和分层时间轮在1万、10万、100万个定时器下的性能
+ *              定时器的到期时间在1到60秒之间均匀分布，模拟每个连接一个空闲超时定时器
+ *              add：插入N个定时器；remove：删除定时器(std::set版本是线性查找，只抽样1000次)；
+ *              expire：时间往前推进，每次推进1毫秒，直到所有定时器都到期
+ *              时间轮版本同时检查每个定时器恰好到期一次，并且没有提前到期
+ *  command:    g++ -O2 -pthread TimerQueueBench.cpp ../base/*.cpp ../net/*.cpp -o bench
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <set>
+#include <vector>
+#include "../net/Timer.h"
+#include "../net/TimingWheel.h"
+
+using namespace net;
+
+const int64_t kStartUs = 1700000000LL * 1000 * 1000;
+const int kRemoveSamples = 1000;
+
+double elapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<int64_t> makeDeadlines(int n)
+{
+    std::mt19937_64 rng(n);
+    std::uniform_int_distribution<int64_t> dist(1000 * 1000, 60 * 1000 * 1000);
+    std::vector<int64_t> deadlines(n);
+    for (int64_t &d : deadlines)
+        d = kStartUs + dist(rng);
+    return deadlines;
+}
+
+// 原来TimerQueue的做法：每个定时器new一次，按(到期时间, 指针)排序，删除时线性查找
+struct SetTimerQueue
+{
+    typedef std::pair<Timestamp, Timer *> Entry;
+    std::set<Entry> timers;
+
+    Timer *add(int64_t when)
+    {
+        Timer *timer = new Timer();
+        timer->init(TimerCallback(), Timestamp(when), 0, 1);
+        timers.insert(Entry(timer->expiration(), timer));
+        return timer;
+    }
+
+    void remove(Timer *timer, int64_t sequence)
+    {
+        for (auto it = timers.begin(); it != timers.end(); ++it)
+        {
+            if (it->second == timer && timer->sequence() == sequence)
+            {
+                delete it->second;
+                timers.erase(it);
+                return;
+            }
+        }
+    }
+
+    size_t expire(int64_t nowUs)
+    {
+        Entry sentry(Timestamp(nowUs), reinterpret_cast<Timer *>(UINTPTR_MAX));
+        auto end = timers.lower_bound(sentry);
+        size_t n = 0;
+        for (auto it = timers.begin(); it != end; ++it, ++n)
+            delete it->second;
+        timers.erase(timers.begin(), end);
+        return n;
+    }
+};
+
+void benchSet(int n)
+{
+    std::vector<int64_t> deadlines = makeDeadlines(n);
+    SetTimerQueue queue;
+    std::vector<Timer *> timers(n);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i)
+        timers[i] = queue.add(deadlines[i]);
+    double addNs = elapsedNs(start) / n;
+
+    start = std::chrono::steady_clock::now();
+    int removes = std::min(n, kRemoveSamples);
+    for (int i = 0; i < removes; ++i)
+    {
+        Timer *timer = timers[static_cast<size_t>(i) * n / removes];
+        queue.remove(timer, timer->sequence());
+    }
+    double removeNs = elapsedNs(start) / removes;
+
+    start = std::chrono::steady_clock::now();
+    size_t expired = 0;
+    for (int64_t now = kStartUs; !queue.timers.empty(); now += 1000)
+        expired += queue.expire(now);
+    double expireNs = elapsedNs(start) / expired;
+
+    std::cout << std::left << std::setw(8) << n << std::setw(8) << "set"
+              << " add " << std::setw(10) << addNs << " remove " << std::setw(12) << removeNs
+              << " expire " << std::setw(10) << expireNs << " ns/op" << std::endl;
+}
+
+void benchWheel(int n)
+{
+    std::vector<int64_t> deadlines = makeDeadlines(n);
+    TimingWheel wheel((Timestamp(kStartUs)));
+    std::vector<Timer *> timers(n);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i)
+    {
+        Timer *timer = wheel.newTimer();
+        timer->init(TimerCallback(), Timestamp(deadlines[i]), 0, 1);
+        wheel.add(timer);
+        timers[i] = timer;
+    }
+    double addNs = elapsedNs(start) / n;
+
+    // 删除一半，剩下的一半用来测到期
+    start = std::chrono::steady_clock::now();
+    int removes = n / 2;
+    for (int i = 0; i < removes; ++i)
+    {
+        wheel.remove(timers[i * 2]);
+        wheel.freeTimer(timers[i * 2]);
+    }
+    double removeNs = elapsedNs(start) / removes;
+
+    start = std::chrono::steady_clock::now();
+    std::vector<Timer *> expired;
+    size_t expiredCount = 0;
+    bool early = false;
+    for (int64_t now = kStartUs; !wheel.empty(); now += 1000)
+    {
+        expired.clear();
+        wheel.expire(Timestamp(now), expired);
+        for (Timer *timer : expired)
+        {
+            early = early || timer->expiration().microSecondsSinceEpoch() > now;
+            wheel.freeTimer(timer);
+        }
+        expiredCount += expired.size();
+    }
+    double expireNs = elapsedNs(start) / expiredCount;
+
+    std::cout << std::left << std::setw(8) << n << std::setw(8) << "wheel"
+              << " add " << std::setw(10) << addNs << " remove " << std::setw(12) << removeNs
+              << " expire " << std::setw(10) << expireNs << " ns/op"
+              << ((expiredCount == static_cast<size_t>(n - removes) && !early) ? "" : "  MISMATCH") << std::endl;
+}
+
+int main()
+{
+    std::cout << std::fixed << std::setprecision(1);
+    for (int n : {10000, 100000, 1000000})
+    {
+        benchSet(n);
+        benchWheel(n);
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ *  Filename:   TrafficShapingTest.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:测试TcpConnection的流量整形，连接都是socketpair，对端在测试线程里读写
+ *              write：写限速4MB/s，一次send 1MB，对端读完大约用250ms，每25ms到达的数据不超过一个窗口的量太多(没有突发)
+ *              read：读限速4MB/s，对端一次写1MB，消息回调收完大约用250ms，期间暂停过读
+ *              shared：两个连接共用一个写限速4MB/s的整形器，各发512KB，加起来大约250ms
+ *              global：全局写限速4MB/s，一个连接发1MB，大约250ms
+ *  command:    g++ -O2 -pthread TrafficShapingTest.cpp ../base/*.cpp ../net/*.cpp -o test
+ */
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "../base/CountDownLatch.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/TcpConnection.h"
+#include "TestConnection.h"
+
+using namespace net;
+
+const int64_t kRate = 4 * 1024 * 1024;
+const size_t kPayloadSize = 1024 * 1024;
+// 按速率应该用的时间是250ms，定时器和调度的误差给宽一些
+const double kExpectedMs = 250;
+const double kMinMs = 200;
+const double kMaxMs = 500;
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+double elapsedMs(const TimePoint &start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 读len字节，arrivals里记下每次read返回时距离start的毫秒数和读到的字节数
+bool readAll(int fd, size_t len, const TimePoint &start, std::vector<std::pair<double, size_t>> *arrivals)
+{
+    char buf[65536];
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = ::read(fd, buf, sizeof buf);
+        if (n <= 0)
+            return false;
+        got += n;
+        if (arrivals != NULL)
+            arrivals->push_back(std::make_pair(elapsedMs(start), static_cast<size_t>(n)));
+    }
+    return got == len;
+}
+
+// 按windowMs切成窗口，返回到达最多的那个窗口的字节数
+size_t maxWindowBytes(const std::vector<std::pair<double, size_t>> &arrivals, double windowMs)
+{
+    std::vector<size_t> windows;
+    for (const std::pair<double, size_t> &arrival : arrivals)
+    {
+        size_t index = static_cast<size_t>(arrival.first / windowMs);
+        if (windows.size() <= index)
+            windows.resize(index + 1, 0);
+        windows[index] += arrival.second;
+    }
+    size_t maxBytes = 0;
+    for (size_t bytes : windows)
+        maxBytes = std::max(maxBytes, bytes);
+    return maxBytes;
+}
+
+bool inRange(double ms)
+{
+    return ms >= kMinMs && ms <= kMaxMs;
+}
+
+int main()
+{
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+    bool ok = true;
+    std::string payload(kPayloadSize, 'x');
+
+    {
+        TestConnection tc;
+        establish(loop, &tc, [](const TcpConnectionPtr &c)
+                  { c->setTrafficShaping(0, kRate); });
+        TimePoint start = std::chrono::steady_clock::now();
+        tc.conn->send(payload);
+        std::vector<std::pair<double, size_t>> arrivals;
+        bool complete = readAll(tc.peerfd, payload.size(), start, &arrivals);
+        double ms = elapsedMs(start);
+        // 25ms按速率是100KB，允许一个burst(40KB)和一次定时器的延迟
+        size_t burst = maxWindowBytes(arrivals, 25);
+        std::cout << "write " << ms << " ms, max " << burst / 1024 << " KB per 25ms" << std::endl;
+        ok &= check("write shaped data complete", complete);
+        ok &= check("write shaped duration", inRange(ms));
+        ok &= check("write shaped smooth", burst <= static_cast<size_t>(kRate / 40 * 2));
+        destroy(loop, &tc);
+    }
+
+    {
+        TestConnection tc;
+        std::atomic<size_t> received(0);
+        CountDownLatch done(1);
+        establish(loop, &tc, [&](const TcpConnectionPtr &c)
+                  {
+            c->setTrafficShaping(kRate, 0);
+            c->setMessageCallback([&](const TcpConnectionPtr &, ByteBuffer *buf, Timestamp)
+                                  {
+                if (received.fetch_add(buf->readableBytes()) + buf->readableBytes() == kPayloadSize)
+                    done.countDown();
+                buf->retrieveAll(); }); });
+        TimePoint start = std::chrono::steady_clock::now();
+        std::thread writer([&]()
+                           { ::write(tc.peerfd, payload.data(), payload.size()); });
+        done.wait();
+        double ms = elapsedMs(start);
+        writer.join();
+
+        int64_t pauses = 0;
+        inLoop(loop, [&]()
+               { pauses = tc.conn->readPauseCount(); });
+        std::cout << "read " << ms << " ms, " << pauses << " pauses" << std::endl;
+        ok &= check("read shaped duration", inRange(ms));
+        ok &= check("read shaped paused", pauses > 0 && tc.conn->trafficShaper().readThrottles() > 0);
+        destroy(loop, &tc);
+    }
+
+    {
+        std::shared_ptr<TrafficShaper> shaper(new TrafficShaper(0, kRate));
+        TestConnection first;
+        TestConnection second;
+        establish(loop, &first, [&](const TcpConnectionPtr &c)
+                  { c->setSharedTrafficShaper(shaper); });
+        establish(loop, &second, [&](const TcpConnectionPtr &c)
+                  { c->setSharedTrafficShaper(shaper); });
+        std::string half(kPayloadSize / 2, 'y');
+        TimePoint start = std::chrono::steady_clock::now();
+        first.conn->send(half);
+        second.conn->send(half);
+        bool complete = false;
+        std::thread reader([&]()
+                           { complete = readAll(first.peerfd, half.size(), start, NULL); });
+        bool secondComplete = readAll(second.peerfd, half.size(), start, NULL);
+        reader.join();
+        double ms = elapsedMs(start);
+        std::cout << "shared " << ms << " ms" << std::endl;
+        ok &= check("shared shaper data complete", complete && secondComplete);
+        ok &= check("shared shaper duration", inRange(ms));
+        ok &= check("shared shaper bytes", shaper->bytesWritten() == static_cast<int64_t>(kPayloadSize));
+        destroy(loop, &first);
+        destroy(loop, &second);
+    }
+
+    {
+        TcpConnection::setGlobalTrafficShaping(0, kRate);
+        TestConnection tc;
+        establish(loop, &tc, [](const TcpConnectionPtr &) {});
+        TimePoint start = std::chrono::steady_clock::now();
+        tc.conn->send(payload);
+        bool complete = readAll(tc.peerfd, payload.size(), start, NULL);
+        double ms = elapsedMs(start);
+        std::cout << "global " << ms << " ms" << std::endl;
+        ok &= check("global shaper data complete", complete);
+        ok &= check("global shaper duration", inRange(ms) &&
+                                                  TcpConnection::globalTrafficShaper().writeThrottles() > 0);
+        destroy(loop, &tc);
+        TcpConnection::setGlobalTrafficShaping(0, 0);
+    }
+
+    std::cout << "expected about " << kExpectedMs << " ms each" << std::endl;
+    loopThread.stopLoop();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+/*
+ *  Filename:   ZeroCopyCloseTest.cpp
+ *  Author:     xiebaoma
+ *  Date:       2026-10-17
+ *  Description:测试零拷贝发送之后马上关闭连接，连接走回环地址，接收端把接收缓冲区设小并且先不读
+ *              在loop线程里用零拷贝发送8MB数据，紧接着forceClose()并释放连接，大部分数据还在内核的发送队列里
+ *              handover：连接析构时还没收到完成通知的内存交给了loop的ZeroCopyReaper
+ *              intact：随后在loop线程里申请同样大小的内存块并全部写成'Z'，内存提前还给BufferPool的话会被这些块重用，
+ *              接收端读到的数据就不是原来的内容了；读到EOF为止，收到的必须是发送数据的前缀
+ *              eof：ZeroCopyReaper收齐通知之后关闭socket，接收端收到FIN
+ *              reaped：之后ZeroCopyReaper里没有还在等的socket
+ *              内核不支持SO_ZEROCOPY时跳过
+ *  command:    g++ -O2 -pthread ZeroCopyCloseTest.cpp ../base/*.cpp ../net/*.cpp -o test
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../net/CompositeByteBuffer.h"
+#include "../net/EventLoop.h"
+#include "../net/EventLoopThread.h"
+#include "../net/ZeroCopyReaper.h"
+#include "TestConnection.h"
+
+using namespace net;
+
+const size_t kMessageSize = 8 * 1024 * 1024;
+const size_t kZeroCopyThreshold = 64 * 1024;
+const int kPeerRecvBuf = 64 * 1024;
+// 接收端读不到数据超过这么久就算失败，避免ZeroCopyReaper不关闭socket时一直卡住
+const int kReadTimeoutSec = 10;
+const int kWaitMs = 1000;
+
+// 回环地址上建立一条TCP连接，fds[0]给TcpConnection，fds[1]是接收端
+bool connectLoopback(int fds[2])
+{
+    int listenfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof addr;
+    if (::bind(listenfd, reinterpret_cast<struct sockaddr *>(&addr), len) < 0 || ::listen(listenfd, 1) < 0 ||
+        ::getsockname(listenfd, reinterpret_cast<struct sockaddr *>(&addr), &len) < 0)
+    {
+        ::close(listenfd);
+        return false;
+    }
+
+    fds[1] = ::socket(AF_INET, SOCK_STREAM, 0);
+    // 接收窗口要在connect之前设小
+    ::setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &kPeerRecvBuf, sizeof kPeerRecvBuf);
+    if (::connect(fds[1], reinterpret_cast<struct sockaddr *>(&addr), len) < 0)
+    {
+        ::close(listenfd);
+        return false;
+    }
+    fds[0] = ::accept(listenfd, NULL, NULL);
+    ::close(listenfd);
+    return fds[0] >= 0;
+}
+
+char patternAt(size_t i)
+{
+    return static_cast<char>(i % 251);
+}
+
+int main()
+{
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+
+    int fds[2];
+    if (!connectLoopback(fds))
+    {
+        std::cout << "connect loopback failed" << std::endl;
+        return 1;
+    }
+    struct timeval timeout = {kReadTimeoutSec, 0};
+    ::setsockopt(fds[1], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+
+    TestConnection tc;
+    bool supported = false;
+    establishOn(loop, &tc, fds[0], fds[1], [&](const TcpConnectionPtr &conn)
+                { supported = conn->setZeroCopyThreshold(kZeroCopyThreshold); });
+    if (!supported)
+    {
+        std::cout << "SO_ZEROCOPY not supported, skip" << std::endl;
+        destroy(loop, &tc);
+        return 0;
+    }
+
+    bool ok = true;
+    size_t pendingSockets = 0;
+    size_t pinnedBytes = 0;
+    std::vector<BufferChunk *> scribbles;
+    inLoop(loop, [&]()
+           {
+        // 数据放在loop线程申请的BufferPool内存块里，释放之后会回到这个线程的缓存
+        CompositeByteBuffer message;
+        std::string block(251 * 64, '\0');
+        for (size_t i = 0; i < block.size(); ++i)
+            block[i] = patternAt(i);
+        while (message.readableBytes() < kMessageSize)
+            message.append(block);
+        tc.conn->send(std::move(message));
+        tc.conn->forceClose();
+        tc.conn.reset(); });
+
+    // 关闭回调投递的connectDestroyed()执行完，连接才析构
+    waitFor([&]()
+            {
+        inLoop(loop, [&]()
+               {
+            pendingSockets = loop->zeroCopyReaper()->pendingSockets();
+            pinnedBytes = loop->zeroCopyReaper()->pinnedBytes(); });
+        return pendingSockets > 0; }, kWaitMs);
+    inLoop(loop, [&]()
+           {
+        // 把刚才那批内存块可能被重用的地方都写成'Z'
+        for (size_t n = 0; n < 2 * kMessageSize; n += CompositeByteBuffer::kDefaultChunkSize)
+        {
+            BufferChunk *chunk = BufferChunk::create(CompositeByteBuffer::kDefaultChunkSize - BufferChunk::kHeaderSize);
+            memset(chunk->data(), 'Z', chunk->capacity());
+            scribbles.push_back(chunk);
+        } });
+    std::cout << "handed over " << pendingSockets << " socket(s), " << pinnedBytes << " bytes pinned" << std::endl;
+    ok &= check("handover", pendingSockets == 1 && pinnedBytes > 0);
+
+    size_t got = 0;
+    bool intact = true;
+    bool eof = false;
+    char buf[65536];
+    for (;;)
+    {
+        ssize_t n = ::read(fds[1], buf, sizeof buf);
+        if (n == 0)
+            eof = true;
+        if (n <= 0)
+            break;
+        for (ssize_t i = 0; i < n && intact; ++i)
+            intact = buf[i] == patternAt(got + i);
+        got += n;
+    }
+    std::cout << "peer received " << got << " bytes" << std::endl;
+    ok &= check("intact", intact && got > 0 && got <= kMessageSize);
+    ok &= check("eof", eof);
+
+    inLoop(loop, [&]()
+           {
+        pendingSockets = loop->zeroCopyReaper()->pendingSockets();
+        for (BufferChunk *chunk : scribbles)
+            chunk->release(); });
+    ok &= check("reaped", pendingSockets == 0);
+
+    ::close(fds[1]);
+    loopThread.stopLoop();
+    return ok ? 0 : 1;
+}